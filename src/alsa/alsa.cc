@@ -25,16 +25,25 @@
  * as the ALSA file descriptors so that we can wake up the pump thread when
  * needed.
  *
- * When paused, or when it comes to the end of the data given it, the pump will
- * wait on alsa_cond for the signal to continue.  When it has more data waiting,
- * however, it will be sitting in poll() waiting for ALSA's signal that more
- * data can be written.
+ * The software buffer is a single-producer, single-consumer ring: write_audio()
+ * adds data to it without taking the mutex, and only the pump (or flush(),
+ * which holds the mutex and so excludes the pump) removes data from it.
  *
- * * After adding more data to the buffer, and after resuming from pause,
- *   signal on alsa_cond to wake the pump.  (There is no need to signal when
- *   entering pause.)
+ * When paused, the pump will wait on alsa_cond for the signal to continue.
+ * When it comes to the end of the data given it, it sets pump_idle and waits
+ * on the poll_pipe alone.  When it has more data waiting, however, it will be
+ * sitting in poll() waiting for ALSA's signal that more data can be written.
+ *
+ * * After adding more data to the buffer, if pump_idle is set, signal on the
+ *   poll_pipe to wake the pump.
+ * * After resuming from pause, signal on alsa_cond to wake the pump.  (There is
+ *   no need to signal when entering pause.)
  * * After setting the pump_quit flag, signal on alsa_cond AND the poll_pipe
  *   before joining the thread.
+ *
+ * In mmap mode, the pump copies from the ring straight into the hardware buffer
+ * with snd_pcm_mmap_begin() and snd_pcm_mmap_commit() instead of calling
+ * snd_pcm_writei().
  */
 
 #include <assert.h>
@@ -45,8 +54,10 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <atomic>
+
 #include <alsa/asoundlib.h>
-#include <libaudcore/ringbuf.h>
+#include <libaudcore/index.h>
 
 #include "alsa.h"
 
@@ -74,9 +85,14 @@ static pthread_cond_t alsa_cond = PTHREAD_COND_INITIALIZER;
 static snd_pcm_format_t alsa_format;
 static int alsa_channels, alsa_rate;
 
-static RingBuf<char> alsa_buffer;
+static bool alsa_mmap;
 static int alsa_period; /* milliseconds */
 
+/* The positions count bytes since the buffer was allocated; they are reduced
+ * modulo the buffer size only to index into it. */
+static Index<char> alsa_buffer;
+static std::atomic<int64_t> buffer_written, buffer_read;
+
 static bool alsa_prebuffer, alsa_paused;
 static int alsa_paused_delay; /* milliseconds */
 
@@ -85,11 +101,52 @@ static int poll_count;
 static pollfd * poll_handles;
 
 static bool pump_quit;
+static std::atomic<bool> pump_idle;
 static pthread_t pump_thread;
 
 static snd_mixer_t * alsa_mixer;
 static snd_mixer_elem_t * alsa_mixer_element;
 
+static int buffer_len ()
+{
+    return buffer_written.load () - buffer_read.load ();
+}
+
+static int buffer_space ()
+{
+    return alsa_buffer.len () - buffer_len ();
+}
+
+/* consumer side: the contiguous data at the read position */
+static int buffer_linear ()
+{
+    int offset = buffer_read.load () % alsa_buffer.len ();
+    return aud::min (buffer_len (), alsa_buffer.len () - offset);
+}
+
+static const char * buffer_peek ()
+{
+    return & alsa_buffer[buffer_read.load () % alsa_buffer.len ()];
+}
+
+static void buffer_discard (int len)
+{
+    buffer_read.fetch_add (len);
+}
+
+/* producer side */
+static void buffer_copy_in (const char * data, int len)
+{
+    int64_t written = buffer_written.load ();
+    int offset = written % alsa_buffer.len ();
+    int part = aud::min (len, alsa_buffer.len () - offset);
+
+    memcpy (& alsa_buffer[offset], data, part);
+    memcpy (& alsa_buffer[0], data + part, len - part);
+
+    buffer_written.store (written + len);
+}
+
 static bool poll_setup ()
 {
     if (pipe (poll_pipe))
@@ -116,9 +173,9 @@ static bool poll_setup ()
     return true;
 }
 
-static void poll_sleep ()
+static void poll_sleep (bool pipe_only = false)
 {
-    if (poll (poll_handles, poll_count, -1) < 0)
+    if (poll (poll_handles, pipe_only ? 1 : poll_count, -1) < 0)
     {
         AUDERR ("Failed to poll: %s.\n", strerror (errno));
         return;
@@ -146,6 +203,36 @@ static void poll_cleanup ()
     delete[] poll_handles;
 }
 
+/* Copies frames straight into the hardware buffer.  Like snd_pcm_writei(),
+ * returns the number of frames written or a negative error code. */
+static snd_pcm_sframes_t mmap_write (const char * data, snd_pcm_uframes_t frames)
+{
+    const snd_pcm_channel_area_t * areas;
+    snd_pcm_uframes_t offset;
+
+    int error = snd_pcm_mmap_begin (alsa_handle, & areas, & offset, & frames);
+    if (error < 0)
+        return error;
+
+    /* with interleaved access, the first area steps over whole frames */
+    char * to = (char *) areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+    memcpy (to, data, snd_pcm_frames_to_bytes (alsa_handle, frames));
+
+    snd_pcm_sframes_t committed = snd_pcm_mmap_commit (alsa_handle, offset, frames);
+    if (committed < 0)
+        return committed;
+
+    /* unlike snd_pcm_writei(), committing does not start the stream */
+    if (snd_pcm_state (alsa_handle) == SND_PCM_STATE_PREPARED)
+    {
+        error = snd_pcm_start (alsa_handle);
+        if (error < 0)
+            return error;
+    }
+
+    return committed;
+}
+
 static void * pump (void *)
 {
     pthread_mutex_lock (& alsa_mutex);
@@ -156,14 +243,31 @@ static void * pump (void *)
 
     while (! pump_quit)
     {
-        int writable = snd_pcm_bytes_to_frames (alsa_handle, alsa_buffer.linear ());
-
-        if (alsa_prebuffer || alsa_paused || ! writable)
+        if (alsa_prebuffer || alsa_paused)
         {
             pthread_cond_wait (& alsa_cond, & alsa_mutex);
             continue;
         }
 
+        int writable = snd_pcm_bytes_to_frames (alsa_handle, buffer_linear ());
+
+        if (! writable)
+        {
+            /* Check again after setting the flag, so that data added in
+             * between is not missed; see write_audio(). */
+            pump_idle.store (true);
+
+            if (! buffer_linear ())
+            {
+                pthread_mutex_unlock (& alsa_mutex);
+                poll_sleep (true);
+                pthread_mutex_lock (& alsa_mutex);
+            }
+
+            pump_idle.store (false);
+            continue;
+        }
+
         int avail;
         CHECK_VAL_RECOVER (avail, snd_pcm_avail_update, alsa_handle);
 
@@ -172,16 +276,20 @@ static void * pump (void *)
             wakeups_since_write = 0;
 
             int written;
-            CHECK_VAL_RECOVER (written, snd_pcm_writei, alsa_handle,
-             & alsa_buffer[0], aud::min (writable, avail));
+            if (alsa_mmap)
+                CHECK_VAL_RECOVER (written, mmap_write, buffer_peek (),
+                 aud::min (writable, avail));
+            else
+                CHECK_VAL_RECOVER (written, snd_pcm_writei, alsa_handle,
+                 buffer_peek (), aud::min (writable, avail));
 
             failed_once = false;
 
-            alsa_buffer.discard (snd_pcm_frames_to_bytes (alsa_handle, written));
+            buffer_discard (snd_pcm_frames_to_bytes (alsa_handle, written));
 
             pthread_cond_broadcast (& alsa_cond); /* signal write complete */
 
-            if (writable < avail)
+            if (written < avail)
                 continue;
         }
 
@@ -311,7 +419,7 @@ static snd_pcm_format_t convert_aud_format (int aud_format)
 
 bool ALSAPlugin::open_audio (int aud_format, int rate, int channels, String & error)
 {
-    int total_buffer, hard_buffer, soft_buffer, buffer_frames;
+    int total_buffer, hard_buffer, soft_buffer, buffer_frames, period;
     unsigned useconds;
     int direction;
 
@@ -335,8 +443,20 @@ bool ALSAPlugin::open_audio (int aud_format, int rate, int channels, String & er
     snd_pcm_hw_params_t * params;
     snd_pcm_hw_params_alloca (& params);
     CHECK_STR (error, snd_pcm_hw_params_any, alsa_handle, params);
-    CHECK_STR (error, snd_pcm_hw_params_set_access, alsa_handle, params,
-     SND_PCM_ACCESS_RW_INTERLEAVED);
+
+    alsa_mmap = aud_get_bool ("alsa", "mmap") && snd_pcm_hw_params_set_access
+     (alsa_handle, params, SND_PCM_ACCESS_MMAP_INTERLEAVED) >= 0;
+
+    if (alsa_mmap)
+        AUDINFO ("Using mmap transfer.\n");
+    else
+    {
+        if (aud_get_bool ("alsa", "mmap"))
+            AUDWARN ("Device does not support mmap; using read/write transfer.\n");
+
+        CHECK_STR (error, snd_pcm_hw_params_set_access, alsa_handle, params,
+         SND_PCM_ACCESS_RW_INTERLEAVED);
+    }
 
     CHECK_STR (error, snd_pcm_hw_params_set_format, alsa_handle, params, format);
     CHECK_STR (error, snd_pcm_hw_params_set_channels, alsa_handle, params, channels);
@@ -346,6 +466,17 @@ bool ALSAPlugin::open_audio (int aud_format, int rate, int channels, String & er
     alsa_channels = channels;
     alsa_rate = rate;
 
+    /* A fixed period is set first, so that the buffer time is chosen to fit
+     * it rather than the other way around. */
+    period = aud_get_int ("alsa", "period");
+    if (period > 0)
+    {
+        useconds = 1000 * period;
+        direction = 0;
+        CHECK_STR (error, snd_pcm_hw_params_set_period_time_near, alsa_handle,
+         params, & useconds, & direction);
+    }
+
     total_buffer = aud_get_int ("output_buffer_size");
     useconds = 1000 * aud::min (1000, total_buffer / 2);
     direction = 0;
@@ -353,11 +484,18 @@ bool ALSAPlugin::open_audio (int aud_format, int rate, int channels, String & er
      params, & useconds, & direction);
     hard_buffer = useconds / 1000;
 
-    useconds = 1000 * (hard_buffer / 4);
+    if (period <= 0)
+    {
+        useconds = 1000 * (hard_buffer / 4);
+        direction = 0;
+        CHECK_STR (error, snd_pcm_hw_params_set_period_time_near, alsa_handle,
+         params, & useconds, & direction);
+    }
+
     direction = 0;
-    CHECK_STR (error, snd_pcm_hw_params_set_period_time_near, alsa_handle,
-     params, & useconds, & direction);
-    alsa_period = useconds / 1000;
+    CHECK_STR (error, snd_pcm_hw_params_get_period_time, params, & useconds,
+     & direction);
+    alsa_period = aud::max (1u, useconds / 1000);
 
     CHECK_STR (error, snd_pcm_hw_params, alsa_handle, params);
 
@@ -366,7 +504,9 @@ bool ALSAPlugin::open_audio (int aud_format, int rate, int channels, String & er
      hard_buffer, soft_buffer, alsa_period);
 
     buffer_frames = aud::rescale<int64_t> (soft_buffer, 1000, rate);
-    alsa_buffer.alloc (snd_pcm_frames_to_bytes (alsa_handle, buffer_frames));
+    alsa_buffer.insert (0, snd_pcm_frames_to_bytes (alsa_handle, buffer_frames));
+    buffer_written.store (0);
+    buffer_read.store (0);
 
     alsa_prebuffer = true;
     alsa_paused = false;
@@ -381,6 +521,8 @@ bool ALSAPlugin::open_audio (int aud_format, int rate, int channels, String & er
     return true;
 
 FAILED:
+    alsa_buffer.clear ();
+
     if (alsa_handle)
     {
         snd_pcm_close (alsa_handle);
@@ -402,7 +544,7 @@ void ALSAPlugin::close_audio ()
     CHECK (snd_pcm_drop, alsa_handle);
 
 FAILED:
-    alsa_buffer.destroy ();
+    alsa_buffer.clear ();
     poll_cleanup ();
     snd_pcm_close (alsa_handle);
     alsa_handle = nullptr;
@@ -412,19 +554,17 @@ FAILED:
 
 int ALSAPlugin::write_audio (const void * data, int length)
 {
-    pthread_mutex_lock (& alsa_mutex);
-
-    length = aud::min (length, alsa_buffer.space ());
-    alsa_buffer.copy_in ((const char *) data, length);
+    length = aud::min (length, buffer_space ());
+    buffer_copy_in ((const char *) data, length);
 
     AUDDBG ("Buffer fill levels: low = %d%%, high = %d%%.\n",
-            (alsa_buffer.len () - length) * 100 / alsa_buffer.size (),
-            alsa_buffer.len () * 100 / alsa_buffer.size ());
+            (buffer_len () - length) * 100 / alsa_buffer.len (),
+            buffer_len () * 100 / alsa_buffer.len ());
 
-    if (! alsa_prebuffer && ! alsa_paused)
-        pthread_cond_broadcast (& alsa_cond);
+    /* pairs with the check in pump() after setting pump_idle */
+    if (pump_idle.load ())
+        poll_wake ();
 
-    pthread_mutex_unlock (& alsa_mutex);
     return length;
 }
 
@@ -432,7 +572,7 @@ void ALSAPlugin::period_wait ()
 {
     pthread_mutex_lock (& alsa_mutex);
 
-    while (! alsa_buffer.space ())
+    while (! buffer_space ())
     {
         if (! alsa_paused)
         {
@@ -458,7 +598,7 @@ void ALSAPlugin::drain ()
     if (alsa_prebuffer)
         start_playback ();
 
-    while (snd_pcm_bytes_to_frames (alsa_handle, alsa_buffer.len ()))
+    while (snd_pcm_bytes_to_frames (alsa_handle, buffer_len ()))
         pthread_cond_wait (& alsa_cond, & alsa_mutex);
 
     if (! alsa_prebuffer)
@@ -492,7 +632,7 @@ int ALSAPlugin::get_delay ()
 {
     pthread_mutex_lock (& alsa_mutex);
 
-    int buffered = snd_pcm_bytes_to_frames (alsa_handle, alsa_buffer.len ());
+    int buffered = snd_pcm_bytes_to_frames (alsa_handle, buffer_len ());
     int delay = aud::rescale (buffered, alsa_rate, 1000);
 
     if (alsa_prebuffer || alsa_paused)
@@ -512,7 +652,7 @@ void ALSAPlugin::flush ()
     CHECK (snd_pcm_drop, alsa_handle);
 
 FAILED:
-    alsa_buffer.discard ();
+    buffer_discard (buffer_len ());
 
     alsa_prebuffer = true;
     alsa_paused_delay = 0;
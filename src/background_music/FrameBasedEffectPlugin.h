@@ -18,20 +18,19 @@
  * implied. In no event shall the authors be liable for any damages arising from
  * the use of this software.
  */
+#include "../effect-common/profile.h"
 #include "LoudnessFrameProcessor.h"
 #include <libaudcore/plugin.h>
 
 class FrameBasedEffectPlugin : public EffectPlugin
 {
-    Index<float> frame_in;
-    Index<float> frame_out;
-    Index<float> output;
-    int current_channels = 0, current_rate = 0, channel_last_read = 0;
+    int current_channels = 0, current_rate = 0;
     LoudnessFrameProcessor detection;
+    EffectProfile profile;
 
 public:
     FrameBasedEffectPlugin(const PluginInfo & info, int order)
-        : EffectPlugin(info, order, true)
+        : EffectPlugin(info, order, true), profile(info.name)
     {
     }
 
@@ -43,53 +42,33 @@ public:
         return true;
     }
 
-    void cleanup() final
-    {
-        output.clear();
-        frame_in.clear();
-        frame_out.clear();
-    }
+    void cleanup() final {}
 
     void start(int & channels, int & rate) final
     {
         current_channels = channels;
         current_rate = rate;
-        channel_last_read = 0;
 
+        profile.start(channels, rate);
         detection.start(channels, rate);
-        frame_in.resize(current_channels);
-        frame_out.resize(current_channels);
 
         flush(false);
     }
 
     Index<float> & process(Index<float> & data) final
     {
-        detection.update_config();
-
-        int output_samples = 0;
-        output.resize(0);
-
-        // It is assumed data always contains a multiple of channels, but we
-        // don't care.
-        for (const float sample : data)
-        {
-            frame_in[channel_last_read++] = sample;
-            if (channel_last_read == current_channels)
-            {
-                // Processing happens per frame. Because of read-ahead there is
-                // not always output available yet.
-                if (detection.process_has_output(frame_in, frame_out))
-                {
-                    output.move_from(frame_out, 0, output_samples,
-                                     current_channels, true, false);
-                    output_samples += current_channels;
-                }
-                channel_last_read = 0;
-            }
-        }
-
-        return output;
+        EffectProfile::Timer timer(profile, data);
+        detection.update_config_if_changed();
+
+        // Audio is always passed in whole frames. Because of read-ahead there
+        // is not always output available yet, so the processed block can
+        // shrink.
+        const int frames = data.len() / current_channels;
+        const int output_frames =
+            detection.process_block(data.begin(), frames);
+        data.resize(output_frames * current_channels);
+
+        return data;
     }
 
     bool flush(bool force) final
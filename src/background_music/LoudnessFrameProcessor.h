@@ -21,6 +21,7 @@
 #include "Integrator.h"
 #include "Loudness.h"
 #include "basic_config.h"
+#include <atomic>
 #include <cmath>
 #include <libaudcore/runtime.h>
 
@@ -47,6 +48,47 @@ class LoudnessFrameProcessor
     int channels_ = 0;
     int processed_frames = 0;
 
+    /*
+     * Set from the preferences callbacks so that the audio thread only reads
+     * the configuration when it actually changed.
+     */
+    static std::atomic<bool> & config_changed()
+    {
+        static std::atomic<bool> changed(true);
+        return changed;
+    }
+
+    /*
+     * Feeds one frame into the detection and the read-ahead buffer. Returns
+     * the gain for the frame that comes out of the read-ahead buffer, which is
+     * only valid if output was available.
+     */
+    float analyze_frame(const float * frame)
+    {
+        read_ahead_buffer.copy_in(frame, channels_);
+
+        float square_sum = 0.0;
+        float square_max = 0.0;
+        for (int channel = 0; channel < channels_; channel++)
+        {
+            const float square = frame[channel] * frame[channel];
+            square_max = std::max(square_max, square);
+            square_sum += square;
+        }
+        square_sum /= static_cast<float>(channels_);
+        square_sum += square_max;
+        const float perceived = FAST_VU_FUDGE_FACTOR *
+                                perceivedLoudness.get_mean_squared(square_sum);
+        const double weighted =
+            std::max(long_integration.integrate(square_sum), perceived);
+
+        const double rms = sqrt(weighted);
+
+        return target_level /
+               std::max(minimum_detection,
+                        static_cast<float>(release_integration.get_envelope(rms)));
+    }
+
     static float get_clamped_value(const char * variable, const double minimum,
                                    const double maximum)
     {
@@ -97,7 +139,9 @@ public:
          * must therefore half the integration time.
          */
         perceivedLoudness.set_rate_and_value(rate, target_level);
-        const int alloc_size = channels_ * latency();
+        // One extra frame, as the input frame is stored before the oldest one
+        // is taken out.
+        const int alloc_size = channels_ * (latency() + 1);
 
         if (read_ahead_buffer.size() < alloc_size)
         {
@@ -105,6 +149,16 @@ public:
         }
     }
 
+    static void notify_config_changed() { config_changed().store(true); }
+
+    void update_config_if_changed()
+    {
+        if (config_changed().exchange(false))
+        {
+            update_config();
+        }
+    }
+
     void update_config()
     {
         target_level = get_clamped_decibel_value(CONF_TARGET_LEVEL_VARIABLE,
@@ -122,56 +176,39 @@ public:
         long_integration.set_scale(slow_weight);
     }
 
-    bool process_has_output(const Index<float> & frame_in,
-                            Index<float> & frame_out)
+    /*
+     * Processes a block of interleaved frames in place. Because of read-ahead,
+     * the output lags the input by latency() frames: the returned number of
+     * frames is written to the start of data and may be less than frames.
+     * Output never overtakes input, so no extra buffer is needed.
+     */
+    int process_block(float * data, const int frames)
     {
-        bool has_output_data = processed_frames >= latency();
-        if (has_output_data)
-        {
-            read_ahead_buffer.move_out(frame_out.begin(), channels_);
-        }
-        else
-        {
-            processed_frames++;
-        }
-        read_ahead_buffer.copy_in(frame_in.begin(), channels_);
-
-        /*
-         * Following calculations need to happen to anticipate the (future)
-         * output.
-         */
+        const float * in = data;
+        float * out = data;
+        int output_frames = 0;
 
-        float square_sum = 0.0;
-        float square_max = 0.0;
-        for (const float sample : frame_in)
+        for (int frame = 0; frame < frames; frame++, in += channels_)
         {
-            const float square = sample * sample;
-            square_max = std::max(square_max, square);
-            square_sum += square;
-        }
-        square_sum /= static_cast<float>(channels_);
-        square_sum += square_max;
-        const float perceived = FAST_VU_FUDGE_FACTOR *
-                                perceivedLoudness.get_mean_squared(square_sum);
-        const double weighted =
-            std::max(long_integration.integrate(square_sum), perceived);
-
-        const double rms = sqrt(weighted);
+            const float gain = analyze_frame(in);
 
-        const float gain =
-            target_level /
-            std::max(minimum_detection,
-                     static_cast<float>(release_integration.get_envelope(rms)));
+            if (processed_frames < latency())
+            {
+                processed_frames++;
+                continue;
+            }
 
-        if (has_output_data)
-        {
-            for (float & sample : frame_out)
+            read_ahead_buffer.move_out(out, channels_);
+            for (int channel = 0; channel < channels_; channel++)
             {
-                sample *= gain;
+                out[channel] *= gain;
             }
+
+            out += channels_;
+            output_frames++;
         }
 
-        return has_output_data;
+        return output_frames;
     }
 
     void flush()
@@ -24,6 +24,8 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/profile.h"
+
 static const char * const bitcrusher_defaults[] = {
  "depth", "32",
  "downsample", "1.0",
@@ -68,6 +70,8 @@ private:
 
 EXPORT Bitcrusher aud_plugin_instance;
 
+static EffectProfile profile (N_("Bitcrusher"));
+
 bool
 Bitcrusher::init ()
 {
@@ -84,6 +88,8 @@ Bitcrusher::cleanup ()
 void
 Bitcrusher::start (int & channels, int & rate)
 {
+    profile.start (channels, rate);
+
     m_accumulator = 0.0f;
     m_channels = channels;
 
@@ -94,6 +100,8 @@ Bitcrusher::start (int & channels, int & rate)
 Index<float> &
 Bitcrusher::process (Index<float> & data)
 {
+    EffectProfile::Timer timer (profile, data);
+
     float downsample_ratio = aud_get_double ("bitcrusher", "downsample");
     float bit_depth = aud_get_double ("bitcrusher", "depth");
 
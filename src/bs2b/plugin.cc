@@ -27,6 +27,8 @@
 
 #include <bs2b.h>
 
+#include "../effect-common/profile.h"
+
 class BS2BPlugin : public EffectPlugin
 {
 public:
@@ -52,6 +54,8 @@ public:
 
 EXPORT BS2BPlugin aud_plugin_instance;
 
+static EffectProfile profile (N_("Bauer Stereophonic-to-Binaural (BS2B)"));
+
 static t_bs2bdp bs2b = nullptr;
 static int bs2b_channels;
 
@@ -82,12 +86,16 @@ void BS2BPlugin::cleanup ()
 
 void BS2BPlugin::start (int & channels, int & rate)
 {
+    profile.start (channels, rate);
+
     bs2b_channels = channels;
     bs2b_set_srate (bs2b, rate);
 }
 
 Index<float> & BS2BPlugin::process (Index<float> & data)
 {
+    EffectProfile::Timer timer (profile, data);
+
     if (bs2b_channels == 2)
         bs2b_cross_feed_f (bs2b, data.begin (), data.len () / 2);
 
@@ -28,6 +28,17 @@
 #include <libaudcore/ringbuf.h>
 #include <libaudcore/runtime.h>
 
+#include "../effect-common/profile.h"
+#include "limiter.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define USE_X86_KERNELS
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_NEON_KERNELS
+#endif
+
 /* Response time adjustments.  Maybe this should be adjustable? */
 #define CHUNK_TIME 0.2f /* seconds */
 #define CHUNKS 5
@@ -38,17 +49,41 @@
 static const char * const compressor_defaults[] = {
     "center", "0.5",
     "range", "0.5",
+    "limiter", "FALSE",
+    "limiter_ceiling", "-1",
+    "limiter_lookahead", "5",
+    "limiter_release", "50",
      nullptr
 };
 
+static void update_config ();
+
 static const PreferencesWidget compressor_widgets[] = {
     WidgetLabel (N_("<b>Compression</b>")),
     WidgetSpin (N_("Center volume:"),
-        WidgetFloat ("compressor", "center"),
+        WidgetFloat ("compressor", "center", update_config),
         {0.1, 1, 0.1}),
     WidgetSpin (N_("Dynamic range:"),
-        WidgetFloat ("compressor", "range"),
-        {0.0, 3.0, 0.1})
+        WidgetFloat ("compressor", "range", update_config),
+        {0.0, 3.0, 0.1}),
+    WidgetLabel (N_("<b>Limiter</b>")),
+    WidgetCheck (N_("Look-ahead true-peak limiter"),
+        WidgetBool ("compressor", "limiter", update_config)),
+    WidgetSpin (N_("Ceiling:"),
+        WidgetFloat ("compressor", "limiter_ceiling", update_config),
+        {-12.0, 0.0, 0.1, N_("dBTP")},
+        WIDGET_CHILD),
+    WidgetSpin (N_("Look-ahead:"),
+        WidgetFloat ("compressor", "limiter_lookahead"),
+        {1.0, 20.0, 0.5, N_("ms")},
+        WIDGET_CHILD),
+    WidgetSpin (N_("Release:"),
+        WidgetFloat ("compressor", "limiter_release", update_config),
+        {10.0, 1000.0, 10.0, N_("ms")},
+        WIDGET_CHILD),
+    WidgetLabel (N_("Changes to the look-ahead take effect\n"
+                    "when the next song starts."),
+        WIDGET_CHILD)
 };
 
 static const PluginPreferences compressor_prefs = {{compressor_widgets}};
@@ -81,17 +116,213 @@ public:
 
 EXPORT Compressor aud_plugin_instance;
 
+static EffectProfile profile (N_("Dynamic Range Compressor"));
+
 /* The read pointer of the ring buffer is kept aligned to the chunk size at all
  * times.  To preserve the alignment, each read from the buffer must either (a)
  * read a multiple of the chunk size or (b) empty the buffer completely.  Writes
  * to the buffer need not be aligned to the chunk size. */
 
 static RingBuf<float> buffer, peaks;
-static Index<float> output;
+static Index<float> output, limited;
+static Limiter limiter;
 static int chunk_size;
 static float current_peak;
 static int current_channels, current_rate;
 
+static float cfg_center, cfg_range;
+static bool cfg_limiter;
+
+static void update_config ()
+{
+    cfg_center = aud_get_double ("compressor", "center");
+    cfg_range = aud_get_double ("compressor", "range");
+    cfg_limiter = aud_get_bool ("compressor", "limiter");
+
+    limiter.set_params (powf (10, aud_get_double ("compressor", "limiter_ceiling") / 20),
+     aud_get_double ("compressor", "limiter_release"));
+}
+
+/* The inner loops are provided in several flavors; the fastest one supported
+ * by the CPU is picked once in init().  Each returns or applies exactly what
+ * the generic version does, apart from floating-point rounding. */
+
+struct Kernels {
+    float (* sum_abs) (const float * data, int length);
+    void (* ramp) (float * data, int length, float gain, float step);
+};
+
+static float sum_abs_generic (const float * data, int length)
+{
+    float sum = 0;
+
+    const float * end = data + length;
+    while (data < end)
+        sum += fabsf (* data ++);
+
+    return sum;
+}
+
+/* Multiplies data[n] by (gain + step * n).  The gain is recomputed from the
+ * sample index rather than accumulated, so that rounding errors do not build
+ * up over a chunk. */
+static void ramp_generic (float * data, int length, float gain, float step)
+{
+    for (int count = 0; count < length; count ++)
+        data[count] *= gain + step * count;
+}
+
+#ifdef USE_X86_KERNELS
+
+__attribute__ ((target ("sse2")))
+static float sum_abs_sse2 (const float * data, int length)
+{
+    const __m128 mask = _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff));
+    __m128 sum0 = _mm_setzero_ps ();
+    __m128 sum1 = _mm_setzero_ps ();
+
+    int count = 0;
+    for (; count + 8 <= length; count += 8)
+    {
+        sum0 = _mm_add_ps (sum0, _mm_and_ps (_mm_loadu_ps (data + count), mask));
+        sum1 = _mm_add_ps (sum1, _mm_and_ps (_mm_loadu_ps (data + count + 4), mask));
+    }
+
+    float part[4];
+    _mm_storeu_ps (part, _mm_add_ps (sum0, sum1));
+
+    return part[0] + part[1] + part[2] + part[3] +
+     sum_abs_generic (data + count, length - count);
+}
+
+__attribute__ ((target ("sse2")))
+static void ramp_sse2 (float * data, int length, float gain, float step)
+{
+    const __m128 offsets = _mm_setr_ps (0, 1, 2, 3);
+    const __m128 gain4 = _mm_set1_ps (gain);
+    const __m128 step4 = _mm_set1_ps (step);
+
+    int count = 0;
+    for (; count + 4 <= length; count += 4)
+    {
+        __m128 index = _mm_add_ps (_mm_set1_ps (count), offsets);
+        __m128 g = _mm_add_ps (gain4, _mm_mul_ps (step4, index));
+        _mm_storeu_ps (data + count, _mm_mul_ps (_mm_loadu_ps (data + count), g));
+    }
+
+    for (; count < length; count ++)
+        data[count] *= gain + step * count;
+}
+
+__attribute__ ((target ("avx2")))
+static float sum_abs_avx2 (const float * data, int length)
+{
+    const __m256 mask = _mm256_castsi256_ps (_mm256_set1_epi32 (0x7fffffff));
+    __m256 sum0 = _mm256_setzero_ps ();
+    __m256 sum1 = _mm256_setzero_ps ();
+
+    int count = 0;
+    for (; count + 16 <= length; count += 16)
+    {
+        sum0 = _mm256_add_ps (sum0, _mm256_and_ps (_mm256_loadu_ps (data + count), mask));
+        sum1 = _mm256_add_ps (sum1, _mm256_and_ps (_mm256_loadu_ps (data + count + 8), mask));
+    }
+
+    float part[8];
+    _mm256_storeu_ps (part, _mm256_add_ps (sum0, sum1));
+
+    float sum = 0;
+    for (float p : part)
+        sum += p;
+
+    return sum + sum_abs_generic (data + count, length - count);
+}
+
+__attribute__ ((target ("avx2")))
+static void ramp_avx2 (float * data, int length, float gain, float step)
+{
+    const __m256 offsets = _mm256_setr_ps (0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 gain8 = _mm256_set1_ps (gain);
+    const __m256 step8 = _mm256_set1_ps (step);
+
+    int count = 0;
+    for (; count + 8 <= length; count += 8)
+    {
+        __m256 index = _mm256_add_ps (_mm256_set1_ps (count), offsets);
+        __m256 g = _mm256_add_ps (gain8, _mm256_mul_ps (step8, index));
+        _mm256_storeu_ps (data + count, _mm256_mul_ps (_mm256_loadu_ps (data + count), g));
+    }
+
+    for (; count < length; count ++)
+        data[count] *= gain + step * count;
+}
+
+#endif // USE_X86_KERNELS
+
+#ifdef USE_NEON_KERNELS
+
+static float sum_abs_neon (const float * data, int length)
+{
+    float32x4_t sum0 = vdupq_n_f32 (0);
+    float32x4_t sum1 = vdupq_n_f32 (0);
+
+    int count = 0;
+    for (; count + 8 <= length; count += 8)
+    {
+        sum0 = vaddq_f32 (sum0, vabsq_f32 (vld1q_f32 (data + count)));
+        sum1 = vaddq_f32 (sum1, vabsq_f32 (vld1q_f32 (data + count + 4)));
+    }
+
+    float part[4];
+    vst1q_f32 (part, vaddq_f32 (sum0, sum1));
+
+    return part[0] + part[1] + part[2] + part[3] +
+     sum_abs_generic (data + count, length - count);
+}
+
+static void ramp_neon (float * data, int length, float gain, float step)
+{
+    static const float offsets_init[4] = {0, 1, 2, 3};
+    const float32x4_t offsets = vld1q_f32 (offsets_init);
+    const float32x4_t gain4 = vdupq_n_f32 (gain);
+
+    int count = 0;
+    for (; count + 4 <= length; count += 4)
+    {
+        float32x4_t index = vaddq_f32 (vdupq_n_f32 (count), offsets);
+        float32x4_t g = vmlaq_n_f32 (gain4, index, step);
+        vst1q_f32 (data + count, vmulq_f32 (vld1q_f32 (data + count), g));
+    }
+
+    for (; count < length; count ++)
+        data[count] *= gain + step * count;
+}
+
+#endif // USE_NEON_KERNELS
+
+static Kernels kernels = {sum_abs_generic, ramp_generic};
+
+static void select_kernels ()
+{
+#ifdef USE_X86_KERNELS
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("avx2"))
+    {
+        AUDDBG ("Using AVX2 kernels.\n");
+        kernels = {sum_abs_avx2, ramp_avx2};
+    }
+    else if (__builtin_cpu_supports ("sse2"))
+    {
+        AUDDBG ("Using SSE2 kernels.\n");
+        kernels = {sum_abs_sse2, ramp_sse2};
+    }
+#elif defined(USE_NEON_KERNELS)
+    AUDDBG ("Using NEON kernels.\n");
+    kernels = {sum_abs_neon, ramp_neon};
+#endif
+}
+
 /* I used to find the maximum sample and take that as the peak, but that doesn't
  * work well on badly clipped tracks.  Now, I use the highly sophisticated
  * method of averaging the absolute value of the samples and multiplying by 6, a
@@ -100,32 +331,53 @@ static int current_channels, current_rate;
 
 static float calc_peak (float * data, int length)
 {
-    float sum = 0;
-
-    float * end = data + length;
-    while (data < end)
-        sum += fabsf (* data ++);
+    return aud::max (0.01f, kernels.sum_abs (data, length) / length * 6);
+}
 
-    return aud::max (0.01f, sum / length * 6);
+static float calc_gain (float peak)
+{
+    return powf (peak / cfg_center, cfg_range - 1);
 }
 
 static void do_ramp (float * data, int length, float peak_a, float peak_b)
 {
-    float center = aud_get_double ("compressor", "center");
-    float range = aud_get_double ("compressor", "range");
-    float a = powf (peak_a / center, range - 1);
-    float b = powf (peak_b / center, range - 1);
+    float a = calc_gain (peak_a);
+    float b = (peak_b == peak_a) ? a : calc_gain (peak_b);
 
-    for (int count = 0; count < length; count ++)
+    kernels.ramp (data, length, a, (b - a) / length);
+}
+
+/* Runs the compressed audio through the limiter, if it is enabled.  Frames
+ * still held by the limiter are pushed out if it has just been disabled or if
+ * drain is set. */
+static Index<float> & limit (Index<float> & data, bool drain)
+{
+    if (! cfg_limiter && ! limiter.latency ())
+        return data;
+
+    limited.resize (0);
+
+    if (cfg_limiter)
     {
-        * data = (* data) * (a * (length - count) + b * count) / length;
-        data ++;
+        limiter.process (data.begin (), data.len () / current_channels, limited);
+
+        if (drain)
+            limiter.drain (limited);
     }
+    else
+    {
+        limiter.drain (limited);
+        limited.insert (data.begin (), -1, data.len ());
+    }
+
+    return limited;
 }
 
 bool Compressor::init ()
 {
     aud_config_set_defaults ("compressor", compressor_defaults);
+    update_config ();
+    select_kernels ();
     return true;
 }
 
@@ -134,10 +386,14 @@ void Compressor::cleanup ()
     buffer.destroy ();
     peaks.destroy ();
     output.clear ();
+    limited.clear ();
+    limiter.cleanup ();
 }
 
 void Compressor::start (int & channels, int & rate)
 {
+    profile.start (channels, rate);
+
     current_channels = channels;
     current_rate = rate;
 
@@ -146,11 +402,16 @@ void Compressor::start (int & channels, int & rate)
     buffer.alloc (chunk_size * CHUNKS);
     peaks.alloc (CHUNKS);
 
+    limiter.start (channels, rate, aud_get_double ("compressor", "limiter_lookahead"));
+    update_config ();
+
     flush (true);
 }
 
 Index<float> & Compressor::process (Index<float> & data)
 {
+    EffectProfile::Timer timer (profile, data);
+
     output.resize (0);
 
     int offset = 0;
@@ -190,13 +451,14 @@ Index<float> & Compressor::process (Index<float> & data)
         peaks.pop ();
     }
 
-    return output;
+    return limit (output, false);
 }
 
 bool Compressor::flush (bool force)
 {
     buffer.discard ();
     peaks.discard ();
+    limiter.flush ();
 
     current_peak = 0.0f;
     return true;
@@ -204,6 +466,8 @@ bool Compressor::flush (bool force)
 
 Index<float> & Compressor::finish (Index<float> & data, bool end_of_playlist)
 {
+    EffectProfile::Timer timer (profile, data);
+
     output.resize (0);
 
     peaks.discard ();
@@ -223,10 +487,11 @@ Index<float> & Compressor::finish (Index<float> & data, bool end_of_playlist)
 
     output.insert (data.begin (), -1, data.len ());
 
-    return output;
+    return limit (output, true);
 }
 
 int Compressor::adjust_delay (int delay)
 {
-    return delay + aud::rescale<int64_t> (buffer.len () / current_channels, current_rate, 1000);
+    int frames = buffer.len () / current_channels + limiter.latency ();
+    return delay + aud::rescale<int64_t> (frames, current_rate, 1000);
 }
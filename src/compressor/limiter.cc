@@ -0,0 +1,250 @@
+/*
+ * Look-ahead True-Peak Limiter for the Dynamic Range Compression Plugin
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <libaudcore/audio.h>
+#include <libaudcore/objects.h>
+
+#include "limiter.h"
+
+/* Blackman-windowed sinc, nonzero for |t| < half_width */
+static float interp_kernel (float t, float half_width)
+{
+    if (t == 0.0f)
+        return 1.0f;
+
+    float u = t / half_width;
+    float window = 0.42f + 0.5f * cosf (M_PI * u) + 0.08f * cosf (2 * M_PI * u);
+
+    return sinf (M_PI * t) / (M_PI * t) * window;
+}
+
+void Limiter::start (int channels, int rate, float lookahead_ms)
+{
+    m_channels = channels;
+    m_rate = rate;
+
+    m_window = aud::max (1, (int) (rate * lookahead_ms / 1000));
+    m_delay = TAPS / 2 + m_window - 1;
+
+    /* branch p interpolates the point p/4 of a frame after the sample that
+     * lies TAPS/2 frames in the past; branch 0 is that sample itself */
+    for (int p = 1; p < PHASES; p ++)
+    {
+        float sum = 0;
+
+        for (int k = 0; k < TAPS; k ++)
+        {
+            float t = k - TAPS / 2 + (float) p / PHASES;
+            m_coefs[p - 1][k] = interp_kernel (t, TAPS / 2);
+            sum += m_coefs[p - 1][k];
+        }
+
+        for (int k = 0; k < TAPS; k ++)
+            m_coefs[p - 1][k] /= sum;
+    }
+
+    m_history.resize (channels * 2 * TAPS);
+    m_audio.resize (channels * (m_delay + 1));
+    m_queue_pos.resize (m_window);
+    m_queue_gain.resize (m_window);
+    m_mins.resize (m_window);
+
+    set_params (m_ceiling, m_release_ms);
+    flush ();
+}
+
+void Limiter::cleanup ()
+{
+    m_history.clear ();
+    m_audio.clear ();
+    m_queue_pos.clear ();
+    m_queue_gain.clear ();
+    m_mins.clear ();
+}
+
+void Limiter::set_params (float ceiling, float release_ms)
+{
+    m_ceiling = ceiling;
+    m_release_ms = release_ms;
+
+    if (m_rate > 0 && release_ms > 0)
+        m_release = 1 - expf (-1000 / (release_ms * m_rate));
+    else
+        m_release = 1;
+}
+
+void Limiter::flush ()
+{
+    memset (m_history.begin (), 0, sizeof (float) * m_history.len ());
+    m_history_pos = 0;
+
+    m_audio_pos = 0;
+    m_held = 0;
+    m_real = 0;
+
+    m_queue_head = 0;
+    m_queue_len = 0;
+    m_frame_count = 0;
+
+    for (float & min : m_mins)
+        min = 1;
+
+    m_mins_pos = 0;
+    m_mins_sum = m_window;
+
+    m_gain = 1;
+}
+
+/* Adds one frame to the filter history and returns the largest absolute value
+ * found between the frame that is TAPS/2 frames old and the one after it. */
+float Limiter::true_peak (const float * frame)
+{
+    int w = m_history_pos;
+    m_history_pos = (m_history_pos + 1) % TAPS;
+
+    float peak = 0;
+
+    for (int c = 0; c < m_channels; c ++)
+    {
+        float * hist = & m_history[c * 2 * TAPS];
+        hist[w] = hist[w + TAPS] = frame[c];
+
+        /* newest sample first */
+        const float * newest = hist + w + TAPS;
+
+        peak = aud::max (peak, fabsf (newest[-TAPS / 2]));
+
+        for (int p = 0; p < PHASES - 1; p ++)
+        {
+            float sum = 0;
+            for (int k = 0; k < TAPS; k ++)
+                sum += newest[-k] * m_coefs[p][k];
+
+            peak = aud::max (peak, fabsf (sum));
+        }
+    }
+
+    return peak;
+}
+
+/* Adds one frame to the delay line and, if the delay line is full, writes the
+ * oldest frame with gain applied to out.  Returns true if a frame was
+ * written. */
+bool Limiter::push_frame (const float * frame, bool real, float * out)
+{
+    float peak = true_peak (frame);
+    float required = (peak > m_ceiling) ? m_ceiling / peak : 1.0f;
+
+    /* sliding window minimum of the required gain */
+    int64_t now = m_frame_count ++;
+
+    while (m_queue_len && m_queue_gain[(m_queue_head + m_queue_len - 1) %
+     m_window] >= required)
+        m_queue_len --;
+
+    int tail = (m_queue_head + m_queue_len) % m_window;
+    m_queue_pos[tail] = now;
+    m_queue_gain[tail] = required;
+    m_queue_len ++;
+
+    if (m_queue_pos[m_queue_head] <= now - m_window)
+    {
+        m_queue_head = (m_queue_head + 1) % m_window;
+        m_queue_len --;
+    }
+
+    float window_min = m_queue_gain[m_queue_head];
+
+    /* moving average of the minimum */
+    m_mins_sum += window_min - m_mins[m_mins_pos];
+    m_mins[m_mins_pos] = window_min;
+    m_mins_pos = (m_mins_pos + 1) % m_window;
+
+    float target = aud::min ((float) (m_mins_sum / m_window), 1.0f);
+
+    /* attack instantly, release slowly */
+    if (target < m_gain)
+        m_gain = target;
+    else
+        m_gain += (target - m_gain) * m_release;
+
+    /* the delay line is m_delay + 1 frames long, so once it is full, the
+     * frame after the one just written is the oldest */
+    memcpy (& m_audio[m_audio_pos * m_channels], frame, sizeof (float) * m_channels);
+    m_audio_pos = (m_audio_pos + 1) % (m_delay + 1);
+
+    m_held ++;
+    if (real)
+        m_real ++;
+
+    if (m_held < m_delay + 1)
+        return false;
+
+    const float * oldest = & m_audio[m_audio_pos * m_channels];
+    bool written = false;
+
+    /* padding frames are only ever added after all the real ones */
+    if (m_real)
+    {
+        for (int c = 0; c < m_channels; c ++)
+            out[c] = oldest[c] * m_gain;
+
+        m_real --;
+        written = true;
+    }
+
+    m_held --;
+
+    return written;
+}
+
+void Limiter::process (const float * data, int frames, Index<float> & out)
+{
+    int written = out.len ();
+    out.resize (written + frames * m_channels);
+
+    for (int f = 0; f < frames; f ++)
+    {
+        if (push_frame (data + f * m_channels, true, & out[written]))
+            written += m_channels;
+    }
+
+    out.resize (written);
+}
+
+void Limiter::drain (Index<float> & out)
+{
+    float silence[AUD_MAX_CHANNELS] {};
+
+    int written = out.len ();
+    out.resize (written + m_real * m_channels);
+
+    while (m_real)
+    {
+        if (push_frame (silence, false, & out[written]))
+            written += m_channels;
+    }
+
+    out.resize (written);
+
+    flush ();
+}
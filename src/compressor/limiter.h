@@ -0,0 +1,95 @@
+/*
+ * Look-ahead True-Peak Limiter for the Dynamic Range Compression Plugin
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef COMPRESSOR_LIMITER_H
+#define COMPRESSOR_LIMITER_H
+
+#include <libaudcore/index.h>
+
+/* The limiter estimates the true (inter-sample) peak of each frame by 4x
+ * oversampling with a polyphase FIR filter.  From the peak, it computes the
+ * gain needed to keep the frame under the ceiling.  The minimum of that gain
+ * over the look-ahead window is tracked with a monotonic queue and then
+ * smoothed with a moving average of the same length.  Both steps cost O(1) per
+ * frame, and together they guarantee that the gain applied to a frame is never
+ * more than the gain that frame requires.  The audio itself is delayed to line
+ * up with the gain. */
+
+class Limiter
+{
+public:
+    void start (int channels, int rate, float lookahead_ms);
+    void cleanup ();
+
+    /* ceiling is a linear amplitude; release is a time in milliseconds */
+    void set_params (float ceiling, float release_ms);
+
+    /* appends the limited frames to out */
+    void process (const float * data, int frames, Index<float> & out);
+
+    /* pushes out all frames still held in the delay line */
+    void drain (Index<float> & out);
+
+    void flush ();
+
+    /* number of frames currently held back */
+    int latency () const
+        { return m_real; }
+
+private:
+    /* taps per polyphase branch; the filter is 4 * TAPS long */
+    static constexpr int TAPS = 12;
+    static constexpr int PHASES = 4;
+
+    float true_peak (const float * frame);
+    bool push_frame (const float * frame, bool real, float * out);
+
+    int m_channels = 0, m_rate = 0;
+    int m_window = 0; /* look-ahead in frames */
+    int m_delay = 0;  /* total audio delay in frames */
+
+    float m_ceiling = 1, m_release_ms = 0, m_release = 1;
+
+    float m_coefs[PHASES - 1][TAPS] {};
+
+    /* per channel, TAPS samples of history stored twice so that a full
+     * history can always be read linearly */
+    Index<float> m_history;
+    int m_history_pos = 0;
+
+    /* circular delay line of m_delay + 1 frames */
+    Index<float> m_audio;
+    int m_audio_pos = 0;
+    int m_held = 0, m_real = 0;
+
+    /* monotonic queue of (frame number, required gain) */
+    Index<int64_t> m_queue_pos;
+    Index<float> m_queue_gain;
+    int m_queue_head = 0, m_queue_len = 0;
+    int64_t m_frame_count = 0;
+
+    /* moving average of the window minimum */
+    Index<float> m_mins;
+    int m_mins_pos = 0;
+    double m_mins_sum = 0;
+
+    float m_gain = 1;
+};
+
+#endif // COMPRESSOR_LIMITER_H
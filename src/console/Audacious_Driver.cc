@@ -11,12 +11,17 @@
 #include <string.h>
 
 #include <libaudcore/audstrings.h>
+#include <libaudcore/index.h>
 #include <libaudcore/runtime.h>
 
 #include "configure.h"
 #include "plugin.h"
 #include "Music_Emu.h"
 #include "Gzip_Reader.h"
+#include "Vgm_Emu.h"
+#include "blargg_endian.h"
+
+#include "../render-common/measure.h"
 
 static const int fade_threshold = 10 * 1000;
 static const int fade_length    = 8 * 1000;
@@ -53,11 +58,16 @@ public:
     // emulator couldn't be created, returns 1.
     int load(int sample_rate);
 
+    // True if playing the file claims the YM2413 core, whose tables are
+    // shared by all emulators and built for one clock and sample rate
+    bool uses_ym2413() const;
+
     // Deletes owned emu and closes file
     ~ConsoleFileHandler();
 
 private:
-    char m_header[4];
+    char m_header[Vgm_Emu::header_size];
+    int m_header_size;
     Vfs_File_Reader vfs_in;
     Gzip_Reader gzip_in;
 };
@@ -67,6 +77,7 @@ ConsoleFileHandler::ConsoleFileHandler(const char *path, VFSFile &fd)
     m_emu   = nullptr;
     m_type  = 0;
     m_track = -1;
+    m_header_size = 4;
 
     const char * sub;
     uri_parse (path, nullptr, nullptr, & sub, & m_track);
@@ -82,7 +93,7 @@ ConsoleFileHandler::ConsoleFileHandler(const char *path, VFSFile &fd)
         return;
 
     // read and identify header
-    if (!log_err(gzip_in.read(m_header, sizeof(m_header))))
+    if (!log_err(gzip_in.read(m_header, m_header_size)))
     {
         m_type = gme_identify_extension(gme_identify_header(m_header));
         if (!m_type)
@@ -92,6 +103,12 @@ ConsoleFileHandler::ConsoleFileHandler(const char *path, VFSFile &fd)
                 m_type = 0;
         }
     }
+
+    // keep the rest of a VGM header for uses_ym2413()
+    if ((m_type == gme_vgm_type || m_type == gme_vgz_type) &&
+        gzip_in.remain() > (long)sizeof(m_header) - m_header_size &&
+        !log_err(gzip_in.read(m_header + m_header_size, sizeof(m_header) - m_header_size)))
+        m_header_size = sizeof(m_header);
 }
 
 ConsoleFileHandler::~ConsoleFileHandler()
@@ -112,7 +129,7 @@ int ConsoleFileHandler::load(int sample_rate)
     }
 
     // combine header with remaining file data
-    Remaining_Reader reader(m_header, sizeof(m_header), &gzip_in);
+    Remaining_Reader reader(m_header, m_header_size, &gzip_in);
     if (log_err(m_emu->load(reader)))
         return 1;
 
@@ -144,6 +161,17 @@ int ConsoleFileHandler::load(int sample_rate)
     return 0;
 }
 
+bool ConsoleFileHandler::uses_ym2413() const
+{
+    if (m_header_size < (int)sizeof(m_header))
+        return false;
+
+    // Vgm_Emu plays the YM2612 instead if there is one; an old file whose
+    // rate update_fm_rates() moves to the YM2612 is counted here as well
+    auto &h = *(const Vgm_Emu::header_t *)m_header;
+    return GET_LE32(h.ym2413_rate) && !GET_LE32(h.ym2612_rate);
+}
+
 static int get_track_length(const track_info_t &info)
 {
     int length = info.length;
@@ -158,6 +186,75 @@ static int get_track_length(const track_info_t &info)
     return length;
 }
 
+static int get_sample_rate(gme_type_t type)
+{
+    if (audcfg.resample)
+        return audcfg.resample_rate;
+
+    return (type == gme_spc_type) ? 32000 : 44100;
+}
+
+static void setup_emu(Music_Emu *emu)
+{
+    // stereo echo depth
+    gme_set_stereo_depth(emu, 1.0 / 100 * audcfg.echo);
+
+    // set equalizer
+    if (audcfg.treble || audcfg.bass)
+    {
+        Music_Emu::equalizer_t eq;
+
+        // bass - logarithmic, 2 to 8194 Hz
+        double bass = 1.0 - (audcfg.bass / 200.0 + 0.5);
+        eq.bass = (long) (2.0 + pow( 2.0, bass * 13 ));
+
+        // treble - -50 to 0 to +5 dB
+        double treble = audcfg.treble / 100.0;
+        eq.treble = treble * (treble < 0 ? 50.0 : 5.0);
+
+        emu->set_equalizer(eq);
+    }
+}
+
+// returns the time when the fade starts
+static int setup_fade(Music_Emu *emu, int length)
+{
+    if (length <= 0)
+        length = audcfg.loop_length * 1000;
+    if (length >= fade_threshold + fade_length)
+        length -= fade_length / 2;
+    emu->set_fade(length, fade_length);
+
+    return length;
+}
+
+/* Renders a track into the meter without sending it to the output, as fast
+ * as the emulator runs. Emulators share no state, so several tracks can be
+ * rendered at once from different threads. Returns the time at which the
+ * track ended, or -1 on error; ended is set if it ended by itself (in
+ * silence) before the fade. */
+static int render_track(Music_Emu *emu, int track, int length, TrackMeter &meter, bool &ended)
+{
+    if (log_err(emu->start_track(track)))
+        return -1;
+
+    int fade_start = setup_fade(emu, length);
+
+    while (!emu->track_ended() && emu->tell() < fade_start + fade_length)
+    {
+        int const buf_size = 1024;
+        Music_Emu::sample_t buf[buf_size];
+
+        if (log_err(emu->play(buf_size, buf)))
+            return -1;
+
+        meter.add(buf, buf_size);
+    }
+
+    ended = (emu->tell() < fade_start);
+    return emu->tell();
+}
+
 bool ConsolePlugin::read_tag(const char *filename, VFSFile &file, Tuple &tuple, Index<char> *image)
 {
     ConsoleFileHandler fh(filename, file);
@@ -165,7 +262,11 @@ bool ConsolePlugin::read_tag(const char *filename, VFSFile &file, Tuple &tuple,
     if (!fh.m_type)
         return false;
 
-    if (fh.load(gme_info_only))
+    // a playable emulator is only needed to measure a single track; one that
+    // claims the YM2413 core could make playback at another rate fail
+    bool measure = audcfg.measure && fh.m_track >= 0 && !fh.uses_ym2413();
+
+    if (fh.load(measure ? get_sample_rate(fh.m_type) : gme_info_only))
         return false;
 
     track_info_t info;
@@ -194,6 +295,27 @@ bool ConsolePlugin::read_tag(const char *filename, VFSFile &file, Tuple &tuple,
     tuple.set_int (Tuple::Length, get_track_length (info));
     tuple.set_int (Tuple::Channels, 2);
 
+    if (measure)
+    {
+        if (fh.m_type == gme_spc_type && audcfg.ignore_spc_length)
+            info.length = -1;
+
+        bool timed = (info.length > 0 || info.loop_length > 0);
+        TrackMeter meter(fh.m_emu->sample_rate(), 2);
+        bool ended = false;
+
+        setup_emu(fh.m_emu);
+        int length = render_track(fh.m_emu, fh.m_track, timed ? get_track_length(info) : -1, meter, ended);
+
+        if (length >= 0)
+        {
+            if (!timed && ended)
+                tuple.set_int(Tuple::Length, length);
+
+            meter.apply(tuple);
+        }
+    }
+
     return true;
 }
 
@@ -210,37 +332,12 @@ bool ConsolePlugin::play(const char *filename, VFSFile &file)
     if (fh.m_track < 0)
         fh.m_track = 0;
 
-    // select sample rate
-    sample_rate = 0;
-    if (fh.m_type == gme_spc_type)
-        sample_rate = 32000;
-    if (audcfg.resample)
-        sample_rate = audcfg.resample_rate;
-    if (sample_rate == 0)
-        sample_rate = 44100;
-
     // create emulator and load file
+    sample_rate = get_sample_rate(fh.m_type);
     if (fh.load(sample_rate))
         return false;
 
-    // stereo echo depth
-    gme_set_stereo_depth(fh.m_emu, 1.0 / 100 * audcfg.echo);
-
-    // set equalizer
-    if (audcfg.treble || audcfg.bass)
-    {
-        Music_Emu::equalizer_t eq;
-
-        // bass - logarithmic, 2 to 8194 Hz
-        double bass = 1.0 - (audcfg.bass / 200.0 + 0.5);
-        eq.bass = (long) (2.0 + pow( 2.0, bass * 13 ));
-
-        // treble - -50 to 0 to +5 dB
-        double treble = audcfg.treble / 100.0;
-        eq.treble = treble * (treble < 0 ? 50.0 : 5.0);
-
-        fh.m_emu->set_equalizer(eq);
-    }
+    setup_emu(fh.m_emu);
 
     // get info
     length = -1;
@@ -262,11 +359,7 @@ bool ConsolePlugin::play(const char *filename, VFSFile &file)
     open_audio(FMT_S16_NE, sample_rate, 2);
 
     // set fade time
-    if (length <= 0)
-        length = audcfg.loop_length * 1000;
-    if (length >= fade_threshold + fade_length)
-        length -= fade_length / 2;
-    fh.m_emu->set_fade(length, fade_length);
+    setup_fade(fh.m_emu, length);
 
     while (!check_stop())
     {
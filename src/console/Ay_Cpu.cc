@@ -8,6 +8,7 @@ Last validated with zexall 2006.11.21 5:26 PM
 
 #include "Ay_Cpu.h"
 
+#include "Emu_State.h"
 #include "blargg_endian.h"
 #include <string.h>
 
@@ -85,6 +86,14 @@ void Ay_Cpu::reset( void* m )
 	memset( &r, 0, sizeof r );
 }
 
+void Ay_Cpu::copy_state( Emu_State& s )
+{
+	check( state == &state_ ); // not while running
+	s.copy( r );
+	s.copy( state_ );
+	s.copy( end_time_ );
+}
+
 #define TIME                        (s_time + s.base)
 #define READ_PROG( addr )           (mem [addr])
 #define INSTR( offset )             READ_PROG( pc + (offset) )
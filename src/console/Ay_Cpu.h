@@ -6,6 +6,8 @@
 
 #include "blargg_endian.h"
 
+class Emu_State;
+
 typedef blargg_long cpu_time_t;
 
 // must be defined by caller
@@ -17,6 +19,9 @@ public:
 	// Clear all registers and keep pointer to 64K memory passed in
 	void reset( void* mem_64k );
 
+	// Save or restore registers and timing. See Emu_State.h
+	void copy_state( Emu_State& );
+
 	// Run until specified time is reached. Returns true if suspicious/unsupported
 	// instruction was encountered at any point during run.
 	bool run( cpu_time_t end_time );
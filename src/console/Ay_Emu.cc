@@ -2,6 +2,7 @@
 
 #include "Ay_Emu.h"
 
+#include "Emu_State.h"
 #include "blargg_endian.h"
 #include <string.h>
 
@@ -403,3 +404,19 @@ blargg_err_t Ay_Emu::run_clocks( blip_time_t& duration, int )
 
 	return 0;
 }
+
+blargg_err_t Ay_Emu::copy_state_( Emu_State& s )
+{
+	copy_buffer_state( s );
+	cpu::copy_state( s );
+	s.copy( next_play );
+	s.copy( beeper_delta );
+	s.copy( last_beeper );
+	s.copy( apu_addr );
+	s.copy( cpc_latch );
+	s.copy( spectrum_mode );
+	s.copy( cpc_mode );
+	s.copy( mem.ram );
+	s.copy( apu );
+	return 0;
+}
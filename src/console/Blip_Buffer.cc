@@ -2,6 +2,8 @@
 
 #include "Blip_Buffer.h"
 
+#include "Emu_State.h"
+
 #include <assert.h>
 #include <limits.h>
 #include <string.h>
@@ -187,6 +189,20 @@ void Blip_Buffer::remove_samples( long count )
 	}
 }
 
+void Blip_Buffer::copy_state( Emu_State& s )
+{
+	s.copy( offset_ );
+	s.copy( reader_accum_ );
+	s.copy( modified_ );
+
+	// everything past the unread samples and the tail of the last impulses
+	// is kept cleared, so only the part before it needs to be saved
+	long count = samples_avail() + blip_buffer_extra_;
+	s.copy( buffer_, count * sizeof *buffer_ );
+	if ( !s.saving() )
+		memset( buffer_ + count, 0, (buffer_size_ - samples_avail()) * sizeof *buffer_ );
+}
+
 // Blip_Synth_
 
 Blip_Synth_Fast_::Blip_Synth_Fast_()
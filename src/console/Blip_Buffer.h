@@ -20,6 +20,8 @@ typedef blip_long blip_time_t;
 typedef short blip_sample_t;
 enum { blip_sample_max = 32767 };
 
+class Emu_State;
+
 class Blip_Buffer {
 public:
 	typedef const char* blargg_err_t;
@@ -83,6 +85,10 @@ public:
 	// Mix 'count' samples from 'buf' into buffer.
 	void mix_samples( blip_sample_t const* buf, long count );
 
+	// Save or restore unread samples and reader state. Must be called between
+	// frames.
+	void copy_state( Emu_State& );
+
 	// not documented yet
 	void set_modified() { modified_ = 1; }
 	int clear_modified() { int b = modified_; modified_ = 0; return b; }
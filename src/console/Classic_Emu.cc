@@ -2,6 +2,7 @@
 
 #include "Classic_Emu.h"
 
+#include "Emu_State.h"
 #include "Multi_Buffer.h"
 #include <string.h>
 
@@ -79,6 +80,11 @@ void Classic_Emu::change_clock_rate( long rate )
 	buf->clock_rate( rate );
 }
 
+void Classic_Emu::copy_buffer_state( Emu_State& s )
+{
+	buf->copy_state( s );
+}
+
 blargg_err_t Classic_Emu::setup_buffer( long rate )
 {
 	change_clock_rate( rate );
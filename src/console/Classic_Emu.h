@@ -20,6 +20,7 @@ protected:
 	blargg_err_t setup_buffer( long clock_rate );
 	long clock_rate() const { return clock_rate_; }
 	void change_clock_rate( long ); // experimental
+	void copy_buffer_state( Emu_State& ); // for copy_state_()
 
 	// Overridable
 	virtual void set_voice( int index, Blip_Buffer* center,
@@ -2,6 +2,7 @@
 
 #include "Dual_Resampler.h"
 
+#include "Emu_State.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -47,6 +48,13 @@ void Dual_Resampler::resize( int pairs )
 	}
 }
 
+void Dual_Resampler::copy_state( Emu_State& s )
+{
+	s.copy( buf_pos );
+	s.copy( &sample_buf [buf_pos], (sample_buf_size - buf_pos) * sizeof sample_buf [0] );
+	resampler.copy_state( s );
+}
+
 void Dual_Resampler::play_frame_( Blip_Buffer& blip_buf, dsample_t* out )
 {
 	long pair_count = sample_buf_size >> 1;
@@ -21,6 +21,9 @@ public:
 
 	void dual_play( long count, dsample_t* out, Blip_Buffer& );
 
+	// Save or restore resampler state, but not that of the Blip_Buffer
+	void copy_state( Emu_State& );
+
 protected:
 	virtual int play_frame( blip_time_t, int pcm_count, dsample_t* pcm_out ) = 0;
 private:
@@ -2,6 +2,7 @@
 
 #include "Effects_Buffer.h"
 
+#include "Emu_State.h"
 #include <string.h>
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
@@ -121,6 +122,23 @@ void Effects_Buffer::clear()
 		bufs [i].clear();
 }
 
+void Effects_Buffer::copy_state( Emu_State& s )
+{
+	s.copy( stereo_remain );
+	s.copy( effect_remain );
+	s.copy( effects_enabled );
+	if ( config_.effects_enabled )
+	{
+		// only used while effects are enabled, and cleared when they're turned on
+		s.copy( echo_buf.begin(), echo_size * sizeof echo_buf [0] );
+		s.copy( reverb_buf.begin(), reverb_size * sizeof reverb_buf [0] );
+		s.copy( echo_pos );
+		s.copy( reverb_pos );
+	}
+	for ( int i = 0; i < buf_count; i++ )
+		bufs [i].copy_state( s );
+}
+
 inline int pin_range( int n, int max, int min = 0 )
 {
 	if ( n < min )
@@ -0,0 +1,89 @@
+// Game_Music_Emu 0.5.5. http://www.slack.net/~ant/
+
+#include "Emu_State.h"
+
+#include <string.h>
+
+/* Copyright (C) 2026 Audacious developers. This module is free software; you
+can redistribute it and/or modify it under the terms of the GNU Lesser
+General Public License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version. This
+module is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details. You should have received a copy of the GNU Lesser General Public
+License along with this module; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
+
+#include "blargg_source.h"
+
+Emu_State::Emu_State()
+{
+	size_   = 0;
+	pos     = 0;
+	saving_ = false;
+	error   = 0;
+}
+
+void Emu_State::start_saving()
+{
+	size_   = 0;
+	pos     = 0;
+	saving_ = true;
+	error   = 0;
+}
+
+void Emu_State::start_restoring()
+{
+	pos     = 0;
+	saving_ = false;
+	error   = 0;
+}
+
+void Emu_State::copy( void* p, long size )
+{
+	if ( error )
+		return;
+
+	if ( saving_ )
+	{
+		if ( (size_t) (size_ + size) > data.size() )
+		{
+			// grow geometrically, since a state is made of many small pieces
+			size_t new_size = data.size() * 2;
+			if ( new_size < (size_t) (size_ + size) )
+				new_size = size_ + size;
+			error = data.resize( new_size );
+			if ( error )
+				return;
+		}
+		memcpy( &data [size_], p, size );
+		size_ += size;
+	}
+	else
+	{
+		if ( pos + size > size_ )
+		{
+			error = "Saved state is incomplete";
+			return;
+		}
+		memcpy( p, &data [pos], size );
+		pos += size;
+	}
+}
+
+blargg_err_t Emu_State::finish()
+{
+	if ( !error )
+	{
+		if ( saving_ )
+		{
+			if ( data.resize( size_ ) ) { } // OK if shrink fails
+		}
+		else if ( pos != size_ )
+		{
+			error = "Saved state doesn't match emulator";
+		}
+	}
+	return error;
+}
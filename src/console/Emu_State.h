@@ -0,0 +1,49 @@
+// Saved emulator state, used by Music_Emu to seek quickly
+
+// Game_Music_Emu 0.5.5
+#ifndef EMU_STATE_H
+#define EMU_STATE_H
+
+#include "blargg_common.h"
+
+// An emulator passes each piece of its state to copy(), which either appends it
+// to the saved data or overwrites it with saved data. Using the same function for
+// both directions keeps saving and restoring from getting out of sync. State is
+// copied as raw memory, pointers included, so it can only be restored into the
+// same emulator object that saved it, and only while the loaded file, sample rate,
+// tempo and equalizer are unchanged.
+class Emu_State {
+public:
+	Emu_State();
+
+	// Prepare to save state. Previously saved data is discarded.
+	void start_saving();
+
+	// Prepare to restore saved state
+	void start_restoring();
+
+	// True if saving, false if restoring
+	bool saving() const                 { return saving_; }
+
+	// Save or restore 'size' bytes at 'p'
+	void copy( void* p, long size );
+
+	// Save or restore all of an object as raw memory
+	template<class T>
+	void copy( T& obj )                 { copy( &obj, sizeof obj ); }
+
+	// Finish saving or restoring and return any error that occurred
+	blargg_err_t finish();
+
+	// Number of bytes of saved state
+	long size() const                   { return size_; }
+
+private:
+	blargg_vector<unsigned char> data;
+	long size_;
+	long pos;
+	bool saving_;
+	blargg_err_t error;
+};
+
+#endif
@@ -2,6 +2,7 @@
 
 #include "Fir_Resampler.h"
 
+#include "Emu_State.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -77,6 +78,15 @@ void Fir_Resampler_::clear()
 	}
 }
 
+void Fir_Resampler_::copy_state( Emu_State& s )
+{
+	long count = write_pos - buf.begin();
+	s.copy( count );
+	write_pos = buf.begin() + count;
+	s.copy( buf.begin(), count * sizeof buf [0] );
+	s.copy( imp_phase );
+}
+
 blargg_err_t Fir_Resampler_::buffer_size( int new_size )
 {
 	RETURN_ERR( buf.resize( new_size + write_offset ) );
@@ -7,6 +7,8 @@
 #include "blargg_common.h"
 #include <string.h>
 
+class Emu_State;
+
 class Fir_Resampler_ {
 public:
 
@@ -45,6 +47,9 @@ public:
 	// Skip 'count' input samples. Returns number of samples actually skipped.
 	int skip_input( long count );
 
+	// Save or restore buffered input and filter phase. See Emu_State.h
+	void copy_state( Emu_State& );
+
 // Output
 
 	// Number of extra input samples needed until 'count' output samples are available
@@ -2,6 +2,7 @@
 
 #include "Gb_Cpu.h"
 
+#include "Emu_State.h"
 #include <string.h>
 
 //#include "gb_cpu_log.h"
@@ -77,6 +78,14 @@ void Gb_Cpu::map_code( gb_addr_t start, unsigned size, void* data )
 		set_code_page( first_page + i, (uint8_t*) data + i * page_size );
 }
 
+void Gb_Cpu::copy_state( Emu_State& s )
+{
+	check( state == &state_ ); // not while running
+	s.copy( r );
+	s.copy( rst_base );
+	s.copy( state_ );
+}
+
 #define READ( addr )            CPU_READ( this, (addr), s.remain )
 #define WRITE( addr, data )     {CPU_WRITE( this, (addr), (data), s.remain );}
 #define READ_FAST( addr, out )  CPU_READ_FAST( this, (addr), s.remain, out )
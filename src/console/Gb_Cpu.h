@@ -8,6 +8,8 @@
 #include "blargg_common.h"
 #include "blargg_endian.h"
 
+class Emu_State;
+
 typedef unsigned gb_addr_t; // 16-bit CPU address
 
 class Gb_Cpu {
@@ -16,6 +18,9 @@ public:
 	// Clear registers and map all pages to unmapped
 	void reset( void* unmapped = 0 );
 
+	// Save or restore registers, memory map and timing. See Emu_State.h
+	void copy_state( Emu_State& );
+
 	// Map code memory (memory accessed via the program counter). Start and size
 	// must be multiple of page_size.
 	enum { page_size = 0x2000 };
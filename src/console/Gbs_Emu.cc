@@ -2,6 +2,7 @@
 
 #include "Gbs_Emu.h"
 
+#include "Emu_State.h"
 #include "blargg_endian.h"
 #include <string.h>
 
@@ -287,3 +288,15 @@ blargg_err_t Gbs_Emu::run_clocks( blip_time_t& duration, int )
 
 	return 0;
 }
+
+blargg_err_t Gbs_Emu::copy_state_( Emu_State& s )
+{
+	copy_buffer_state( s );
+	cpu::copy_state( s );
+	s.copy( cpu_time );
+	s.copy( play_period ); // changes when timer registers are written
+	s.copy( next_play );
+	s.copy( ram );
+	s.copy( apu );
+	return 0;
+}
@@ -2,6 +2,7 @@
 
 #include "Gym_Emu.h"
 
+#include "Emu_State.h"
 #include "blargg_endian.h"
 #include <string.h>
 
@@ -378,3 +379,18 @@ blargg_err_t Gym_Emu::play_( long count, sample_t* out )
 	Dual_Resampler::dual_play( count, out, blip_buf );
 	return 0;
 }
+
+blargg_err_t Gym_Emu::copy_state_( Emu_State& s )
+{
+	s.copy( pos );
+	s.copy( loop_begin );
+	s.copy( loop_remain );
+	s.copy( dac_amp );
+	s.copy( prev_dac_count );
+	s.copy( dac_enabled );
+	Dual_Resampler::copy_state( s );
+	blip_buf.copy_state( s );
+	fm.copy_state( s );
+	s.copy( apu );
+	return 0;
+}
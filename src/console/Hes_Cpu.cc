@@ -2,6 +2,7 @@
 
 #include "Hes_Cpu.h"
 
+#include "Emu_State.h"
 #include "blargg_endian.h"
 
 //#include "hes_cpu_log.h"
@@ -73,6 +74,17 @@ void Hes_Cpu::set_mmr( int reg, int bank )
 	state->code_map [reg] = code - PAGE_OFFSET( reg << page_shift );
 }
 
+void Hes_Cpu::copy_state( Emu_State& s )
+{
+	check( state == &state_ ); // not while running
+	s.copy( ram );
+	s.copy( r );
+	s.copy( mmr );
+	s.copy( state_ );
+	s.copy( irq_time_ );
+	s.copy( end_time_ );
+}
+
 #define TIME    (s_time + s.base)
 
 #define READ( addr )            CPU_READ( this, (addr), TIME )
@@ -6,6 +6,8 @@
 
 #include "blargg_common.h"
 
+class Emu_State;
+
 typedef blargg_long hes_time_t; // clock cycle count
 typedef unsigned hes_addr_t; // 16-bit address
 enum { future_hes_time = INT_MAX / 2 + 1 };
@@ -14,6 +16,9 @@ class Hes_Cpu {
 public:
 	void reset();
 
+	// Save or restore registers, RAM, memory map and timing. See Emu_State.h
+	void copy_state( Emu_State& );
+
 	enum { page_size = 0x2000 };
 	enum { page_shift = 13 };
 	enum { page_count = 8 };
@@ -2,6 +2,7 @@
 
 #include "Hes_Emu.h"
 
+#include "Emu_State.h"
 #include "blargg_endian.h"
 #include <string.h>
 
@@ -529,3 +530,17 @@ blargg_err_t Hes_Emu::run_clocks( blip_time_t& duration_, int )
 
 	return 0;
 }
+
+blargg_err_t Hes_Emu::copy_state_( Emu_State& s )
+{
+	copy_buffer_state( s );
+	cpu::copy_state( s );
+	s.copy( write_pages );
+	s.copy( last_frame_hook );
+	s.copy( timer );
+	s.copy( vdp );
+	s.copy( irq );
+	s.copy( sgx );
+	s.copy( apu );
+	return 0;
+}
@@ -8,6 +8,7 @@ Last validated with zexall 2006.11.14 2:19 PM
 
 #include "Kss_Cpu.h"
 
+#include "Emu_State.h"
 #include "blargg_endian.h"
 #include <string.h>
 
@@ -111,6 +112,14 @@ void Kss_Cpu::map_mem( unsigned addr, blargg_ulong size, void* write, void const
 	}
 }
 
+void Kss_Cpu::copy_state( Emu_State& s )
+{
+	check( state == &state_ ); // not while running
+	s.copy( r );
+	s.copy( state_ );
+	s.copy( end_time_ );
+}
+
 #define TIME                        (s_time + s.base)
 #define RW_MEM( addr, rw )          (s.rw [(addr) >> page_shift] [KSS_CPU_PAGE_OFFSET( addr )])
 #define READ_PROG( addr )           RW_MEM( addr, read )
@@ -6,6 +6,8 @@
 
 #include "blargg_endian.h"
 
+class Emu_State;
+
 typedef blargg_long cpu_time_t;
 
 // must be defined by caller
@@ -18,6 +20,9 @@ public:
 	// Clear registers and map all pages to unmapped
 	void reset( void* unmapped_write, void const* unmapped_read );
 
+	// Save or restore registers, memory map and timing. See Emu_State.h
+	void copy_state( Emu_State& );
+
 	// Map memory. Start and size must be multiple of page_size.
 	enum { page_size = 0x2000 };
 	void map_mem( unsigned addr, blargg_ulong size, void* write, void const* read );
@@ -2,6 +2,7 @@
 
 #include "Kss_Emu.h"
 
+#include "Emu_State.h"
 #include "blargg_endian.h"
 #include <string.h>
 
@@ -414,3 +415,19 @@ blargg_err_t Kss_Emu::run_clocks( blip_time_t& duration, int )
 
 	return 0;
 }
+
+blargg_err_t Kss_Emu::copy_state_( Emu_State& s )
+{
+	copy_buffer_state( s );
+	cpu::copy_state( s );
+	s.copy( scc_accessed );
+	s.copy( gain_updated );
+	s.copy( next_play );
+	s.copy( ay_latch );
+	s.copy( ram );
+	s.copy( ay ); // also restores volume set by update_gain()
+	s.copy( scc );
+	if ( sn )
+		s.copy( *sn );
+	return 0;
+}
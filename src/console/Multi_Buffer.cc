@@ -2,6 +2,8 @@
 
 #include "Multi_Buffer.h"
 
+#include "Emu_State.h"
+
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -103,6 +105,14 @@ void Stereo_Buffer::end_frame( blip_time_t clock_count )
 	}
 }
 
+void Stereo_Buffer::copy_state( Emu_State& s )
+{
+	s.copy( stereo_added );
+	s.copy( was_stereo );
+	for ( int i = 0; i < buf_count; i++ )
+		bufs [i].copy_state( s );
+}
+
 long Stereo_Buffer::read_samples( blip_sample_t* out, long count )
 {
 	require( !(count & 1) ); // count must be even
@@ -51,6 +51,9 @@ public:
 	virtual long read_samples( blip_sample_t*, long ) = 0;
 	virtual long samples_avail() const = 0;
 
+	// Save or restore buffered samples. See Emu_State.h
+	virtual void copy_state( Emu_State& ) = 0;
+
 protected:
 	void channels_changed() { channels_changed_count_++; }
 private:
@@ -83,6 +86,7 @@ public:
 	long read_samples( blip_sample_t* p, long s ) { return buf.read_samples( p, s ); }
 	channel_t channel( int, int ) { return chan; }
 	void end_frame( blip_time_t t ) { buf.end_frame( t ); }
+	void copy_state( Emu_State& s ) { buf.copy_state( s ); }
 };
 
 // Uses three buffers (one for center) and outputs stereo sample pairs.
@@ -106,6 +110,7 @@ public:
 
 	long samples_avail() const { return bufs [0].samples_avail() * 2; }
 	long read_samples( blip_sample_t*, long );
+	void copy_state( Emu_State& );
 
 private:
 	enum { buf_count = 3 };
@@ -132,6 +137,7 @@ public:
 	void end_frame( blip_time_t ) { }
 	long samples_avail() const { return 0; }
 	long read_samples( blip_sample_t*, long ) { return 0; }
+	void copy_state( Emu_State& ) { }
 };
 
 
@@ -2,7 +2,9 @@
 
 #include "Music_Emu.h"
 
+#include "Emu_State.h"
 #include "Multi_Buffer.h"
+#include <limits.h>
 #include <string.h>
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
@@ -23,6 +25,7 @@ int const silence_max = 6; // seconds
 int const silence_threshold = 0x10;
 long const fade_block_size = 512;
 int const fade_shift = 8; // fade ends with gain at 1.0 / (1 << fade_shift)
+int const checkpoint_msec = 10000; // initial spacing of checkpoints
 
 Music_Emu::equalizer_t const Music_Emu::tv_eq = { -8.0, 180 };
 
@@ -39,6 +42,7 @@ void Music_Emu::clear_track_vars()
 	silence_count    = 0;
 	buf_remain       = 0;
 	warning(); // clear warning
+	clear_checkpoints();
 }
 
 void Music_Emu::unload()
@@ -51,6 +55,7 @@ void Music_Emu::unload()
 Music_Emu::Music_Emu()
 {
 	effects_buffer = 0;
+	checkpoint_count = 0;
 
 	sample_rate_ = 0;
 	mute_mask_   = 0;
@@ -72,7 +77,11 @@ Music_Emu::Music_Emu()
 	Music_Emu::unload(); // non-virtual
 }
 
-Music_Emu::~Music_Emu() { delete effects_buffer; }
+Music_Emu::~Music_Emu()
+{
+	clear_checkpoints();
+	delete effects_buffer;
+}
 
 blargg_err_t Music_Emu::set_sample_rate( long rate )
 {
@@ -93,6 +102,7 @@ void Music_Emu::set_equalizer( equalizer_t const& eq )
 {
 	equalizer_ = eq;
 	set_equalizer_( eq );
+	clear_checkpoints(); // saved synthesizers have the old equalization
 }
 
 void Music_Emu::mute_voice( int index, bool mute )
@@ -121,6 +131,7 @@ void Music_Emu::set_tempo( double t )
 	if ( t > max ) t = max;
 	tempo_ = t;
 	set_tempo_( t );
+	clear_checkpoints(); // saved times and buffers are at the old clock rate
 }
 
 void Music_Emu::post_load_()
@@ -156,6 +167,10 @@ blargg_err_t Music_Emu::start_track( int track )
 		silence_time  = 0;
 		silence_count = 0;
 	}
+
+	if ( checkpoint_remain() <= 0 )
+		save_checkpoint();
+
 	return track_ended() ? warning() : 0;
 }
 
@@ -187,14 +202,59 @@ long Music_Emu::tell() const
 blargg_err_t Music_Emu::seek( long msec )
 {
 	blargg_long time = msec_to_samples( msec );
-	if ( time < out_time )
-		RETURN_ERR( start_track( current_track_ ) );
+
+	// latest checkpoint at or before new time
+	checkpoint_t const* cp = 0;
+	for ( int i = checkpoint_count; i--; )
+	{
+		if ( checkpoints [i].time <= time )
+		{
+			cp = &checkpoints [i];
+			break;
+		}
+	}
+
+	if ( cp && (time < out_time || cp->time > out_time) )
+	{
+		if ( !restore_checkpoint( *cp ) )
+			return skip( time - out_time );
+	}
+	else if ( time >= out_time )
+	{
+		return skip( time - out_time );
+	}
+
+	// restarting the track clears its fade, which was set for the whole track
+	blargg_long saved_fade_start = fade_start;
+	int saved_fade_step = fade_step;
+	RETURN_ERR( start_track( current_track_ ) );
+	fade_start = saved_fade_start;
+	fade_step = saved_fade_step;
+
 	return skip( time - out_time );
 }
 
 blargg_err_t Music_Emu::skip( long count )
 {
 	require( current_track() >= 0 ); // start_track() must have been called already
+
+	// stop at each checkpoint time along the way, so that later seeks can
+	// start from there
+	for ( long n; count > (n = checkpoint_remain()); )
+	{
+		if ( n > 0 )
+		{
+			RETURN_ERR( skip_samples( n ) );
+			count -= n;
+		}
+		save_checkpoint();
+	}
+
+	return skip_samples( count );
+}
+
+blargg_err_t Music_Emu::skip_samples( long count )
+{
 	out_time += count;
 
 	// remove from silence and buf first
@@ -395,6 +455,102 @@ blargg_err_t Music_Emu::play( long out_count, sample_t* out )
 			handle_fade( out_count, out );
 	}
 	out_time += out_count;
+
+	if ( checkpoint_remain() <= 0 )
+		save_checkpoint();
+
+	return 0;
+}
+
+// Checkpoints
+
+blargg_err_t Music_Emu::copy_state_( Emu_State& ) { return "Emulator can't save its state"; }
+
+void Music_Emu::clear_checkpoints()
+{
+	for ( int i = 0; i < checkpoint_count; i++ )
+		delete checkpoints [i].state;
+	checkpoint_count    = 0;
+	checkpoint_interval = msec_to_samples( checkpoint_msec );
+	checkpoints_failed  = false;
+}
+
+// number of samples to play until the next checkpoint is due
+long Music_Emu::checkpoint_remain() const
+{
+	if ( checkpoints_failed || track_ended_ )
+		return LONG_MAX;
+	if ( !checkpoint_count )
+		return 0;
+	return checkpoints [checkpoint_count - 1].time + checkpoint_interval - out_time;
+}
+
+blargg_err_t Music_Emu::copy_state( Emu_State& s )
+{
+	s.copy( out_time );
+	s.copy( emu_time );
+	s.copy( emu_track_ended_ );
+	s.copy( silence_time );
+	s.copy( silence_count );
+	s.copy( buf_remain );
+	s.copy( buf.end() - buf_remain, buf_remain * sizeof buf [0] );
+
+	blargg_err_t err = copy_state_( s );
+	blargg_err_t finish_err = s.finish();
+	return err ? err : finish_err;
+}
+
+void Music_Emu::save_checkpoint()
+{
+	if ( checkpoint_count >= max_checkpoints )
+	{
+		// keep every other checkpoint and space new ones twice as far apart,
+		// so that checkpoints always cover the whole track played so far
+		for ( int i = 1; i < checkpoint_count; i += 2 )
+			delete checkpoints [i].state;
+		for ( int i = 2; i < checkpoint_count; i += 2 )
+			checkpoints [i / 2] = checkpoints [i];
+		checkpoint_count = (checkpoint_count + 1) / 2;
+		checkpoint_interval *= 2;
+
+		if ( checkpoint_remain() > 0 )
+			return;
+	}
+
+	checkpoint_t& cp = checkpoints [checkpoint_count];
+	cp.time      = out_time;
+	cp.mute_mask = mute_mask_;
+	cp.state     = BLARGG_NEW Emu_State;
+
+	blargg_err_t err = "Out of memory";
+	if ( cp.state )
+	{
+		cp.state->start_saving();
+		err = copy_state( *cp.state );
+	}
+
+	if ( err )
+	{
+		// fall back to seeking without checkpoints rather than retrying
+		delete cp.state;
+		checkpoints_failed = true;
+		return;
+	}
+
+	checkpoint_count++;
+}
+
+blargg_err_t Music_Emu::restore_checkpoint( checkpoint_t const& cp )
+{
+	cp.state->start_restoring();
+	RETURN_ERR( copy_state( *cp.state ) );
+
+	// checkpoints are only saved while the track is playing
+	track_ended_ = false;
+
+	if ( cp.mute_mask != mute_mask_ )
+		remute_voices();
+
 	return 0;
 }
 
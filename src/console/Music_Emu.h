@@ -6,6 +6,7 @@
 
 #include "Gme_File.h"
 class Multi_Buffer;
+class Emu_State;
 
 struct Music_Emu : public Gme_File {
 public:
@@ -41,7 +42,10 @@ public:
 	// Number of milliseconds (1000 msec = 1 second) played since beginning of track
 	long tell() const;
 
-	// Seek to new time in track. Seeking backwards or far forward can take a while.
+	// Seek to new time in track. Playback saves a checkpoint of the emulator
+	// state every few seconds, and seeking continues from the nearest one before
+	// the new time. Seeking past the last checkpoint, or in a track played by an
+	// emulator without checkpoint support, can take a while.
 	blargg_err_t seek( long msec );
 
 	// Skip n samples
@@ -122,6 +126,11 @@ protected:
 	virtual blargg_err_t start_track_( int ) = 0; // tempo is set before this
 	virtual blargg_err_t play_( long count, sample_t* out ) = 0;
 	virtual blargg_err_t skip_( long count );
+
+	// Save or restore all emulation state that changes as a track plays, using
+	// Emu_State::copy(). Called only between calls to play_() and skip_().
+	// Emulators that don't override this always seek by playing from the start.
+	virtual blargg_err_t copy_state_( Emu_State& );
 protected:
 	virtual void unload();
 	virtual void pre_load();
@@ -163,6 +172,24 @@ private:
 	blargg_vector<sample_t> buf;
 	void fill_buf();
 	void emu_play( long count, sample_t* out );
+	blargg_err_t skip_samples( long count );
+
+	// checkpoints for seeking
+	enum { max_checkpoints = 64 };
+	struct checkpoint_t {
+		blargg_long time; // out_time when saved
+		int mute_mask;
+		Emu_State* state;
+	};
+	checkpoint_t checkpoints [max_checkpoints];
+	int checkpoint_count;
+	blargg_long checkpoint_interval;
+	bool checkpoints_failed;
+	void clear_checkpoints();
+	long checkpoint_remain() const;
+	void save_checkpoint();
+	blargg_err_t restore_checkpoint( checkpoint_t const& );
+	blargg_err_t copy_state( Emu_State& );
 
 	Multi_Buffer* effects_buffer;
 	friend Music_Emu* gme_new_emu( gme_type_t, int );
@@ -2,6 +2,7 @@
 
 #include "Nes_Cpu.h"
 
+#include "Emu_State.h"
 #include "blargg_endian.h"
 #include <limits.h>
 
@@ -100,6 +101,17 @@ void Nes_Cpu::map_code( nes_addr_t start, unsigned size, void const* data, bool
 	}
 }
 
+void Nes_Cpu::copy_state( Emu_State& s )
+{
+	check( state == &state_ ); // not while running
+	s.copy( low_mem );
+	s.copy( r );
+	s.copy( state_ );
+	s.copy( irq_time_ );
+	s.copy( end_time_ );
+	s.copy( error_count_ );
+}
+
 #define TIME    (s_time + s.base)
 #define READ_LIKELY_PPU( addr, out )    {CPU_READ_PPU( this, (addr), out, TIME );}
 #define READ( addr )                    CPU_READ( this, (addr), TIME )
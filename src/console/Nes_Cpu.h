@@ -6,6 +6,8 @@
 
 #include "blargg_common.h"
 
+class Emu_State;
+
 typedef blargg_long nes_time_t; // clock cycle count
 typedef unsigned nes_addr_t; // 16-bit address
 enum { future_nes_time = INT_MAX / 2 + 1 };
@@ -16,6 +18,9 @@ public:
 	// and mirror unmapped_page in remaining memory
 	void reset( void const* unmapped_page = 0 );
 
+	// Save or restore registers, low memory, memory map and timing. See Emu_State.h
+	void copy_state( Emu_State& );
+
 	// Map code memory (memory accessed via the program counter). Start and size
 	// must be multiple of page_size. If mirror is true, repeats code page
 	// throughout address range.
@@ -2,6 +2,7 @@
 
 #include "Nsf_Emu.h"
 
+#include "Emu_State.h"
 #include "blargg_endian.h"
 #include <string.h>
 #include <stdio.h>
@@ -557,3 +558,22 @@ blargg_err_t Nsf_Emu::run_clocks( blip_time_t& duration, int )
 
 	return 0;
 }
+
+blargg_err_t Nsf_Emu::copy_state_( Emu_State& s )
+{
+	copy_buffer_state( s );
+	cpu::copy_state( s );
+	s.copy( saved_state );
+	s.copy( next_play );
+	s.copy( play_extra );
+	s.copy( play_ready );
+	s.copy( sram );
+	s.copy( apu );
+	if ( vrc6 )
+		s.copy( *vrc6 );
+	if ( namco )
+		s.copy( *namco );
+	if ( fme7 )
+		s.copy( *fme7 );
+	return 0;
+}
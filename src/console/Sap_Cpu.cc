@@ -2,6 +2,7 @@
 
 #include "Sap_Cpu.h"
 
+#include "Emu_State.h"
 #include <limits.h>
 #include "blargg_endian.h"
 
@@ -55,6 +56,15 @@ void Sap_Cpu::reset( void* new_mem )
 	end_time_ = future_sap_time;
 }
 
+void Sap_Cpu::copy_state( Emu_State& s )
+{
+	check( state == &state_ ); // not while running
+	s.copy( r );
+	s.copy( state_ );
+	s.copy( irq_time_ );
+	s.copy( end_time_ );
+}
+
 #define TIME                    (s_time + s.base)
 #define READ( addr )            CPU_READ( this, (addr), TIME )
 #define WRITE( addr, data )     {CPU_WRITE( this, (addr), (data), TIME );}
@@ -6,6 +6,8 @@
 
 #include "blargg_common.h"
 
+class Emu_State;
+
 typedef blargg_long sap_time_t; // clock cycle count
 typedef unsigned sap_addr_t; // 16-bit address
 enum { future_sap_time = INT_MAX / 2 + 1 };
@@ -15,6 +17,9 @@ public:
 	// Clear all registers and keep pointer to 64K memory passed in
 	void reset( void* mem_64k );
 
+	// Save or restore registers and timing. See Emu_State.h
+	void copy_state( Emu_State& );
+
 	// Run until specified time is reached. Returns true if suspicious/unsupported
 	// instruction was encountered at any point during run.
 	bool run( sap_time_t end_time );
@@ -2,6 +2,7 @@
 
 #include "Sap_Emu.h"
 
+#include "Emu_State.h"
 #include "blargg_endian.h"
 #include <string.h>
 
@@ -523,3 +524,15 @@ blargg_err_t Sap_Emu::run_clocks( blip_time_t& duration, int )
 
 	return 0;
 }
+
+blargg_err_t Sap_Emu::copy_state_( Emu_State& s )
+{
+	copy_buffer_state( s );
+	cpu::copy_state( s );
+	s.copy( next_play );
+	s.copy( time_mask );
+	s.copy( mem.ram );
+	s.copy( apu );
+	s.copy( apu2 ); // apu_impl only holds tables and the shared synth
+	return 0;
+}
@@ -2,6 +2,7 @@
 
 #include "Spc_Emu.h"
 
+#include "Emu_State.h"
 #include "blargg_endian.h"
 #include <stdlib.h>
 #include <string.h>
@@ -350,3 +351,12 @@ blargg_err_t Spc_Emu::play_( long count, sample_t* out )
 	check( remain == 0 );
 	return 0;
 }
+
+blargg_err_t Spc_Emu::copy_state_( Emu_State& s )
+{
+	s.copy( apu );
+	filter.copy_state( s );
+	if ( sample_rate() != native_sample_rate )
+		resampler.copy_state( s );
+	return 0;
+}
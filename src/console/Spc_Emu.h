@@ -64,6 +64,7 @@ protected:
 	blargg_err_t start_track_( int );
 	blargg_err_t play_( long, sample_t* );
 	blargg_err_t skip_( long );
+	blargg_err_t copy_state_( Emu_State& );
 	void mute_voices_( int );
 	void set_tempo_( double );
 	void enable_accuracy_( bool );
@@ -6,6 +6,8 @@
 
 #include "blargg_common.h"
 
+class Emu_State;
+
 struct SPC_Filter {
 public:
 
@@ -18,6 +20,9 @@ public:
 	// Clears filter to silence
 	void clear();
 
+	// Saves or restores filter history. See Emu_State.h
+	void copy_state( Emu_State& );
+
 	// Sets gain (volume), where gain_unit is normal. Gains greater than gain_unit
 	// are fine, since output is clamped to 16-bit sample range.
 	enum { gain_unit = 0x100 };
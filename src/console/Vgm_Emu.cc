@@ -2,6 +2,7 @@
 
 #include "Vgm_Emu.h"
 
+#include "Emu_State.h"
 #include "blargg_endian.h"
 #include <string.h>
 #include <math.h>
@@ -343,6 +344,8 @@ blargg_err_t Vgm_Emu::setup_fm()
 		int result = ym2413.set_rate( fm_rate, ym2413_rate );
 		if ( result == 2 )
 			return "YM2413 FM sound isn't supported";
+		if ( result == 3 )
+			return "YM2413 FM sound is already in use at a different rate";
 		CHECK_ALLOC( !result );
 		ym2413.enable( true );
 		set_voice_count( 8 );
@@ -414,3 +417,25 @@ blargg_err_t Vgm_Emu::play_( long count, sample_t* out )
 	Dual_Resampler::dual_play( count, out, blip_buf );
 	return 0;
 }
+
+blargg_err_t Vgm_Emu::copy_state_( Emu_State& s )
+{
+	copy_buffer_state( s );
+	s.copy( vgm_time );
+	s.copy( pos );
+	s.copy( pcm_pos );
+	s.copy( dac_amp );
+	s.copy( dac_disabled );
+	s.copy( psg );
+	if ( uses_fm )
+	{
+		s.copy( fm_time_offset );
+		Dual_Resampler::copy_state( s );
+		blip_buf.copy_state( s );
+		if ( ym2612.enabled() )
+			ym2612.copy_state( s );
+		if ( ym2413.enabled() )
+			ym2413.copy_state( s );
+	}
+	return 0;
+}
@@ -6,6 +6,7 @@
 
 #include "Dual_Resampler.h"
 #include "Classic_Emu.h"
+#include "Emu_State.h"
 #include "Ym2413_Emu.h"
 #include "Ym2612_Emu.h"
 #include "Sms_Apu.h"
@@ -22,6 +23,7 @@ public:
 	bool enabled() const            { return last_time != disabled_time; }
 	void begin_frame( short* p );
 	int run_until( int time );
+	void copy_state( Emu_State& s ) { Emu::copy_state( s ); s.copy( last_time ); }
 };
 
 class Vgm_Emu_Impl : public Classic_Emu, private Dual_Resampler {
@@ -2146,14 +2146,20 @@ OPLL_calc_stereo (OPLL * opll, e_int32 out[2])
 // Ym2413_Emu
 #include "Ym2413_Emu.h"
 
-#include <assert.h>
+#include "Emu_State.h"
+#include <mutex>
 
+// emu2413 builds its tables in global data for one clock and sample rate, so
+// chips used at the same time (possibly from different threads) must all use
+// the same rates
+static std::mutex tables_mutex;
 static int use_count = 0;
 
 Ym2413_Emu::~Ym2413_Emu()
 {
 	if ( opll )
 	{
+		std::lock_guard<std::mutex> lock( tables_mutex );
 		use_count--;
 		OPLL_delete( opll );
 	}
@@ -2166,6 +2172,8 @@ Ym2413_Emu::Ym2413_Emu()
 
 int Ym2413_Emu::set_rate( double sample_rate, double clock_rate )
 {
+	std::lock_guard<std::mutex> lock( tables_mutex );
+
 	if ( opll )
 	{
 		OPLL_delete( opll );
@@ -2173,13 +2181,13 @@ int Ym2413_Emu::set_rate( double sample_rate, double clock_rate )
 		use_count--;
 	}
 
-	// Only one YM2413 may be used at a time (emu2413 uses lots of global data)
-	assert( use_count == 0 );
-	use_count++;
+	if ( use_count && ((e_uint32) clock_rate != clk || (e_uint32) sample_rate != rate) )
+		return 3;
 
 	opll = OPLL_new ((int) clock_rate, (int) sample_rate);
 	if ( !opll )
 		return 1;
+	use_count++;
 
 	reset();
 	return 0;
@@ -2187,10 +2195,10 @@ int Ym2413_Emu::set_rate( double sample_rate, double clock_rate )
 
 void Ym2413_Emu::reset()
 {
+	// OPLL_set_quality() isn't used since it rebuilds the shared tables
 	OPLL_reset( opll );
 	OPLL_reset_patch( opll, 0 );
 	OPLL_setMask( opll, 0 );
-	OPLL_set_quality( opll, 0 );
 }
 
 void Ym2413_Emu::write( int addr, int data )
@@ -2198,6 +2206,8 @@ void Ym2413_Emu::write( int addr, int data )
 	OPLL_writeReg( opll, addr, data );
 }
 
+void Ym2413_Emu::copy_state( Emu_State& s ) { s.copy( opll, sizeof *opll ); }
+
 void Ym2413_Emu::mute_voices( int mask )
 {
 	OPLL_setMask( opll, mask );
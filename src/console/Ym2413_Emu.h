@@ -4,6 +4,8 @@
 #ifndef YM2413_EMU_H
 #define YM2413_EMU_H
 
+class Emu_State;
+
 class Ym2413_Emu  {
 	struct OPLL* opll;
 public:
@@ -11,7 +13,7 @@ public:
 	~Ym2413_Emu();
 
 	// Set output sample rate and chip clock rates, in Hz. Returns non-zero
-	// if error.
+	// if error, 3 if another chip is in use at different rates.
 	int set_rate( double sample_rate, double clock_rate );
 
 	// Reset to power-up state
@@ -21,6 +23,9 @@ public:
 	enum { channel_count = 14 };
 	void mute_voices( int mask );
 
+	// Save or restore chip state. See Emu_State.h
+	void copy_state( Emu_State& );
+
 	// Write 'data' to 'addr'
 	void write( int addr, int data );
 
@@ -4,6 +4,8 @@
 
 #include "Ym2612_Emu.h"
 
+#include "Emu_State.h"
+
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
@@ -961,6 +963,8 @@ void Ym2612_Emu::write1( int addr, int data )
 
 void Ym2612_Emu::mute_voices( int mask ) { impl->mute_mask = mask; }
 
+void Ym2612_Emu::copy_state( Emu_State& s ) { s.copy( impl->YM2612 ); }
+
 static void update_envelope_( slot_t* sl )
 {
 	switch ( sl->Ecurp )
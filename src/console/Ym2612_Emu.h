@@ -4,6 +4,8 @@
 #ifndef YM2612_EMU_H
 #define YM2612_EMU_H
 
+class Emu_State;
+
 struct Ym2612_Impl;
 
 class Ym2612_Emu  {
@@ -23,6 +25,9 @@ public:
 	enum { channel_count = 6 };
 	void mute_voices( int mask );
 
+	// Save or restore chip state. See Emu_State.h
+	void copy_state( Emu_State& );
+
 	// Write addr to register 0 then data to register 1
 	void write0( int addr, int data );
 
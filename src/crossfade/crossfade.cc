@@ -18,11 +18,15 @@
  */
 
 #include <math.h>
+#include <stdlib.h>
+
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 #include <libaudcore/runtime.h>
 
+#include "../effect-common/profile.h"
+
 enum
 {
     STATE_OFF,
@@ -32,14 +36,38 @@ enum
     STATE_FLUSHED
 };
 
+enum
+{
+    CURVE_LINEAR,
+    CURVE_SIGMOID,
+    CURVE_EQUAL_POWER,
+    CURVE_CUSTOM
+};
+
+/* resolution of the cached fade curve */
+#define CURVE_POINTS 1024
+
+/* gains are computed this many frames at a time, then applied in one pass */
+#define BLOCK_FRAMES 256
+
+/* windowed-sinc resampler used when the sample rate changes during a fade */
+#define SINC_ZEROS 16 /* zero crossings on either side */
+#define SINC_STEPS 64 /* table entries per zero crossing */
+
+/* limit on how much leading or trailing silence is skipped */
+#define MAX_SILENCE_SECS 10
+
 static const char * const crossfade_defaults[] = {
     "automatic", "TRUE",
     "length", "5",
     "manual", "TRUE",
     "manual_length", "0.2",
     "no_fade_in", "FALSE",
-    "use_sigmoid", "FALSE",
+    "curve", "0",
     "sigmoid_steepness", "6",
+    "custom_curve", "0 0.5 0.8 0.95 1",
+    "skip_silence", "FALSE",
+    "silence_threshold", "-40",
     nullptr
 };
 
@@ -47,28 +75,51 @@ static const char crossfade_about[] =
  N_("Crossfade Plugin for Audacious\n"
     "Copyright 2010-2014 John Lindgren");
 
+static void update_config ();
+
+static const ComboItem curve_elements[] = {
+    ComboItem (N_("Linear"), CURVE_LINEAR),
+    ComboItem (N_("S-curve"), CURVE_SIGMOID),
+    ComboItem (N_("Equal power"), CURVE_EQUAL_POWER),
+    ComboItem (N_("Custom"), CURVE_CUSTOM)
+};
+
 static const PreferencesWidget crossfade_widgets[] = {
     WidgetLabel (N_("<b>Crossfade</b>")),
     WidgetCheck (N_("On automatic song change"),
-        WidgetBool ("crossfade", "automatic")),
+        WidgetBool ("crossfade", "automatic", update_config)),
     WidgetSpin (N_("Overlap:"),
-        WidgetFloat ("crossfade", "length"),
+        WidgetFloat ("crossfade", "length", update_config),
         {1, 15, 0.5, N_("seconds")},
         WIDGET_CHILD),
     WidgetCheck (N_("On seek or manual song change"),
-        WidgetBool ("crossfade", "manual")),
+        WidgetBool ("crossfade", "manual", update_config)),
     WidgetSpin (N_("Overlap:"),
-        WidgetFloat ("crossfade", "manual_length"),
+        WidgetFloat ("crossfade", "manual_length", update_config),
         {0.1, 3.0, 0.1, N_("seconds")},
         WIDGET_CHILD),
     WidgetCheck (N_("No fade in"),
-        WidgetBool ("crossfade", "no_fade_in")),
-    WidgetCheck (N_("Use S-curve fade"),
-        WidgetBool ("crossfade", "use_sigmoid")),
+        WidgetBool ("crossfade", "no_fade_in", update_config)),
+    WidgetCombo (N_("Fade curve:"),
+        WidgetInt ("crossfade", "curve", update_config),
+        {{curve_elements}}),
     WidgetSpin (N_("S-curve steepness:"),
-        WidgetFloat ("crossfade", "sigmoid_steepness"),
+        WidgetFloat ("crossfade", "sigmoid_steepness", update_config),
         {2.0, 16.0, 0.5, N_("(higher is steeper)")},
         WIDGET_CHILD),
+    WidgetEntry (N_("Custom curve:"),
+        WidgetString ("crossfade", "custom_curve", update_config),
+        {},
+        WIDGET_CHILD),
+    WidgetLabel (N_("The custom curve is a list of gains from 0 to 1,\n"
+                    "evenly spaced over the fade-in."),
+        WIDGET_CHILD),
+    WidgetCheck (N_("Overlap at the audible start and end of songs"),
+        WidgetBool ("crossfade", "skip_silence", update_config)),
+    WidgetSpin (N_("Silence threshold:"),
+        WidgetInt ("crossfade", "silence_threshold", update_config),
+        {-60, -20, 1, N_("dB")},
+        WIDGET_CHILD),
     WidgetLabel (N_("<b>Tip</b>")),
     WidgetLabel (N_("For better crossfading, enable\n"
                     "the Silence Removal effect."))
@@ -101,14 +152,132 @@ public:
 
 EXPORT Crossfade aud_plugin_instance;
 
+static EffectProfile profile (N_("Crossfade"));
+
 static char state = STATE_OFF;
 static int current_channels, current_rate;
 static Index<float> buffer, output;
 static int fadein_point;
 
+static bool cfg_automatic, cfg_manual, cfg_no_fade_in, cfg_skip_silence;
+static double cfg_length, cfg_manual_length;
+static float cfg_silence_threshold;
+
+/* With skip_silence, the buffer is analyzed as it fills: audible_end is the
+ * offset just past the last audible frame in the buffer.  Trailing silence
+ * after it is held back (up to a limit) and cut before the fade-out, and
+ * leading silence of the next song is dropped before the fade-in starts. */
+static int audible_end;
+static bool skipping_lead;
+static int lead_skipped;
+
+/* gain at CURVE_POINTS + 1 evenly spaced positions of a fade-in */
+static float curve[CURVE_POINTS + 1];
+
+/* right half of the resampling kernel, SINC_STEPS entries per unit */
+static float sinc_table[SINC_ZEROS * SINC_STEPS + 2];
+
+static float sigmoid_gain (float x, float steepness)
+{
+    return 0.5f + 0.5f * tanhf (steepness * (x - 0.5f));
+}
+
+/* parses a list of gains, spaced evenly from the start to the end of a
+ * fade-in, and interpolates it linearly */
+static bool build_custom_curve (const char * list)
+{
+    Index<float> points;
+
+    const char * p = list;
+    char * end;
+    float value;
+
+    while ((value = strtof (p, & end)), end != p)
+    {
+        points.append (aud::clamp (value, 0.0f, 1.0f));
+        p = end;
+
+        while (* p == ' ' || * p == ',' || * p == ';')
+            p ++;
+    }
+
+    if (points.len () < 2)
+        return false;
+
+    for (int i = 0; i <= CURVE_POINTS; i ++)
+    {
+        float pos = (float) i * (points.len () - 1) / CURVE_POINTS;
+        int j = aud::min ((int) pos, points.len () - 2);
+        curve[i] = points[j] + (points[j + 1] - points[j]) * (pos - j);
+    }
+
+    return true;
+}
+
+static void build_curve ()
+{
+    int type = aud_get_int ("crossfade", "curve");
+    float steepness = aud_get_double ("crossfade", "sigmoid_steepness");
+
+    if (type == CURVE_CUSTOM &&
+     build_custom_curve (aud_get_str ("crossfade", "custom_curve")))
+        return;
+
+    for (int i = 0; i <= CURVE_POINTS; i ++)
+    {
+        float x = (float) i / CURVE_POINTS;
+
+        if (type == CURVE_SIGMOID)
+            curve[i] = sigmoid_gain (x, steepness);
+        else if (type == CURVE_EQUAL_POWER)
+            curve[i] = sinf (x * (float) M_PI_2);
+        else
+            curve[i] = x;
+    }
+}
+
+static void build_sinc_table ()
+{
+    sinc_table[0] = 1;
+
+    for (int i = 1; i < SINC_ZEROS * SINC_STEPS + 2; i ++)
+    {
+        double x = (double) i / SINC_STEPS;
+        double u = x / SINC_ZEROS;
+        double window = (u < 1) ? 0.42 + 0.5 * cos (M_PI * u) +
+         0.08 * cos (2 * M_PI * u) : 0;
+
+        sinc_table[i] = sin (M_PI * x) / (M_PI * x) * window;
+    }
+}
+
+static void update_config ()
+{
+    cfg_automatic = aud_get_bool ("crossfade", "automatic");
+    cfg_length = aud_get_double ("crossfade", "length");
+    cfg_manual = aud_get_bool ("crossfade", "manual");
+    cfg_manual_length = aud_get_double ("crossfade", "manual_length");
+    cfg_no_fade_in = aud_get_bool ("crossfade", "no_fade_in");
+    cfg_skip_silence = aud_get_bool ("crossfade", "skip_silence");
+    cfg_silence_threshold = powf (10.0f,
+     aud_get_int ("crossfade", "silence_threshold") / 20.0f);
+
+    build_curve ();
+}
+
 bool Crossfade::init ()
 {
     aud_config_set_defaults ("crossfade", crossfade_defaults);
+
+    /* carry over the old on/off S-curve setting */
+    if (aud_get_bool ("crossfade", "use_sigmoid"))
+    {
+        aud_set_int ("crossfade", "curve", CURVE_SIGMOID);
+        aud_set_bool ("crossfade", "use_sigmoid", false);
+    }
+
+    update_config ();
+    build_sinc_table ();
     return true;
 }
 
@@ -117,39 +286,121 @@ void Crossfade::cleanup ()
     state = STATE_OFF;
     buffer.clear ();
     output.clear ();
+    audible_end = 0;
 }
 
-static void do_linear_ramp (float * data, int length, float a, float b)
+/* same test as the Silence Removal plugin */
+static bool is_audible (float sample)
 {
-    for (int i = 0; i < length; i ++)
-        (* data ++) *= (a * (length - i) + b * i) / length;
+    return sample > cfg_silence_threshold || sample < -cfg_silence_threshold;
 }
 
-static void do_sigmoid_ramp (float * data, int length, float a, float b)
+/* returns the offset of the first frame with an audible sample, or -1 */
+static int find_audible_start (const float * data, int len)
 {
-    float steepness = aud_get_double ("crossfade", "sigmoid_steepness");
-    for (int i = 0; i < length; i ++)
+    for (int i = 0; i < len; i ++)
     {
-        float linear = (a * (length - i) + b * i) / length;
-        (* data ++) *= 0.5f + 0.5f * tanhf (steepness * (linear - 0.5f));
+        if (is_audible (data[i]))
+            return i - i % current_channels;
     }
+
+    return -1;
 }
 
-static void do_ramp (float * data, int length, float a, float b)
+/* returns the offset just past the last frame with an audible sample, or 0;
+ * this scans backwards, so silence is only looked at once */
+static int find_audible_end (const float * data, int len)
 {
-    if (aud_get_bool ("crossfade", "use_sigmoid"))
-        do_sigmoid_ramp (data, length, a, b);
+    for (int i = len; i --; )
+    {
+        if (is_audible (data[i]))
+            return i - i % current_channels + current_channels;
+    }
+
+    return 0;
+}
+
+static void append_to_buffer (const float * data, int len)
+{
+    int offset = buffer.len ();
+    buffer.insert (data, -1, len);
+
+    if (cfg_skip_silence)
+    {
+        int end = find_audible_end (data, len);
+        if (end)
+            audible_end = offset + end;
+    }
+}
+
+static float curve_at (float x)
+{
+    float pos = aud::clamp (x, 0.0f, 1.0f) * CURVE_POINTS;
+    int i = aud::min ((int) pos, CURVE_POINTS - 1);
+
+    return curve[i] + (curve[i + 1] - curve[i]) * (pos - i);
+}
+
+static void apply_gains (float * __restrict data, const float * __restrict gains,
+ int frames)
+{
+    if (current_channels == 2)
+    {
+        for (int f = 0; f < frames; f ++)
+        {
+            data[2 * f] *= gains[f];
+            data[2 * f + 1] *= gains[f];
+        }
+    }
     else
-        do_linear_ramp (data, length, a, b);
+    {
+        for (int f = 0; f < frames; f ++)
+        {
+            for (int c = 0; c < current_channels; c ++)
+                data[f * current_channels + c] *= gains[f];
+        }
+    }
+}
+
+/* applies the fade curve from position a to position b (0 = silent, 1 = full
+ * volume) over length samples */
+static void do_ramp (float * data, int length, float a, float b)
+{
+    int frames = length / current_channels;
+    float gains[BLOCK_FRAMES];
+
+    for (int f0 = 0; f0 < frames; f0 += BLOCK_FRAMES)
+    {
+        int block = aud::min (BLOCK_FRAMES, frames - f0);
+
+        for (int i = 0; i < block; i ++)
+            gains[i] = curve_at (a + (b - a) * (f0 + i) / frames);
+
+        apply_gains (data + f0 * current_channels, gains, block);
+    }
 }
 
-static void mix (float * data, float * add, int length)
+static void mix (float * __restrict data, const float * __restrict add, int length)
 {
-    while (length --)
-        (* data ++) += (* add ++);
+    for (int i = 0; i < length; i ++)
+        data[i] += add[i];
 }
 
-/* stupid simple resampling/rechanneling algorithm */
+static float sinc_at (float x)
+{
+    float pos = fabsf (x) * SINC_STEPS;
+    int i = (int) pos;
+
+    if (i >= SINC_ZEROS * SINC_STEPS)
+        return 0;
+
+    return sinc_table[i] + (sinc_table[i + 1] - sinc_table[i]) * (pos - i);
+}
+
+/* Converts the pending buffer to a new sample rate and channel count.  The
+ * rate conversion is a band-limited (windowed-sinc) interpolation; when going
+ * down in rate, the kernel is stretched so that it also acts as the
+ * anti-aliasing filter.  Channels are mapped to the nearest old channel. */
 static void reformat (int channels, int rate)
 {
     if (channels == current_channels && rate == current_rate)
@@ -165,43 +416,84 @@ static void reformat (int channels, int rate)
     Index<float> new_buffer;
     new_buffer.resize (new_frames * channels);
 
+    double step = (double) current_rate / rate;
+    float cutoff = aud::min (1.0, 1 / step);
+    int reach = (int) ceilf (SINC_ZEROS / cutoff);
+
     for (int f = 0; f < new_frames; f ++)
     {
-        int f0 = (int64_t) f * current_rate / rate;
-        int s0 = f0 * current_channels;
-        int s = f * channels;
+        double t = f * step;
+        int center = (int) t;
+
+        int j0 = aud::max (0, center - reach + 1);
+        int j1 = aud::min (old_frames - 1, center + reach);
+
+        float * out = & new_buffer[f * channels];
+        float total = 0;
 
         for (int c = 0; c < channels; c ++)
-            new_buffer[s + c] = buffer[s0 + map[c]];
+            out[c] = 0;
+
+        for (int j = j0; j <= j1; j ++)
+        {
+            float w = sinc_at ((float) (t - j) * cutoff);
+            const float * in = & buffer[j * current_channels];
+
+            for (int c = 0; c < channels; c ++)
+                out[c] += in[map[c]] * w;
+
+            total += w;
+        }
+
+        /* renormalize, which also takes care of the edges of the buffer */
+        if (total > 0)
+        {
+            for (int c = 0; c < channels; c ++)
+                out[c] /= total;
+        }
     }
 
     buffer = std::move (new_buffer);
+    audible_end = (int64_t) (audible_end / current_channels) * rate / current_rate * channels;
 }
 
 static int buffer_needed_for_state ()
 {
     double overlap = 0;
 
-    if (state != STATE_FLUSHED && aud_get_bool ("crossfade", "automatic"))
-        overlap = aud_get_double ("crossfade", "length");
+    if (state != STATE_FLUSHED && cfg_automatic)
+        overlap = cfg_length;
 
-    if (state != STATE_FINISHED && aud_get_bool ("crossfade", "manual"))
-        overlap = aud::max (overlap, aud_get_double ("crossfade", "manual_length"));
+    if (state != STATE_FINISHED && cfg_manual)
+        overlap = aud::max (overlap, cfg_manual_length);
 
     return current_channels * (int) (current_rate * overlap);
 }
 
 static void output_data_as_ready (int buffer_needed, bool exact)
 {
+    /* hold back trailing silence so that the overlap ends where the audio
+     * does; the end of the song is never exact while doing so */
+    if (cfg_skip_silence && buffer_needed)
+    {
+        int max_silence = current_channels * current_rate * MAX_SILENCE_SECS;
+        buffer_needed += aud::min (buffer.len () - audible_end, max_silence);
+    }
+
     int copy = buffer.len () - buffer_needed;
 
     /* if allowed, wait until we have at least 1/2 second ready to output */
     if (exact ? (copy > 0) : (copy >= current_channels * (current_rate / 2)))
+    {
         output.move_from (buffer, 0, -1, copy, true, true);
+        audible_end = aud::max (0, audible_end - copy);
+    }
 }
 
 void Crossfade::start (int & channels, int & rate)
 {
+    profile.start (channels, rate);
+
     if (state != STATE_OFF)
         reformat (channels, rate);
 
@@ -210,7 +502,7 @@ void Crossfade::start (int & channels, int & rate)
 
     if (state == STATE_OFF)
     {
-        if (aud_get_bool ("crossfade", "manual"))
+        if (cfg_manual)
         {
             state = STATE_FLUSHED;
             buffer.insert (0, buffer_needed_for_state ());
@@ -222,14 +514,51 @@ void Crossfade::start (int & channels, int & rate)
 
 static void run_fadeout ()
 {
+    /* on automatic song change, cut trailing silence so that the overlap
+     * starts at the audible end */
+    bool skip_silence = cfg_skip_silence && state == STATE_FINISHED;
+
+    if (skip_silence && buffer.len () > audible_end)
+        buffer.remove (audible_end, -1);
+
     do_ramp (buffer.begin (), buffer.len (), 1.0, 0.0);
 
     state = STATE_FADEIN;
     fadein_point = 0;
+
+    skipping_lead = skip_silence;
+    lead_skipped = 0;
+}
+
+static void skip_leading_silence (Index<float> & data)
+{
+    int max_skip = current_channels * current_rate * MAX_SILENCE_SECS - lead_skipped;
+    int start = find_audible_start (data.begin (), data.len ());
+
+    if (start < 0)
+        start = data.len ();
+    else
+        skipping_lead = false;
+
+    if (start >= max_skip)
+    {
+        start = max_skip;
+        skipping_lead = false;
+    }
+
+    data.remove (0, start);
+    lead_skipped += start;
 }
 
 static void run_fadein (Index<float> & data)
 {
+    if (skipping_lead)
+    {
+        skip_leading_silence (data);
+        if (skipping_lead)
+            return;
+    }
+
     int length = buffer.len ();
 
     if (fadein_point < length)
@@ -238,10 +567,18 @@ static void run_fadein (Index<float> & data)
         float a = (float) fadein_point / length;
         float b = (float) (fadein_point + copy) / length;
 
-        if (! aud_get_bool ("crossfade", "no_fade_in"))
+        if (! cfg_no_fade_in)
             do_ramp (data.begin (), copy, a, b);
 
         mix (& buffer[fadein_point], data.begin (), copy);
+
+        if (cfg_skip_silence)
+        {
+            int end = find_audible_end (data.begin (), copy);
+            if (end)
+                audible_end = aud::max (audible_end, fadein_point + end);
+        }
+
         data.remove (0, copy);
 
         fadein_point += copy;
@@ -253,6 +590,8 @@ static void run_fadein (Index<float> & data)
 
 Index<float> & Crossfade::process (Index<float> & data)
 {
+    EffectProfile::Timer timer (profile, data);
+
     if (state == STATE_OFF)
         return data;
 
@@ -266,7 +605,7 @@ Index<float> & Crossfade::process (Index<float> & data)
 
     if (state == STATE_RUNNING)
     {
-        buffer.insert (data.begin (), -1, data.len ());
+        append_to_buffer (data.begin (), data.len ());
         output_data_as_ready (buffer_needed_for_state (), false);
     }
 
@@ -278,24 +617,28 @@ bool Crossfade::flush (bool force)
     if (state == STATE_OFF)
         return true;
 
-    if (! force && aud_get_bool ("crossfade", "manual"))
+    if (! force && cfg_manual)
     {
         state = STATE_FLUSHED;
         int buffer_needed = buffer_needed_for_state ();
         if (buffer.len () > buffer_needed)
             buffer.remove (buffer_needed, -1);
 
+        audible_end = aud::min (audible_end, buffer.len ());
         return false;
     }
 
     state = STATE_RUNNING;
     buffer.resize (0);
+    audible_end = 0;
 
     return true;
 }
 
 Index<float> & Crossfade::finish (Index<float> & data, bool end_of_playlist)
 {
+    EffectProfile::Timer timer (profile, data);
+
     if (state == STATE_OFF)
         return data;
 
@@ -306,13 +649,13 @@ Index<float> & Crossfade::finish (Index<float> & data, bool end_of_playlist)
 
     if (state == STATE_RUNNING || state == STATE_FINISHED || state == STATE_FLUSHED)
     {
-        buffer.insert (data.begin (), -1, data.len ());
+        append_to_buffer (data.begin (), data.len ());
         output_data_as_ready (buffer_needed_for_state (), state != STATE_RUNNING);
     }
 
     if (state == STATE_FADEIN || state == STATE_RUNNING)
     {
-        if (aud_get_bool ("crossfade", "automatic"))
+        if (cfg_automatic)
         {
             state = STATE_FINISHED;
             output_data_as_ready (buffer_needed_for_state (), true);
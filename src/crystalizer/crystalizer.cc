@@ -23,6 +23,8 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/profile.h"
+
 static const char * const cryst_defaults[] = {
  "intensity", "1",
  nullptr};
@@ -58,6 +60,8 @@ public:
 
 EXPORT Crystalizer aud_plugin_instance;
 
+static EffectProfile profile (N_("Crystalizer"));
+
 static int cryst_channels;
 static Index<float> cryst_prev;
 
@@ -74,6 +78,8 @@ void Crystalizer::cleanup ()
 
 void Crystalizer::start (int & channels, int & rate)
 {
+    profile.start (channels, rate);
+
     cryst_channels = channels;
     cryst_prev.resize (cryst_channels);
     cryst_prev.erase (0, cryst_channels);
@@ -81,6 +87,8 @@ void Crystalizer::start (int & channels, int & rate)
 
 Index<float> & Crystalizer::process (Index<float> & data)
 {
+    EffectProfile::Timer timer (profile, data);
+
     float value = aud_get_double ("crystalizer", "intensity");
     float * f = data.begin ();
     float * end = data.end ();
@@ -0,0 +1,213 @@
+/*
+ * Cue Sheet Parser for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/runtime.h>
+
+#include "cue-parser.h"
+
+static bool is_blank (char c)
+    { return c == ' ' || c == '\t'; }
+
+static char * skip_blanks (char * p)
+{
+    while (is_blank (* p))
+        p ++;
+
+    return p;
+}
+
+/* Cuts the next word or quoted string out of the line. */
+static char * next_token (char * & p)
+{
+    char * start;
+
+    p = skip_blanks (p);
+
+    if (* p == '"')
+    {
+        start = ++ p;
+        while (* p && * p != '"')
+            p ++;
+    }
+    else
+    {
+        start = p;
+        while (* p && ! is_blank (* p))
+            p ++;
+    }
+
+    if (* p)
+        * p ++ = 0;
+
+    return start;
+}
+
+/* A quoted string, or else the rest of the line, for values that some
+ * programs write unquoted even when they contain spaces */
+static char * rest_of_line (char * & p)
+{
+    p = skip_blanks (p);
+
+    if (* p == '"')
+        return next_token (p);
+
+    char * start = p;
+    char * end = p + strlen (p);
+
+    while (end > start && is_blank (end[-1]))
+        end --;
+
+    * end = 0;
+    p = end;
+
+    return start;
+}
+
+/* FILE "name" TYPE; an unquoted name may contain spaces, so the type is
+ * taken from the end of the line */
+static char * file_name (char * & p)
+{
+    p = skip_blanks (p);
+
+    if (* p == '"')
+        return next_token (p);
+
+    char * name = rest_of_line (p);
+    char * type = strrchr (name, ' ');
+
+    if (type)
+    {
+        while (type > name && is_blank (type[-1]))
+            type --;
+
+        * type = 0;
+    }
+
+    return name;
+}
+
+/* mm:ss:ff */
+static int parse_time (const char * s)
+{
+    int min = 0, sec = 0, frame = 0;
+
+    if (sscanf (s, "%d:%d:%d", & min, & sec, & frame) != 3)
+        return -1;
+
+    return (min * 60 + sec) * 75 + frame;
+}
+
+static void set_text (CueText & text, const char * key, const char * value)
+{
+    if (! strcmp_nocase (key, "PERFORMER"))
+        text.performer = String (value);
+    else if (! strcmp_nocase (key, "TITLE"))
+        text.title = String (value);
+    else if (! strcmp_nocase (key, "GENRE"))
+        text.genre = String (value);
+    else if (! strcmp_nocase (key, "COMPOSER"))
+        text.composer = String (value);
+}
+
+bool cue_parse (char * text, CueSheet & sheet)
+{
+    String filename;
+    CueTrack * track = nullptr;
+    bool have_index1 = false;
+
+    /* UTF-8 byte order mark */
+    if (! strncmp (text, "\xef\xbb\xbf", 3))
+        text += 3;
+
+    for (char * line = text; line; )
+    {
+        char * next = strchr (line, '\n');
+        if (next)
+            * next ++ = 0;
+
+        int len = strlen (line);
+        if (len && line[len - 1] == '\r')
+            line[len - 1] = 0;
+
+        char * p = line;
+        const char * command = next_token (p);
+
+        if (! strcmp_nocase (command, "FILE"))
+            filename = String (file_name (p));
+        else if (! strcmp_nocase (command, "TRACK"))
+        {
+            track = & sheet.tracks.append ();
+            track->filename = filename;
+            have_index1 = false;
+        }
+        else if (! strcmp_nocase (command, "INDEX"))
+        {
+            int number = str_to_int (next_token (p));
+            int time = parse_time (next_token (p));
+
+            if (track && time >= 0 && (number == 1 || (number == 0 && ! have_index1)))
+            {
+                /* EAC leaves the gap at the end of the previous file:
+                 * TRACK 02, INDEX 00, FILE "02.wav", INDEX 01 00:00:00.
+                 * The track belongs to the file in effect at INDEX 01. */
+                track->filename = filename;
+                track->start = time;
+                have_index1 = (number == 1);
+            }
+        }
+        else if (! strcmp_nocase (command, "REM"))
+        {
+            const char * key = next_token (p);
+            const char * value = rest_of_line (p);
+
+            if (! track && ! strcmp_nocase (key, "DATE"))
+                sheet.date = String (value);
+            else if (! track && ! strcmp_nocase (key, "REPLAYGAIN_ALBUM_GAIN"))
+                sheet.gain = String (value);
+            else if (! track && ! strcmp_nocase (key, "REPLAYGAIN_ALBUM_PEAK"))
+                sheet.peak = String (value);
+            else if (track && ! strcmp_nocase (key, "REPLAYGAIN_TRACK_GAIN"))
+                track->gain = String (value);
+            else if (track && ! strcmp_nocase (key, "REPLAYGAIN_TRACK_PEAK"))
+                track->peak = String (value);
+            else  /* EAC writes GENRE and COMPOSER as comments */
+                set_text (track ? track->text : sheet.text, key, value);
+        }
+        else if (command[0])
+            set_text (track ? track->text : sheet.text, command, rest_of_line (p));
+
+        line = next;
+    }
+
+    /* a track without a file cannot be played */
+    for (int i = sheet.tracks.len (); i --; )
+    {
+        if (! sheet.tracks[i].filename)
+        {
+            AUDWARN ("Cue sheet track %d has no FILE\n", i + 1);
+            sheet.tracks.remove (i, 1);
+        }
+    }
+
+    return sheet.tracks.len () > 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * Cue Sheet Parser for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef CUE_PARSER_H
+#define CUE_PARSER_H
+
+#include <libaudcore/index.h>
+#include <libaudcore/objects.h>
+
+struct CueText
+{
+    String performer, title, genre, composer;
+};
+
+struct CueTrack
+{
+    String filename;  /* from the FILE command in effect at INDEX 01 */
+    int start = 0;    /* INDEX 01 (or 00 if there is none), in frames of 1/75 s */
+    CueText text;
+    String gain, peak;  /* REM REPLAYGAIN_TRACK_GAIN/PEAK */
+};
+
+struct CueSheet
+{
+    CueText text;
+    String date;        /* REM DATE */
+    String gain, peak;  /* REM REPLAYGAIN_ALBUM_GAIN/PEAK */
+    Index<CueTrack> tracks;
+};
+
+/* Parses a null-terminated cue sheet, overwriting the text in the process.
+ * No state is kept between calls, so several sheets can be parsed at once on
+ * different threads.  Returns false if the sheet has no tracks. */
+bool cue_parse (char * text, CueSheet & sheet);
+
+#endif
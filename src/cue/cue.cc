@@ -18,21 +18,17 @@
  */
 
 #include <string.h>
-#include <pthread.h>
-
-#ifdef HAVE_LIBCUE2
-#include <libcue.h>
-#else
-extern "C" {
-#include <libcue/libcue.h>
-}
-#endif
+#include <sys/stat.h>
 
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
+#include <libaudcore/multihash.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/probe.h>
 #include <libaudcore/runtime.h>
+#include <libaudcore/threads.h>
+
+#include "cue-parser.h"
 
 static const char * const cue_exts[] = {"cue"};
 
@@ -42,12 +38,76 @@ public:
     static constexpr PluginInfo info = {N_("Cue Sheet Plugin"), PACKAGE};
     constexpr CueLoader () : PlaylistPlugin (info, cue_exts, false) {}
 
+    void cleanup ();
+
     bool load (const char * filename, VFSFile & file, String & title,
      Index<PlaylistAddItem> & items);
 };
 
 EXPORT CueLoader aud_plugin_instance;
 
+/* The tags of the audio files that cue sheets refer to are cached, so that
+ * reloading a library of cue sheets does not probe and read the header of
+ * every audio file again.  Entries are checked against the modification time
+ * and size of the file, which limits the cache to local files. */
+#define MAX_CACHED_TAGS 4096
+
+struct CachedTag
+{
+    int64_t mtime, size;
+    PluginHandle * decoder;
+    Tuple tuple;
+};
+
+static aud::mutex cache_mutex;
+static SimpleHash<String, CachedTag> tag_cache;
+
+void CueLoader::cleanup ()
+{
+    auto lock = cache_mutex.take ();
+    tag_cache.clear ();
+}
+
+static bool read_tag (const String & filename, PluginHandle * & decoder, Tuple & tuple)
+{
+    StringBuf local = uri_to_filename (filename);
+    struct stat st;
+    bool cacheable = (local && stat (local, & st) == 0);
+
+    if (cacheable)
+    {
+        auto lock = cache_mutex.take ();
+        CachedTag * cached = tag_cache.lookup (filename);
+
+        if (cached && cached->mtime == (int64_t) st.st_mtime &&
+         cached->size == (int64_t) st.st_size)
+        {
+            decoder = cached->decoder;
+            tuple = cached->tuple.ref ();
+            return true;
+        }
+    }
+
+    VFSFile file;
+    decoder = aud_file_find_decoder (filename, false, file);
+
+    if (! decoder || ! aud_file_read_tag (filename, decoder, file, tuple))
+        return false;
+
+    if (cacheable)
+    {
+        auto lock = cache_mutex.take ();
+
+        if (tag_cache.n_items () >= MAX_CACHED_TAGS)
+            tag_cache.clear ();
+
+        tag_cache.add (filename, {(int64_t) st.st_mtime, (int64_t) st.st_size,
+         decoder, tuple.ref ()});
+    }
+
+    return true;
+}
+
 static bool is_year (const char * s)
 {
     auto is_digit = [] (char c)
@@ -60,29 +120,17 @@ static bool is_year (const char * s)
 bool CueLoader::load (const char * cue_filename, VFSFile & file, String & title,
  Index<PlaylistAddItem> & items)
 {
-    // XXX: cue_parse_string crashes if called concurrently
-    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-
     Index<char> buffer = file.read_all ();
     if (! buffer.len ())
         return false;
 
     buffer.append (0);  /* null-terminate */
 
-    pthread_mutex_lock (& mutex);
-    Cd * cd = cue_parse_string (buffer.begin ());
-    pthread_mutex_unlock (& mutex);
-
-    int tracks = cd ? cd_get_ntrack (cd) : 0;
-    if (tracks < 1)
-        return false;
-
-    Track * cur = cd_get_track (cd, 1);
-    const char * cur_name = cur ? track_get_filename (cur) : nullptr;
-
-    if (! cur_name)
+    CueSheet cd;
+    if (! cue_parse (buffer.begin (), cd))
         return false;
 
+    int tracks = cd.tracks.len ();
     bool same_file = false;
     String filename;
     PluginHandle * decoder = nullptr;
@@ -90,63 +138,47 @@ bool CueLoader::load (const char * cue_filename, VFSFile & file, String & title,
 
     for (int track = 1; track <= tracks; track ++)
     {
+        const CueTrack & cur = cd.tracks[track - 1];
+
         if (! same_file)
         {
-            filename = String (uri_construct (cur_name, cue_filename));
+            filename = String (uri_construct (cur.filename, cue_filename));
             decoder = nullptr;
             base_tuple = Tuple ();
 
-            VFSFile file;
-
-            if (filename)
-                decoder = aud_file_find_decoder (filename, false, file);
-            else
+            if (! filename)
                 AUDWARN ("Unable to construct URI for track '%s' in cuesheet '%s'\n",
-                 cur_name, cue_filename);
+                 (const char *) cur.filename, cue_filename);
 
-            if (decoder && aud_file_read_tag (filename, decoder, file, base_tuple))
+            if (filename && read_tag (filename, decoder, base_tuple))
             {
-                Cdtext * cdtext = cd_get_cdtext (cd);
-
-                if (cdtext)
+                if (cd.text.performer)
+                    base_tuple.set_str (Tuple::AlbumArtist, cd.text.performer);
+                if (cd.text.title)
+                    base_tuple.set_str (Tuple::Album, cd.text.title);
+                if (cd.text.genre)
+                    base_tuple.set_str (Tuple::Genre, cd.text.genre);
+                if (cd.text.composer)
+                    base_tuple.set_str (Tuple::Composer, cd.text.composer);
+
+                if (cd.date)
                 {
-                    const char * s;
-                    if ((s = cdtext_get (PTI_PERFORMER, cdtext)))
-                        base_tuple.set_str (Tuple::AlbumArtist, s);
-                    if ((s = cdtext_get (PTI_TITLE, cdtext)))
-                        base_tuple.set_str (Tuple::Album, s);
-                    if ((s = cdtext_get (PTI_GENRE, cdtext)))
-                        base_tuple.set_str (Tuple::Genre, s);
-                    if ((s = cdtext_get (PTI_COMPOSER, cdtext)))
-                        base_tuple.set_str (Tuple::Composer, s);
+                    if (is_year (cd.date))
+                        base_tuple.set_int (Tuple::Year, str_to_int (cd.date));
+                    else
+                        base_tuple.set_str (Tuple::Date, cd.date);
                 }
 
-                Rem * rem = cd_get_rem (cd);
-
-                if (rem)
-                {
-                    const char * s;
-
-                    if ((s = rem_get (REM_DATE, rem)))
-                    {
-                        if (is_year (s))
-                            base_tuple.set_int (Tuple::Year, str_to_int (s));
-                        else
-                            base_tuple.set_str (Tuple::Date, s);
-                    }
-
-                    if ((s = rem_get (REM_REPLAYGAIN_ALBUM_GAIN, rem)))
-                        base_tuple.set_gain (Tuple::AlbumGain, Tuple::GainDivisor, s);
-                    if ((s = rem_get (REM_REPLAYGAIN_ALBUM_PEAK, rem)))
-                        base_tuple.set_gain (Tuple::AlbumPeak, Tuple::PeakDivisor, s);
-                }
+                if (cd.gain)
+                    base_tuple.set_gain (Tuple::AlbumGain, Tuple::GainDivisor, cd.gain);
+                if (cd.peak)
+                    base_tuple.set_gain (Tuple::AlbumPeak, Tuple::PeakDivisor, cd.peak);
             }
         }
 
-        Track * next = (track + 1 <= tracks) ? cd_get_track (cd, track + 1) : nullptr;
-        const char * next_name = next ? track_get_filename (next) : nullptr;
+        const CueTrack * next = (track < tracks) ? & cd.tracks[track] : nullptr;
 
-        same_file = (next_name && ! strcmp (next_name, cur_name));
+        same_file = (next && ! strcmp (next->filename, cur.filename));
 
         if (base_tuple.valid ())
         {
@@ -156,12 +188,13 @@ bool CueLoader::load (const char * cue_filename, VFSFile & file, String & title,
             tuple.set_int (Tuple::Track, track);
             tuple.set_str (Tuple::AudioFile, filename);
 
-            int begin = (int64_t) track_get_start (cur) * 1000 / 75;
+            int begin = (int64_t) cur.start * 1000 / 75;
             tuple.set_int (Tuple::StartTime, begin);
 
-            if (same_file)
+            /* a broken sheet may list the times out of order */
+            if (same_file && next->start > cur.start)
             {
-                int end = (int64_t) track_get_start (next) * 1000 / 75;
+                int end = (int64_t) next->start * 1000 / 75;
                 tuple.set_int (Tuple::EndTime, end);
                 tuple.set_int (Tuple::Length, end - begin);
             }
@@ -172,38 +205,20 @@ bool CueLoader::load (const char * cue_filename, VFSFile & file, String & title,
                     tuple.set_int (Tuple::Length, length - begin);
             }
 
-            Cdtext * cdtext = track_get_cdtext (cur);
-
-            if (cdtext)
-            {
-                const char * s;
-                if ((s = cdtext_get (PTI_PERFORMER, cdtext)))
-                    tuple.set_str (Tuple::Artist, s);
-                if ((s = cdtext_get (PTI_TITLE, cdtext)))
-                    tuple.set_str (Tuple::Title, s);
-                if ((s = cdtext_get (PTI_GENRE, cdtext)))
-                    tuple.set_str (Tuple::Genre, s);
-            }
-
-            Rem * rem = track_get_rem (cur);
+            if (cur.text.performer)
+                tuple.set_str (Tuple::Artist, cur.text.performer);
+            if (cur.text.title)
+                tuple.set_str (Tuple::Title, cur.text.title);
+            if (cur.text.genre)
+                tuple.set_str (Tuple::Genre, cur.text.genre);
 
-            if (rem)
-            {
-                const char * s;
-                if ((s = rem_get (REM_REPLAYGAIN_TRACK_GAIN, rem)))
-                    tuple.set_gain (Tuple::TrackGain, Tuple::GainDivisor, s);
-                if ((s = rem_get (REM_REPLAYGAIN_TRACK_PEAK, rem)))
-                    tuple.set_gain (Tuple::TrackPeak, Tuple::PeakDivisor, s);
-            }
+            if (cur.gain)
+                tuple.set_gain (Tuple::TrackGain, Tuple::GainDivisor, cur.gain);
+            if (cur.peak)
+                tuple.set_gain (Tuple::TrackPeak, Tuple::PeakDivisor, cur.peak);
 
             items.append (String (tfilename), std::move (tuple), decoder);
         }
-
-        if (! next_name)
-            break;
-
-        cur = next;
-        cur_name = next_name;
     }
 
     return true;
@@ -3,6 +3,8 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/profile.h"
+
 #define MAX_DELAY 1000
 
 static const char echo_about[] =
@@ -53,6 +55,8 @@ public:
 
 EXPORT EchoPlugin aud_plugin_instance;
 
+static EffectProfile profile (N_("Echo"));
+
 static Index<float> buffer;
 static int w_ofs;
 
@@ -72,6 +76,8 @@ static int echo_rate = 0;
 
 void EchoPlugin::start (int & channels, int & rate)
 {
+    profile.start (channels, rate);
+
     if (channels != echo_channels || rate != echo_rate)
     {
         echo_channels = channels;
@@ -86,6 +92,8 @@ void EchoPlugin::start (int & channels, int & rate)
 
 Index<float> & EchoPlugin::process (Index<float> & data)
 {
+    EffectProfile::Timer timer (profile, data);
+
     int delay = aud_get_int ("echo_plugin", "delay");
     float feedback = aud_get_int ("echo_plugin", "feedback") / 100.0f;
     float volume = aud_get_int ("echo_plugin", "volume") / 100.0f;
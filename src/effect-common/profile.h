@@ -0,0 +1,162 @@
+/*
+ * Effect Plugin Profiling
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef EFFECT_COMMON_PROFILE_H
+#define EFFECT_COMMON_PROFILE_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <libaudcore/hook.h>
+#include <libaudcore/index.h>
+#include <libaudcore/objects.h>
+#include <libaudcore/threads.h>
+
+/* Each effect plugin keeps one EffectProfile and wraps the body of process()
+ * and finish() in an EffectProfile::Timer.  The figures of all loaded effects
+ * are gathered by calling the "effect profile collect" hook with a pointer to
+ * an Index<EffectStats>; "effect profile reset" clears them.  Everything is
+ * header-only so that each plugin gets its own copy. */
+
+/* bucket 0 counts zeros, bucket n counts values in [2^(n-1), 2^n) and the last
+ * bucket also counts everything larger */
+struct EffectHistogram
+{
+    static constexpr int buckets = 24;
+    int64_t counts[buckets] {};
+
+    void add (int64_t value)
+    {
+        int b = 0;
+        while (value > 0 && b < buckets - 1)
+        {
+            value >>= 1;
+            b ++;
+        }
+
+        counts[b] ++;
+    }
+};
+
+struct EffectStats
+{
+    String name;
+    int64_t calls = 0;
+    int64_t busy_us = 0;   /* total time spent processing */
+    int64_t audio_us = 0;  /* total duration of the audio processed */
+    int64_t max_us = 0;
+    EffectHistogram time;  /* processing time per call, microseconds */
+    EffectHistogram frames;  /* buffer size per call, frames */
+    EffectHistogram load;  /* real-time factor per call, 1/1000 */
+};
+
+class EffectProfile
+{
+public:
+    class Timer
+    {
+    public:
+        Timer (EffectProfile & profile, const Index<float> & data) :
+            m_profile (profile),
+            m_samples (data.len ()),
+            m_start (now ()) {}
+
+        ~Timer ()
+            { m_profile.record (m_samples, now () - m_start); }
+
+    private:
+        EffectProfile & m_profile;
+        int m_samples;
+        int64_t m_start;
+    };
+
+    EffectProfile (const char * name) :
+        m_name (name)
+    {
+        hook_associate ("effect profile collect", collect, this);
+        hook_associate ("effect profile reset", reset, this);
+    }
+
+    ~EffectProfile ()
+    {
+        hook_dissociate ("effect profile collect", collect, this);
+        hook_dissociate ("effect profile reset", reset, this);
+    }
+
+    void start (int channels, int rate)
+    {
+        auto lock = m_mutex.take ();
+        m_channels = channels;
+        m_rate = rate;
+    }
+
+private:
+    static int64_t now ()
+    {
+        timespec ts;
+        clock_gettime (CLOCK_MONOTONIC, & ts);
+        return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    void record (int samples, int64_t us)
+    {
+        auto lock = m_mutex.take ();
+
+        if (! m_channels || ! m_rate)
+            return;
+
+        int frames = samples / m_channels;
+        int64_t audio_us = (int64_t) frames * 1000000 / m_rate;
+
+        m_stats.calls ++;
+        m_stats.busy_us += us;
+        m_stats.audio_us += audio_us;
+        m_stats.max_us = aud::max (m_stats.max_us, us);
+
+        m_stats.time.add (us);
+        m_stats.frames.add (frames);
+
+        if (audio_us)
+            m_stats.load.add (us * 1000 / audio_us);
+    }
+
+    static void collect (void * list, void * me_)
+    {
+        auto me = (EffectProfile *) me_;
+        auto lock = me->m_mutex.take ();
+
+        EffectStats & stats = ((Index<EffectStats> *) list)->append (me->m_stats);
+        stats.name = String (me->m_name);
+    }
+
+    static void reset (void *, void * me_)
+    {
+        auto me = (EffectProfile *) me_;
+        auto lock = me->m_mutex.take ();
+
+        me->m_stats = EffectStats ();
+    }
+
+    const char * m_name;
+    aud::mutex m_mutex;
+    int m_channels = 0, m_rate = 0;
+    EffectStats m_stats;
+};
+
+#endif /* EFFECT_COMMON_PROFILE_H */
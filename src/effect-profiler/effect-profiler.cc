@@ -0,0 +1,337 @@
+/*
+ * Effect Profiler Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/hook.h>
+#include <libaudcore/i18n.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
+#include <libaudcore/runtime.h>
+#include <libaudcore/vfs.h>
+
+#ifdef USE_GTK
+#include <libaudgui/gtk-compat.h>
+#include <libaudgui/libaudgui-gtk.h>
+#endif
+#ifdef USE_QT
+#include <QFontDatabase>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <libaudqt/libaudqt.h>
+#endif
+
+#include "../effect-common/profile.h"
+
+/* how often the report file is rewritten when autosave is enabled */
+#define AUTOSAVE_SECS 10
+
+class EffectProfiler : public GeneralPlugin
+{
+public:
+    static const char about[];
+    static const char * const defaults[];
+    static const PreferencesWidget widgets[];
+    static const PluginPreferences prefs;
+
+    static constexpr PluginInfo info = {
+        N_("Effect Profiler"),
+        PACKAGE,
+        about,
+        & prefs
+    };
+
+    constexpr EffectProfiler () : GeneralPlugin (info, false) {}
+
+    bool init ();
+    void cleanup ();
+
+#ifdef USE_GTK
+    void * get_gtk_widget ();
+#endif
+#ifdef USE_QT
+    void * get_qt_widget ();
+#endif
+};
+
+EXPORT EffectProfiler aud_plugin_instance;
+
+const char EffectProfiler::about[] =
+ N_("Effect Profiler Plugin for Audacious\n"
+    "Copyright 2026 Audacious developers\n\n"
+    "Shows how long each effect plugin takes to process audio, as histograms "
+    "of processing time, buffer size and real-time factor.  A real-time "
+    "factor of 100% means that processing takes as long as playing.");
+
+const char * const EffectProfiler::defaults[] = {
+    "autosave", "FALSE",
+    nullptr
+};
+
+const PreferencesWidget EffectProfiler::widgets[] = {
+    WidgetCheck (N_("Save report to effect-profile.txt every 10 seconds"),
+        WidgetBool ("effect-profiler", "autosave"))
+};
+
+const PluginPreferences EffectProfiler::prefs = {{widgets}};
+
+static int autosave_ticks;
+
+static void append_histogram (StringBuf & out, const char * title,
+ const EffectHistogram & hist, int divisor, const char * unit)
+{
+    str_append_printf (out, "  %s:\n", title);
+
+    for (int b = 0; b < EffectHistogram::buckets; b ++)
+    {
+        if (! hist.counts[b])
+            continue;
+
+        double low = b ? (double) (1 << (b - 1)) / divisor : 0;
+        double high = (double) (1 << b) / divisor;
+
+        if (b == 0)
+            str_append_printf (out, "    %10s %-4s %12lld\n", "0", unit,
+             (long long) hist.counts[b]);
+        else if (b == EffectHistogram::buckets - 1)
+            str_append_printf (out, "    %10g+%-4s %12lld\n", low, unit,
+             (long long) hist.counts[b]);
+        else
+            str_append_printf (out, "    %4g-%-5g %-4s %12lld\n", low, high,
+             unit, (long long) hist.counts[b]);
+    }
+}
+
+static StringBuf make_report ()
+{
+    Index<EffectStats> list;
+    hook_call ("effect profile collect", & list);
+
+    StringBuf out (0);
+
+    if (! list.len ())
+    {
+        str_append_printf (out, "%s\n", _("No effect plugins are active."));
+        return out;
+    }
+
+    for (const EffectStats & stats : list)
+    {
+        double avg_us = stats.calls ? (double) stats.busy_us / stats.calls : 0;
+        double load = stats.audio_us ? 100.0 * stats.busy_us / stats.audio_us : 0;
+
+        str_append_printf (out, "%s\n", _((const char *) stats.name));
+        str_append_printf (out, _("  %lld calls, average %.1f us, maximum %lld us, "
+         "real-time factor %.2f%%\n"), (long long) stats.calls, avg_us,
+         (long long) stats.max_us, load);
+
+        if (! stats.calls)
+        {
+            str_append_printf (out, "\n");
+            continue;
+        }
+
+        append_histogram (out, _("Processing time"), stats.time, 1, "us");
+        append_histogram (out, _("Buffer size"), stats.frames, 1, _("frames"));
+        append_histogram (out, _("Real-time factor"), stats.load, 10, "%");
+        str_append_printf (out, "\n");
+    }
+
+    return out;
+}
+
+static StringBuf report_path ()
+{
+    return filename_build ({aud_get_path (AudPath::UserDir), "effect-profile.txt"});
+}
+
+static bool save_report ()
+{
+    StringBuf path = report_path ();
+    StringBuf report = make_report ();
+
+    VFSFile file (filename_to_uri (path), "w");
+    if (! file || file.fwrite (report, 1, report.len ()) != report.len ())
+    {
+        AUDERR ("Failed to write %s.\n", (const char *) path);
+        return false;
+    }
+
+    return true;
+}
+
+static void autosave_tick (void *)
+{
+    if (++ autosave_ticks < AUTOSAVE_SECS)
+        return;
+
+    autosave_ticks = 0;
+
+    if (aud_get_bool ("effect-profiler", "autosave"))
+        save_report ();
+}
+
+bool EffectProfiler::init ()
+{
+    aud_config_set_defaults ("effect-profiler", defaults);
+
+    autosave_ticks = 0;
+    timer_add (TimerRate::Hz1, autosave_tick);
+
+    return true;
+}
+
+void EffectProfiler::cleanup ()
+{
+    timer_remove (TimerRate::Hz1, autosave_tick);
+
+    if (aud_get_bool ("effect-profiler", "autosave"))
+        save_report ();
+}
+
+static StringBuf saved_message (bool success)
+{
+    StringBuf path = report_path ();
+    return str_printf (success ? _("Saved to %s.") : _("Failed to write %s."),
+     (const char *) path);
+}
+
+#ifdef USE_GTK
+static GtkWidget * gtk_status;
+
+static void gtk_update (void * textview)
+{
+    GtkTextBuffer * buffer = gtk_text_view_get_buffer ((GtkTextView *) textview);
+    StringBuf report = make_report ();
+
+    GtkTextIter start, end;
+    gtk_text_buffer_set_text (buffer, report, report.len ());
+    gtk_text_buffer_get_bounds (buffer, & start, & end);
+    gtk_text_buffer_apply_tag_by_name (buffer, "mono", & start, & end);
+}
+
+static void gtk_reset (void * textview)
+{
+    hook_call ("effect profile reset", nullptr);
+    gtk_update (textview);
+}
+
+static void gtk_save (void *)
+{
+    gtk_label_set_text ((GtkLabel *) gtk_status, saved_message (save_report ()));
+}
+
+static void gtk_destroy (GtkWidget * textview)
+{
+    timer_remove (TimerRate::Hz1, gtk_update, textview);
+    gtk_status = nullptr;
+}
+
+void * EffectProfiler::get_gtk_widget ()
+{
+    GtkWidget * vbox = audgui_vbox_new (6);
+
+    GtkWidget * textview = gtk_text_view_new ();
+    gtk_text_view_set_editable ((GtkTextView *) textview, false);
+    gtk_text_view_set_cursor_visible ((GtkTextView *) textview, false);
+    gtk_text_buffer_create_tag (gtk_text_view_get_buffer ((GtkTextView *) textview),
+     "mono", "family", "monospace", nullptr);
+
+    GtkWidget * scrolled = gtk_scrolled_window_new (nullptr, nullptr);
+    gtk_scrolled_window_set_shadow_type ((GtkScrolledWindow *) scrolled, GTK_SHADOW_IN);
+    gtk_scrolled_window_set_policy ((GtkScrolledWindow *) scrolled,
+     GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_container_add ((GtkContainer *) scrolled, textview);
+    gtk_box_pack_start ((GtkBox *) vbox, scrolled, true, true, 0);
+
+    GtkWidget * hbox = audgui_hbox_new (6);
+    GtkWidget * reset = audgui_button_new (_("_Reset"), "edit-clear", gtk_reset, textview);
+    GtkWidget * save = audgui_button_new (_("_Save"), "document-save", gtk_save, nullptr);
+    gtk_status = gtk_label_new (nullptr);
+
+    gtk_box_pack_start ((GtkBox *) hbox, reset, false, false, 0);
+    gtk_box_pack_start ((GtkBox *) hbox, save, false, false, 0);
+    gtk_box_pack_start ((GtkBox *) hbox, gtk_status, false, false, 0);
+    gtk_box_pack_start ((GtkBox *) vbox, hbox, false, false, 0);
+
+    gtk_update (textview);
+    timer_add (TimerRate::Hz1, gtk_update, textview);
+    g_signal_connect (textview, "destroy", (GCallback) gtk_destroy, nullptr);
+
+    return vbox;
+}
+#endif
+
+#ifdef USE_QT
+class ProfileWidget : public QWidget
+{
+public:
+    ProfileWidget (QWidget * parent = nullptr);
+    ~ProfileWidget ()
+        { timer_remove (TimerRate::Hz1, update_cb, this); }
+
+private:
+    QPlainTextEdit m_text;
+    QLabel m_status;
+
+    static void update_cb (void * me)
+        { ((ProfileWidget *) me)->refresh (); }
+
+    void refresh ()
+        { m_text.setPlainText ((const char *) make_report ()); }
+};
+
+ProfileWidget::ProfileWidget (QWidget * parent) :
+    QWidget (parent)
+{
+    m_text.setReadOnly (true);
+    m_text.setFont (QFontDatabase::systemFont (QFontDatabase::FixedFont));
+
+    auto reset = new QPushButton (_("Reset"), this);
+    auto save = new QPushButton (_("Save"), this);
+
+    QObject::connect (reset, & QPushButton::clicked, [this] () {
+        hook_call ("effect profile reset", nullptr);
+        refresh ();
+    });
+
+    QObject::connect (save, & QPushButton::clicked, [this] () {
+        m_status.setText ((const char *) saved_message (save_report ()));
+    });
+
+    auto hbox = audqt::make_hbox (nullptr);
+    hbox->addWidget (reset);
+    hbox->addWidget (save);
+    hbox->addWidget (& m_status, 1);
+
+    auto vbox = audqt::make_vbox (this);
+    vbox->addWidget (& m_text, 1);
+    vbox->addLayout (hbox);
+
+    refresh ();
+    timer_add (TimerRate::Hz1, update_cb, this);
+}
+
+void * EffectProfiler::get_qt_widget ()
+{
+    return new ProfileWidget;
+}
+#endif
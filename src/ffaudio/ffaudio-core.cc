@@ -112,12 +112,6 @@ struct ScopedPacket
 #if CHECK_LIBAVCODEC_VERSION(57, 12, 100)
     ScopedPacket () { ptr = av_packet_alloc (); }
     ~ScopedPacket () { av_packet_free (& ptr); }
-
-    void clear ()
-    {
-        av_packet_free (& ptr);
-        ptr = av_packet_alloc ();
-    }
 #else
     ScopedPacket ()
     {
@@ -130,14 +124,11 @@ struct ScopedPacket
         av_packet_unref (ptr);
         delete ptr;
     }
-
-    void clear ()
-    {
-        av_packet_unref (ptr);
-        * ptr = AVPacket ();
-        av_init_packet (ptr);
-    }
 #endif
+
+    /* releases the data but keeps the packet for reuse; an empty packet
+     * flushes the decoder */
+    void clear () { av_packet_unref (ptr); }
 };
 
 struct ScopedFrame
@@ -249,6 +240,179 @@ static int log_result (const char * func, int ret)
 
 #define LOG(function, ...) log_result (#function, function (__VA_ARGS__))
 
+/* Reads the packets of one stream on a separate thread, up to
+ * READ_AHEAD_PACKETS ahead of the decoder, so that a slow VFS transport
+ * (such as neon or gio) stalls the decoder only when the queue runs dry.  The
+ * packets in the queue are allocated once and reused.  Seeking is done on the
+ * read thread as well, since it owns the format context. */
+#define READ_AHEAD_PACKETS 64
+
+class ReadAhead
+{
+public:
+    ReadAhead (AVFormatContext * ic, int stream_idx);
+    ~ReadAhead ();
+
+    /* moves the next packet into pkt; returns 0 or an error code */
+    int read (AVPacket * pkt);
+
+    /* discards the queued packets and seeks to the given time (in
+     * AV_TIME_BASE units); returns the result of av_seek_frame() */
+    int seek (int64_t time);
+
+private:
+    static void * run_cb (void * data)
+        { ((ReadAhead *) data)->run (); return nullptr; }
+
+    void run ();
+
+    struct Slot
+    {
+        ScopedPacket pkt;
+        int result = 0;
+    };
+
+    AVFormatContext * m_ic;
+    int m_stream_idx;
+
+    pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t m_cond = PTHREAD_COND_INITIALIZER;
+    pthread_t m_thread;
+
+    /* all protected by m_mutex; the read thread fills slot
+     * (m_head + m_queued) % READ_AHEAD_PACKETS without holding it */
+    Slot m_slots[READ_AHEAD_PACKETS];
+    int m_head = 0, m_queued = 0;
+    bool m_eof = false, m_stop = false;
+
+    bool m_seek_pending = false;
+    int64_t m_seek_time = 0;
+    int m_seek_result = 0;
+    int m_generation = 0; /* changed by every seek */
+};
+
+ReadAhead::ReadAhead (AVFormatContext * ic, int stream_idx) :
+    m_ic (ic),
+    m_stream_idx (stream_idx)
+{
+    pthread_create (& m_thread, nullptr, run_cb, this);
+}
+
+ReadAhead::~ReadAhead ()
+{
+    pthread_mutex_lock (& m_mutex);
+    m_stop = true;
+    pthread_cond_broadcast (& m_cond);
+    pthread_mutex_unlock (& m_mutex);
+
+    pthread_join (m_thread, nullptr);
+}
+
+void ReadAhead::run ()
+{
+    pthread_mutex_lock (& m_mutex);
+
+    while (! m_stop)
+    {
+        if (m_seek_pending)
+        {
+            for (int i = 0; i < m_queued; i ++)
+                m_slots[(m_head + i) % READ_AHEAD_PACKETS].pkt.clear ();
+
+            m_head = m_queued = 0;
+            m_eof = false;
+
+            pthread_mutex_unlock (& m_mutex);
+            int result = LOG (av_seek_frame, m_ic, -1, m_seek_time, AVSEEK_FLAG_ANY);
+            pthread_mutex_lock (& m_mutex);
+
+            m_seek_result = result;
+            m_seek_pending = false;
+            pthread_cond_broadcast (& m_cond);
+            continue;
+        }
+
+        if (m_eof || m_queued == READ_AHEAD_PACKETS)
+        {
+            pthread_cond_wait (& m_cond, & m_mutex);
+            continue;
+        }
+
+        Slot & slot = m_slots[(m_head + m_queued) % READ_AHEAD_PACKETS];
+        int generation = m_generation;
+
+        pthread_mutex_unlock (& m_mutex);
+
+        int ret;
+        do
+        {
+            slot.pkt.clear ();
+            ret = LOG (av_read_frame, m_ic, slot.pkt.ptr);
+        }
+        /* ignore any other substreams */
+        while (ret >= 0 && slot.pkt->stream_index != m_stream_idx);
+
+        pthread_mutex_lock (& m_mutex);
+
+        /* a packet read from before a seek is dropped */
+        if (generation != m_generation)
+        {
+            slot.pkt.clear ();
+            continue;
+        }
+
+        slot.result = ret;
+        m_queued ++;
+
+        if (ret == (int) AVERROR_EOF)
+            m_eof = true;
+
+        pthread_cond_broadcast (& m_cond);
+    }
+
+    pthread_mutex_unlock (& m_mutex);
+}
+
+int ReadAhead::read (AVPacket * pkt)
+{
+    pthread_mutex_lock (& m_mutex);
+
+    while (! m_queued)
+        pthread_cond_wait (& m_cond, & m_mutex);
+
+    Slot & slot = m_slots[m_head];
+    int result = slot.result;
+
+    av_packet_unref (pkt);
+    av_packet_move_ref (pkt, slot.pkt.ptr);
+
+    m_head = (m_head + 1) % READ_AHEAD_PACKETS;
+    m_queued --;
+
+    pthread_cond_broadcast (& m_cond);
+    pthread_mutex_unlock (& m_mutex);
+
+    return result;
+}
+
+int ReadAhead::seek (int64_t time)
+{
+    pthread_mutex_lock (& m_mutex);
+
+    m_seek_pending = true;
+    m_seek_time = time;
+    m_generation ++;
+    pthread_cond_broadcast (& m_cond);
+
+    while (m_seek_pending)
+        pthread_cond_wait (& m_cond, & m_mutex);
+
+    int result = m_seek_result;
+    pthread_mutex_unlock (& m_mutex);
+
+    return result;
+}
+
 static void create_extension_dict ()
 {
     AVInputFormat * f;
@@ -552,6 +716,10 @@ bool FFaudio::play (const char * filename, VFSFile & file)
     int errcount = 0;
     bool eof = false;
 
+    ReadAhead reader (ic.get (), cinfo.stream_idx);
+    ScopedPacket pkt;
+    ScopedFrame frame;
+
     Index<char> buf;
 
     while (! eof && ! check_stop ())
@@ -560,14 +728,12 @@ bool FFaudio::play (const char * filename, VFSFile & file)
 
         if (seek_value >= 0)
         {
-            if (LOG (av_seek_frame, ic.get (), -1, (int64_t) seek_value *
-             AV_TIME_BASE / 1000, AVSEEK_FLAG_ANY) >= 0)
+            if (reader.seek ((int64_t) seek_value * AV_TIME_BASE / 1000) >= 0)
                 errcount = 0;
         }
 
         /* Read next frame (or more) of data */
-        ScopedPacket pkt;
-        int ret = LOG (av_read_frame, ic.get (), pkt.ptr);
+        int ret = reader.read (pkt.ptr);
 
         if (ret < 0)
         {
@@ -583,14 +749,8 @@ bool FFaudio::play (const char * filename, VFSFile & file)
                 continue;
         }
         else
-        {
             errcount = 0;
 
-            /* Ignore any other substreams */
-            if (pkt->stream_index != cinfo.stream_idx)
-                continue;
-        }
-
         /* Decode and play packet/frame */
 #ifdef SEND_PACKET
         if (LOG (avcodec_send_packet, context.ptr, pkt.ptr) < 0)
@@ -600,10 +760,9 @@ bool FFaudio::play (const char * filename, VFSFile & file)
         AVPacket tmp = * pkt.ptr;
 #endif
 
+        /* the frame is unreferenced by the decoder before being refilled */
         while (! check_stop ())
         {
-            ScopedFrame frame;
-
 #ifdef SEND_PACKET
             if (LOG (avcodec_receive_frame, context.ptr, frame.ptr) < 0)
                 break; /* read next packet (continue past errors) */
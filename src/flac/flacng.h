@@ -64,22 +64,28 @@ struct callback_info
     unsigned sample_rate = 0;
     unsigned channels = 0;
     unsigned long total_samples = 0;
-    Index<int32_t> output_buffer;
-    int32_t *write_pointer = nullptr;
-    unsigned buffer_used = 0;
+    Index<char> output_buffer;  /* packed in SAMPLE_FMT(bits_per_sample) */
+    unsigned buffer_used = 0;   /* in samples */
     VFSFile *fd = nullptr;
     int bitrate = 0;
 
     void alloc()
     {
-        output_buffer.resize(BUFFER_SIZE_SAMP);
+        output_buffer.resize(BUFFER_SIZE_BYTE);
         reset();
     }
 
     void reset()
     {
         buffer_used = 0;
-        write_pointer = output_buffer.begin();
+    }
+
+    /* forgets the stream but keeps the buffer for the next one */
+    void recycle()
+    {
+        Index<char> buffer = std::move(output_buffer);
+        *this = callback_info();
+        output_buffer = std::move(buffer);
     }
 };
 
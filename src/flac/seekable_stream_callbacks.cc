@@ -112,6 +112,35 @@ FLAC__StreamDecoderLengthStatus length_callback(const FLAC__StreamDecoder *decod
     return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
 }
 
+/* Interleaves one block and narrows it to the output sample size in a single
+ * pass.  With the channel count known at compile time, the inner loop unrolls
+ * and the compiler can vectorize the whole block. */
+template<class T, unsigned channels>
+static void pack_block(const FLAC__int32 *const buffer[], size_t frames, T *__restrict out)
+{
+    for (size_t sample = 0; sample < frames; sample++)
+    {
+        for (unsigned channel = 0; channel < channels; channel++)
+            out[sample * channels + channel] = (T) buffer[channel][sample];
+    }
+}
+
+template<class T>
+static void pack_block(const FLAC__int32 *const buffer[], unsigned channels, size_t frames, void *out)
+{
+    switch (channels)
+    {
+        case 1: pack_block<T, 1>(buffer, frames, (T *) out); break;
+        case 2: pack_block<T, 2>(buffer, frames, (T *) out); break;
+        case 3: pack_block<T, 3>(buffer, frames, (T *) out); break;
+        case 4: pack_block<T, 4>(buffer, frames, (T *) out); break;
+        case 5: pack_block<T, 5>(buffer, frames, (T *) out); break;
+        case 6: pack_block<T, 6>(buffer, frames, (T *) out); break;
+        case 7: pack_block<T, 7>(buffer, frames, (T *) out); break;
+        case 8: pack_block<T, 8>(buffer, frames, (T *) out); break;
+    }
+}
+
 FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 *const buffer[], void *client_data)
 {
     callback_info *info = (callback_info*) client_data;
@@ -125,15 +154,24 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder
     if (!info->output_buffer.len())
         info->alloc();
 
-    for (unsigned sample = 0; sample < frame->header.blocksize; sample++)
+    unsigned channels = frame->header.channels;
+    unsigned frames = frame->header.blocksize;
+    unsigned sample_size = SAMPLE_SIZE(info->bits_per_sample);
+
+    if ((info->buffer_used + frames * channels) * sample_size > (unsigned) info->output_buffer.len())
+        return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+
+    void *out = info->output_buffer.begin() + info->buffer_used * sample_size;
+
+    switch (sample_size)
     {
-        for (unsigned channel = 0; channel < frame->header.channels; channel++)
-        {
-            *(info->write_pointer++) = buffer[channel][sample];
-            info->buffer_used += 1;
-        }
+        case 1: pack_block<int8_t>(buffer, channels, frames, out); break;
+        case 2: pack_block<int16_t>(buffer, channels, frames, out); break;
+        case 4: pack_block<int32_t>(buffer, channels, frames, out); break;
     }
 
+    info->buffer_used += frames * channels;
+
     return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
 
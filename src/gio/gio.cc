@@ -27,8 +27,24 @@
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
 #include <libaudcore/interface.h>
+#include <libaudcore/multihash.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/runtime.h>
+#include <libaudcore/threads.h>
+
+/* Read-ahead grows from the smaller to the larger size while the decoder keeps
+ * catching up with it, and shrinks again after seeks outside the buffer. */
+#define MIN_READ_AHEAD 32768
+#define MAX_READ_AHEAD 1048576
+
+/* Data kept before the read position, so that short seeks back are cheap */
+#define KEEP_BEHIND 65536
+
+/* Directory entries are enumerated this many at a time, and their attributes
+ * are kept for a few seconds to answer test_file() without a round trip. */
+#define FOLDER_BATCH 256
+#define INFO_CACHE_TIME (5 * G_TIME_SPAN_SECOND)
+#define INFO_CACHE_MAX 65536
 
 static const char gio_about[] =
  N_("GIO Plugin for Audacious\n"
@@ -82,6 +98,34 @@ private:
     GOutputStream * m_ostream = nullptr;
     GSeekable * m_seekable = nullptr;
     bool m_eof = false;
+
+    /* Read-ahead, used when the file is open for reading only.  The next block
+     * is requested with g_input_stream_read_async() as soon as a read has been
+     * served, and arrives in m_buf while the decoder works on the previous one.
+     * Completion is dispatched through a private main context, which fread()
+     * iterates when it has to wait. */
+    bool m_buffered = false;
+    Index<char> m_buf;
+    int m_buf_pos = 0;          /* read position in m_buf */
+    int m_buf_len = 0;          /* bytes of m_buf that hold data */
+    int64_t m_buf_offset = 0;   /* stream offset of m_buf[0] */
+    int m_block = MIN_READ_AHEAD;
+    bool m_stream_eof = false;
+
+    GMainContext * m_context = nullptr;
+    GCancellable * m_cancel = nullptr;
+    bool m_pending = false;     /* an asynchronous read into m_buf is running */
+    int m_pending_len = 0;
+    int64_t m_pending_result = 0;
+    GError * m_pending_error = nullptr;
+
+    int64_t buffered_read (char * buf, int64_t len);
+    int buffered_seek (int64_t offset, VFSSeekType whence);
+    void start_read_ahead ();
+    bool wait_read_ahead ();
+    void drop_read_ahead ();
+
+    static void read_done (GObject * stream, GAsyncResult * result, void * data);
 };
 
 #define CHECK_ERROR(op, name) do { \
@@ -101,6 +145,63 @@ private:
     } \
 } while (0)
 
+/* Attributes of recently enumerated files, as VFSFileTest flags */
+struct CachedInfo
+{
+    int passed;
+    int64_t time;
+};
+
+static aud::mutex info_mutex;
+static SimpleHash<String, CachedInfo> info_cache;
+
+static int test_info (GFileInfo * info)
+{
+    int passed = VFS_EXISTS;
+
+    switch (g_file_info_get_file_type (info))
+    {
+        case G_FILE_TYPE_REGULAR: passed |= VFS_IS_REGULAR; break;
+        case G_FILE_TYPE_DIRECTORY: passed |= VFS_IS_DIR; break;
+        default: break;
+    };
+
+    if (g_file_info_get_is_symlink (info))
+        passed |= VFS_IS_SYMLINK;
+    if (g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_MODE) & S_IXUSR)
+        passed |= VFS_IS_EXECUTABLE;
+
+    return passed;
+}
+
+static void cache_info (const String & filename, int passed)
+{
+    auto lock = info_mutex.take ();
+
+    if (info_cache.n_items () >= INFO_CACHE_MAX)
+        info_cache.clear ();
+
+    info_cache.add (filename, {passed, g_get_monotonic_time ()});
+}
+
+static bool lookup_info (const char * filename, int & passed)
+{
+    auto lock = info_mutex.take ();
+
+    const CachedInfo * cached = info_cache.lookup (String (filename));
+    if (! cached || g_get_monotonic_time () - cached->time > INFO_CACHE_TIME)
+        return false;
+
+    passed = cached->passed;
+    return true;
+}
+
+static void forget_info (const char * filename)
+{
+    auto lock = info_mutex.take ();
+    info_cache.remove (String (filename));
+}
+
 GIOFile::GIOFile (const char * filename, const char * mode) :
     m_filename (filename)
 {
@@ -109,6 +210,9 @@ GIOFile::GIOFile (const char * filename, const char * mode) :
 
     m_file = g_file_new_for_uri (filename);
 
+    if (mode[0] != 'r' || strchr (mode, '+'))
+        forget_info (filename);
+
     switch (mode[0])
     {
     case 'r':
@@ -125,6 +229,10 @@ GIOFile::GIOFile (const char * filename, const char * mode) :
             m_istream = (GInputStream *) g_file_read (m_file, 0, & error);
             CHECK_AND_SAVE_ERROR ("open", filename);
             m_seekable = (GSeekable *) m_istream;
+
+            m_buffered = true;
+            m_context = g_main_context_new ();
+            m_cancel = g_cancellable_new ();
         }
         break;
     case 'w':
@@ -177,6 +285,13 @@ GIOFile::~GIOFile ()
 {
     GError * error = nullptr;
 
+    if (m_buffered)
+    {
+        drop_read_ahead ();
+        g_object_unref (m_cancel);
+        g_main_context_unref (m_context);
+    }
+
     if (m_iostream)
     {
         g_io_stream_close (m_iostream, 0, & error);
@@ -212,6 +327,203 @@ VFSImpl * GIOTransport::fopen (const char * filename, const char * mode, String
     }
 }
 
+void GIOFile::read_done (GObject * stream, GAsyncResult * result, void * data)
+{
+    auto file = (GIOFile *) data;
+
+    file->m_pending_result = g_input_stream_read_finish ((GInputStream *) stream,
+     result, & file->m_pending_error);
+    file->m_pending = false;
+}
+
+void GIOFile::start_read_ahead ()
+{
+    /* make room at the end of the buffer, keeping a little data behind the
+     * read position */
+    if (m_buf.len () - m_buf_len < m_block)
+    {
+        int keep = aud::min (m_buf_pos, KEEP_BEHIND);
+        int drop = m_buf_pos - keep;
+
+        if (drop > 0)
+        {
+            memmove (m_buf.begin (), & m_buf[drop], m_buf_len - drop);
+            m_buf_offset += drop;
+            m_buf_pos -= drop;
+            m_buf_len -= drop;
+        }
+
+        if (m_buf.len () < m_buf_len + m_block)
+            m_buf.resize (m_buf_len + m_block);
+    }
+
+    m_pending = true;
+    m_pending_len = m_block;
+
+    g_main_context_push_thread_default (m_context);
+    g_input_stream_read_async (m_istream, & m_buf[m_buf_len], m_block,
+     G_PRIORITY_DEFAULT, m_cancel, read_done, this);
+    g_main_context_pop_thread_default (m_context);
+}
+
+bool GIOFile::wait_read_ahead ()
+{
+    while (m_pending)
+        g_main_context_iteration (m_context, true);
+
+    GError * error = m_pending_error;
+    m_pending_error = nullptr;
+    CHECK_ERROR ("read from", m_filename);
+
+    if (! m_pending_result)
+        m_stream_eof = true;
+
+    m_buf_len += m_pending_result;
+    return true;
+
+FAILED:
+    return false;
+}
+
+/* Cancels the read in progress and empties the buffer.  The stream position
+ * is undefined afterwards, so the caller must seek to an absolute position. */
+void GIOFile::drop_read_ahead ()
+{
+    if (m_pending)
+    {
+        g_cancellable_cancel (m_cancel);
+
+        while (m_pending)
+            g_main_context_iteration (m_context, true);
+
+        g_cancellable_reset (m_cancel);
+
+        if (m_pending_error)
+            g_clear_error (& m_pending_error);
+    }
+
+    m_buf_offset += m_buf_pos;
+    m_buf_pos = m_buf_len = 0;
+    m_stream_eof = false;
+}
+
+int64_t GIOFile::buffered_read (char * buf, int64_t len)
+{
+    GError * error = nullptr;
+    int64_t total = 0;
+
+    while (total < len)
+    {
+        int avail = m_buf_len - m_buf_pos;
+
+        if (avail > 0)
+        {
+            int copy = aud::min ((int64_t) avail, len - total);
+            memcpy (buf + total, & m_buf[m_buf_pos], copy);
+
+            m_buf_pos += copy;
+            total += copy;
+            continue;
+        }
+
+        if (m_pending)
+        {
+            /* the decoder caught up with the read-ahead; request more at once
+             * next time */
+            m_block = aud::min (m_block * 2, MAX_READ_AHEAD);
+
+            if (! wait_read_ahead ())
+                break;
+
+            continue;
+        }
+
+        if (m_stream_eof)
+            break;
+
+        /* a read larger than the read-ahead goes straight to the caller */
+        if (len - total >= m_block)
+        {
+            m_buf_offset += m_buf_len;
+            m_buf_pos = m_buf_len = 0;
+
+            int64_t part = g_input_stream_read (m_istream, buf + total, len - total, 0, & error);
+            CHECK_ERROR ("read from", m_filename);
+
+            if (! part)
+                m_stream_eof = true;
+
+            m_buf_offset += part;
+            total += part;
+            continue;
+        }
+
+        start_read_ahead ();
+    }
+
+FAILED:
+    if (! m_pending && ! m_stream_eof)
+        start_read_ahead ();
+
+    return total;
+}
+
+int GIOFile::buffered_seek (int64_t offset, VFSSeekType whence)
+{
+    GError * error = nullptr;
+    int64_t target = offset;
+    bool from_end = false;
+
+    switch (whence)
+    {
+    case VFS_SEEK_SET:
+        break;
+    case VFS_SEEK_CUR:
+        target += m_buf_offset + m_buf_pos;
+        break;
+    case VFS_SEEK_END:
+        from_end = true;
+        break;
+    default:
+        AUDERR ("Cannot seek within %s: invalid whence.\n", (const char *) m_filename);
+        return -1;
+    }
+
+    if (! from_end)
+    {
+        /* a target just beyond the buffer may be covered by the pending read */
+        if (m_pending && target > m_buf_offset + m_buf_len &&
+         target <= m_buf_offset + m_buf_len + m_pending_len)
+            wait_read_ahead ();
+
+        if (target >= m_buf_offset && target <= m_buf_offset + m_buf_len)
+        {
+            m_buf_pos = target - m_buf_offset;
+            m_eof = false;
+            return 0;
+        }
+    }
+
+    /* the read-ahead was wasted, so be more careful with it for a while */
+    drop_read_ahead ();
+    m_block = aud::max (m_block / 2, MIN_READ_AHEAD);
+
+    if (from_end)
+        g_seekable_seek (m_seekable, offset, G_SEEK_END, nullptr, & error);
+    else
+        g_seekable_seek (m_seekable, target, G_SEEK_SET, nullptr, & error);
+
+    m_buf_offset = g_seekable_tell (m_seekable);
+    CHECK_ERROR ("seek within", m_filename);
+
+    m_eof = (whence == VFS_SEEK_END && offset == 0);
+
+    return 0;
+
+FAILED:
+    return -1;
+}
+
 int64_t GIOFile::fread (void * buf, int64_t size, int64_t nitems)
 {
     GError * error = nullptr;
@@ -222,6 +534,14 @@ int64_t GIOFile::fread (void * buf, int64_t size, int64_t nitems)
         return 0;
     }
 
+    if (m_buffered)
+    {
+        int64_t len = size * nitems;
+        int64_t total = buffered_read ((char *) buf, len);
+        m_eof = (total < len && m_stream_eof);
+        return (size > 0) ? total / size : 0;
+    }
+
     int64_t total = 0;
     int64_t remain = size * nitems;
 
@@ -276,6 +596,9 @@ FAILED:
 
 int GIOFile::fseek (int64_t offset, VFSSeekType whence)
 {
+    if (m_buffered)
+        return buffered_seek (offset, whence);
+
     GError * error = nullptr;
     GSeekType gwhence;
 
@@ -308,6 +631,9 @@ FAILED:
 
 int64_t GIOFile::ftell ()
 {
+    if (m_buffered)
+        return m_buf_offset + m_buf_pos;
+
     return g_seekable_tell (m_seekable);
 }
 
@@ -336,6 +662,10 @@ int64_t GIOFile::fsize ()
     if (! g_seekable_can_seek (m_seekable))
         return -1;
 
+    /* no other operation is allowed while a read is pending */
+    if (m_pending)
+        wait_read_ahead ();
+
     GError * error = nullptr;
     int64_t saved_pos = g_seekable_tell (m_seekable);
     int64_t size = -1;
@@ -348,7 +678,7 @@ int64_t GIOFile::fsize ()
     g_seekable_seek (m_seekable, saved_pos, G_SEEK_SET, nullptr, & error);
     CHECK_ERROR ("seek within", m_filename);
 
-    m_eof = (saved_pos >= size);
+    m_eof = (ftell () >= size);
 
 FAILED:
     return size;
@@ -372,9 +702,13 @@ FAILED:
 
 VFSFileTest GIOTransport::test_file (const char * filename, VFSFileTest test, String & error)
 {
+    int passed = 0;
+
+    if (lookup_info (filename, passed))
+        return VFSFileTest (test & passed);
+
     GFile * file = g_file_new_for_uri (filename);
     Index<String> attrs;
-    int passed = 0;
 
     if (test & (VFS_IS_REGULAR | VFS_IS_DIR))
         attrs.append (G_FILE_ATTRIBUTE_STANDARD_TYPE);
@@ -395,20 +729,7 @@ VFSFileTest GIOTransport::test_file (const char * filename, VFSFileTest test, St
     }
     else
     {
-        passed |= VFS_EXISTS;
-
-        switch (g_file_info_get_file_type (info))
-        {
-            case G_FILE_TYPE_REGULAR: passed |= VFS_IS_REGULAR; break;
-            case G_FILE_TYPE_DIRECTORY: passed |= VFS_IS_DIR; break;
-            default: break;
-        };
-
-        if (g_file_info_get_is_symlink (info))
-            passed |= VFS_IS_SYMLINK;
-        if (g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_MODE) & S_IXUSR)
-            passed |= VFS_IS_EXECUTABLE;
-
+        passed |= test_info (info);
         g_object_unref (info);
     }
 
@@ -416,6 +737,25 @@ VFSFileTest GIOTransport::test_file (const char * filename, VFSFileTest test, St
     return VFSFileTest (test & passed);
 }
 
+struct FolderBatch
+{
+    GList * infos = nullptr;
+    GError * error = nullptr;
+    bool done = false;
+};
+
+static void next_files_done (GObject * dir, GAsyncResult * result, void * data)
+{
+    auto batch = (FolderBatch *) data;
+
+    batch->infos = g_file_enumerator_next_files_finish ((GFileEnumerator *) dir,
+     result, & batch->error);
+    batch->done = true;
+}
+
+/* Entries are fetched in batches, together with the attributes that
+ * test_file() needs.  Callers typically test every entry right after listing
+ * the folder, and on remote mounts each separate query is a round trip. */
 Index<String> GIOTransport::read_folder (const char * filename, String & error)
 {
     GFile * file = g_file_new_for_uri (filename);
@@ -423,8 +763,9 @@ Index<String> GIOTransport::read_folder (const char * filename, String & error)
 
     GError * gerr = nullptr;
     GFileEnumerator * dir = g_file_enumerate_children (file,
-     G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN,
-     G_FILE_QUERY_INFO_NONE, nullptr, & gerr);
+     G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
+     G_FILE_ATTRIBUTE_STANDARD_TYPE "," G_FILE_ATTRIBUTE_STANDARD_IS_SYMLINK ","
+     G_FILE_ATTRIBUTE_UNIX_MODE, G_FILE_QUERY_INFO_NONE, nullptr, & gerr);
 
     if (! dir)
     {
@@ -433,16 +774,50 @@ Index<String> GIOTransport::read_folder (const char * filename, String & error)
     }
     else
     {
-        GFileInfo * info;
-        while ((info = g_file_enumerator_next_file (dir, nullptr, nullptr)))
+        GMainContext * context = g_main_context_new ();
+        g_main_context_push_thread_default (context);
+
+        while (true)
         {
-            if (g_file_info_get_is_hidden (info))
-                continue;
-            StringBuf enc = str_encode_percent (g_file_info_get_name (info));
-            files.append (String (str_concat ({filename, "/", enc})));
-            g_object_unref (info);
+            FolderBatch batch;
+            g_file_enumerator_next_files_async (dir, FOLDER_BATCH,
+             G_PRIORITY_DEFAULT, nullptr, next_files_done, & batch);
+
+            while (! batch.done)
+                g_main_context_iteration (context, true);
+
+            if (batch.error)
+            {
+                AUDERR ("Cannot read folder %s: %s.\n", filename, batch.error->message);
+                g_error_free (batch.error);
+                break;
+            }
+
+            if (! batch.infos)
+                break;
+
+            for (GList * node = batch.infos; node; node = node->next)
+            {
+                auto info = (GFileInfo *) node->data;
+
+                if (! g_file_info_get_is_hidden (info))
+                {
+                    StringBuf enc = str_encode_percent (g_file_info_get_name (info));
+                    String child (str_concat ({filename, "/", enc}));
+
+                    cache_info (child, test_info (info));
+                    files.append (std::move (child));
+                }
+
+                g_object_unref (info);
+            }
+
+            g_list_free (batch.infos);
         }
 
+        g_main_context_pop_thread_default (context);
+        g_main_context_unref (context);
+
         g_object_unref (dir);
     }
 
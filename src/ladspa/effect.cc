@@ -18,14 +18,134 @@
  */
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "ladspa.h"
 #include "plugin.h"
 
 #include <libaudcore/runtime.h>
 
+#include "../effect-common/profile.h"
+
+#define MAX_WORKERS 3
+
 static int ladspa_channels, ladspa_rate;
 
+static EffectProfile profile (N_("LADSPA Host"));
+
+/* Audio is kept planar (one buffer per channel) across the whole chain.  It is
+ * deinterleaved once before the first plugin and interleaved once after the
+ * last; every plugin reads and, unless it is marked INPLACE_BROKEN, writes
+ * these buffers directly. */
+static Index<Index<float>> chain_bufs;
+
+/* Worker threads for running the independent instances of a plugin (one per
+ * group of channels) side by side.  The audio thread hands out a job, runs its
+ * own share of the instances, and waits for the workers to finish theirs. */
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static pthread_t pool_threads[MAX_WORKERS];
+static int pool_size;
+static int pool_generation, pool_pending;
+static bool pool_quit;
+static LoadedPlugin * pool_job;
+static int pool_frames;
+
+static void run_instances (LoadedPlugin & loaded, int frames, int first, int step)
+{
+    const LADSPA_Descriptor & desc = loaded.plugin.desc;
+    int instances = loaded.instances.len ();
+
+    for (int i = first; i < instances; i += step)
+        desc.run (loaded.instances[i], frames);
+}
+
+static void * pool_worker (void * arg)
+{
+    int id = (int) (intptr_t) arg;
+
+    pthread_mutex_lock (& pool_mutex);
+    int seen = pool_generation;
+
+    while (1)
+    {
+        while (! pool_quit && pool_generation == seen)
+            pthread_cond_wait (& pool_wake, & pool_mutex);
+
+        if (pool_quit)
+            break;
+
+        seen = pool_generation;
+        LoadedPlugin * loaded = pool_job;
+        int frames = pool_frames;
+
+        pthread_mutex_unlock (& pool_mutex);
+        run_instances (* loaded, frames, id, pool_size + 1);
+        pthread_mutex_lock (& pool_mutex);
+
+        if (! (-- pool_pending))
+            pthread_cond_signal (& pool_done);
+    }
+
+    pthread_mutex_unlock (& pool_mutex);
+    return nullptr;
+}
+
+void stop_workers ()
+{
+    if (! pool_size)
+        return;
+
+    pthread_mutex_lock (& pool_mutex);
+    pool_quit = true;
+    pthread_cond_broadcast (& pool_wake);
+    pthread_mutex_unlock (& pool_mutex);
+
+    for (int i = 0; i < pool_size; i ++)
+        pthread_join (pool_threads[i], nullptr);
+
+    pool_size = 0;
+    pool_quit = false;
+}
+
+static void start_workers (int count)
+{
+    if (count == pool_size)
+        return;
+
+    stop_workers ();
+    pool_size = count;
+
+    for (int i = 0; i < count; i ++)
+        pthread_create (& pool_threads[i], nullptr, pool_worker, (void *) (intptr_t) (i + 1));
+}
+
+static void run_parallel (LoadedPlugin & loaded, int frames)
+{
+    if (! pool_size || loaded.instances.len () < 2)
+    {
+        run_instances (loaded, frames, 0, 1);
+        return;
+    }
+
+    pthread_mutex_lock (& pool_mutex);
+    pool_job = & loaded;
+    pool_frames = frames;
+    pool_pending = pool_size;
+    pool_generation ++;
+    pthread_cond_broadcast (& pool_wake);
+    pthread_mutex_unlock (& pool_mutex);
+
+    run_instances (loaded, frames, 0, pool_size + 1);
+
+    pthread_mutex_lock (& pool_mutex);
+    while (pool_pending)
+        pthread_cond_wait (& pool_done, & pool_mutex);
+    pthread_mutex_unlock (& pool_mutex);
+}
+
 static void start_plugin (LoadedPlugin & loaded)
 {
     if (loaded.active)
@@ -52,9 +172,10 @@ static void start_plugin (LoadedPlugin & loaded)
     }
 
     int instances = ladspa_channels / ports;
+    bool in_place = ! LADSPA_IS_INPLACE_BROKEN (desc.Properties);
 
-    loaded.in_bufs.insert (0, ladspa_channels);
-    loaded.out_bufs.insert (0, ladspa_channels);
+    if (! in_place)
+        loaded.out_bufs.insert (0, ladspa_channels);
 
     for (int i = 0; i < instances; i ++)
     {
@@ -69,13 +190,17 @@ static void start_plugin (LoadedPlugin & loaded)
         {
             int channel = ports * i + p;
 
-            Index<float> & in = loaded.in_bufs[channel];
-            in.insert (0, LADSPA_BUFLEN);
-            desc.connect_port (handle, plugin.in_ports[p], in.begin ());
+            float * buf = chain_bufs[channel].begin ();
+            desc.connect_port (handle, plugin.in_ports[p], buf);
 
-            Index<float> & out = loaded.out_bufs[channel];
-            out.insert (0, LADSPA_BUFLEN);
-            desc.connect_port (handle, plugin.out_ports[p], out.begin ());
+            if (! in_place)
+            {
+                Index<float> & out = loaded.out_bufs[channel];
+                out.insert (0, LADSPA_BUFLEN);
+                buf = out.begin ();
+            }
+
+            desc.connect_port (handle, plugin.out_ports[p], buf);
         }
 
         if (desc.activate)
@@ -83,57 +208,95 @@ static void start_plugin (LoadedPlugin & loaded)
     }
 }
 
-static void run_plugin (LoadedPlugin & loaded, float * data, int samples)
+static void run_plugin (LoadedPlugin & loaded, int frames)
 {
     if (! loaded.instances.len ())
         return;
 
-    PluginData & plugin = loaded.plugin;
-    const LADSPA_Descriptor & desc = plugin.desc;
+    assert (loaded.plugin.in_ports.len () * loaded.instances.len () == ladspa_channels);
 
-    int ports = plugin.in_ports.len ();
-    int instances = loaded.instances.len ();
-    assert (ports * instances == ladspa_channels);
+    run_parallel (loaded, frames);
 
-    while (samples / ladspa_channels > 0)
+    /* plugins that cannot work in place wrote to their own buffers */
+    for (int c = 0; c < loaded.out_bufs.len (); c ++)
+        memcpy (chain_bufs[c].begin (), loaded.out_bufs[c].begin (), sizeof (float) * frames);
+}
+
+static void deinterleave (const float * data, int frames)
+{
+    if (ladspa_channels == 2)
     {
-        int frames = aud::min (samples / ladspa_channels, LADSPA_BUFLEN);
+        float * left = chain_bufs[0].begin ();
+        float * right = chain_bufs[1].begin ();
 
-        for (int i = 0; i < instances; i ++)
+        for (int f = 0; f < frames; f ++)
         {
-            LADSPA_Handle handle = loaded.instances[i];
+            left[f] = data[2 * f];
+            right[f] = data[2 * f + 1];
+        }
 
-            for (int p = 0; p < ports; p ++)
-            {
-                int channel = ports * i + p;
-                float * get = data + channel;
-                float * in = loaded.in_bufs[channel].begin ();
-                float * in_end = in + frames;
-
-                while (in < in_end)
-                {
-                    * in ++ = * get;
-                    get += ladspa_channels;
-                }
-            }
+        return;
+    }
 
-            desc.run (handle, frames);
+    for (int c = 0; c < ladspa_channels; c ++)
+    {
+        float * buf = chain_bufs[c].begin ();
 
-            for (int p = 0; p < ports; p ++)
-            {
-                int channel = ports * i + p;
-                float * set = data + channel;
-                float * out = loaded.out_bufs[channel].begin ();
-                float * out_end = out + frames;
-
-                while (out < out_end)
-                {
-                    * set = * out ++;
-                    set += ladspa_channels;
-                }
-            }
+        for (int f = 0; f < frames; f ++)
+            buf[f] = data[ladspa_channels * f + c];
+    }
+}
+
+static void interleave (float * data, int frames)
+{
+    if (ladspa_channels == 2)
+    {
+        const float * left = chain_bufs[0].begin ();
+        const float * right = chain_bufs[1].begin ();
+
+        for (int f = 0; f < frames; f ++)
+        {
+            data[2 * f] = left[f];
+            data[2 * f + 1] = right[f];
         }
 
+        return;
+    }
+
+    for (int c = 0; c < ladspa_channels; c ++)
+    {
+        const float * buf = chain_bufs[c].begin ();
+
+        for (int f = 0; f < frames; f ++)
+            data[ladspa_channels * f + c] = buf[f];
+    }
+}
+
+static void run_chain (float * data, int samples)
+{
+    bool any = false;
+
+    for (auto & loaded : loadeds)
+    {
+        start_plugin (* loaded);
+        if (loaded->instances.len ())
+            any = true;
+    }
+
+    if (! any)
+        return;
+
+    while (samples / ladspa_channels > 0)
+    {
+        int frames = aud::min (samples / ladspa_channels, LADSPA_BUFLEN);
+
+        deinterleave (data, frames);
+
+        for (auto & loaded : loadeds)
+            run_plugin (* loaded, frames);
+
+        interleave (data, frames);
+
         data += ladspa_channels * frames;
         samples -= ladspa_channels * frames;
     }
@@ -181,12 +344,13 @@ void shutdown_plugin_locked (LoadedPlugin & loaded)
     }
 
     loaded.instances.clear ();
-    loaded.in_bufs.clear ();
     loaded.out_bufs.clear ();
 }
 
 void LADSPAHost::start (int & channels, int & rate)
 {
+    profile.start (channels, rate);
+
     pthread_mutex_lock (& mutex);
 
     for (auto & loaded : loadeds)
@@ -195,19 +359,25 @@ void LADSPAHost::start (int & channels, int & rate)
     ladspa_channels = channels;
     ladspa_rate = rate;
 
+    chain_bufs.clear ();
+    chain_bufs.insert (0, channels);
+    for (auto & buf : chain_bufs)
+        buf.insert (0, LADSPA_BUFLEN);
+
+    if (aud_get_bool ("ladspa", "parallel"))
+        start_workers (aud::min (channels, MAX_WORKERS + 1) - 1);
+    else
+        stop_workers ();
+
     pthread_mutex_unlock (& mutex);
 }
 
 Index<float> & LADSPAHost::process (Index<float> & data)
 {
-    pthread_mutex_lock (& mutex);
-
-    for (auto & loaded : loadeds)
-    {
-        start_plugin (* loaded);
-        run_plugin (* loaded, data.begin (), data.len ());
-    }
+    EffectProfile::Timer timer (profile, data);
 
+    pthread_mutex_lock (& mutex);
+    run_chain (data.begin (), data.len ());
     pthread_mutex_unlock (& mutex);
     return data;
 }
@@ -225,14 +395,15 @@ bool LADSPAHost::flush (bool force)
 
 Index<float> & LADSPAHost::finish (Index<float> & data, bool end_of_playlist)
 {
+    EffectProfile::Timer timer (profile, data);
+
     pthread_mutex_lock (& mutex);
 
-    for (auto & loaded : loadeds)
-    {
-        start_plugin (* loaded);
-        run_plugin (* loaded, data.begin (), data.len ());
+    run_chain (data.begin (), data.len ());
 
-        if (end_of_playlist)
+    if (end_of_playlist)
+    {
+        for (auto & loaded : loadeds)
             shutdown_plugin_locked (* loaded);
     }
 
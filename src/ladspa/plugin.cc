@@ -37,6 +37,7 @@
 
 const char * const LADSPAHost::defaults[] = {
  "plugin_count", "0",
+ "parallel", "FALSE",
  nullptr};
 
 pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -321,6 +322,7 @@ void LADSPAHost::cleanup ()
 
     aud_set_str ("ladspa", "module_path", module_path);
     save_enabled_to_config ();
+    stop_workers ();
     close_modules ();
 
     modules.clear ();
@@ -561,7 +563,9 @@ const char LADSPAHost::about[] =
     "Copyright 2011 John Lindgren");
 
 const PreferencesWidget LADSPAHost::widgets[] = {
-    WidgetCustomGTK (make_config_widget)
+    WidgetCustomGTK (make_config_widget),
+    WidgetCheck (N_("Run instances for different channels in parallel"),
+        WidgetBool ("ladspa", "parallel"))
 };
 
 const PluginPreferences LADSPAHost::prefs = {{widgets}};
@@ -31,6 +31,8 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/profile.h"
+
 class ChannelMixer : public EffectPlugin
 {
 public:
@@ -58,6 +60,8 @@ public:
 
 EXPORT ChannelMixer aud_plugin_instance;
 
+static EffectProfile profile (N_("Channel Mixer"));
+
 typedef Index<float> & (* Converter) (Index<float> & data);
 
 static Index<float> mixer_buf;
@@ -208,6 +212,8 @@ static int input_channels, output_channels;
 
 void ChannelMixer::start (int & channels, int & rate)
 {
+    profile.start (channels, rate);
+
     input_channels = channels;
     output_channels = aud_get_int ("mixer", "channels");
 
@@ -226,6 +232,8 @@ void ChannelMixer::start (int & channels, int & rate)
 
 Index<float> & ChannelMixer::process (Index<float> & data)
 {
+    EffectProfile::Timer timer (profile, data);
+
     if (input_channels == output_channels)
         return data;
 
@@ -0,0 +1,400 @@
+/*
+ *  Block cache for the neon HTTP transport
+ *  Copyright 2026 Audacious developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#define __STDC_FORMAT_MACROS
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/runtime.h>
+
+#include <ne_request.h>
+#include <ne_session.h>
+
+#include "block-cache.h"
+#include "neon.h"
+
+#ifdef _WIN32
+#define fseeko _fseeki64
+#endif
+
+/* number of unused caches kept around */
+#define IDLE_CACHES 2
+
+static pthread_mutex_t caches_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Index<BlockCache *> caches;  /* least recently used first */
+
+BlockCache * BlockCache::acquire (const char * url, const ne_uri & uri, int64_t length)
+{
+    pthread_mutex_lock (& caches_mutex);
+
+    BlockCache * cache = nullptr;
+
+    for (int i = 0; i < caches.len (); i ++)
+    {
+        if (! strcmp (caches[i]->m_url, url) && caches[i]->m_length == length)
+        {
+            cache = caches[i];
+            caches.remove (i, 1);
+            break;
+        }
+    }
+
+    if (! cache)
+        cache = new BlockCache (url, uri, length);
+
+    caches.append (cache);
+    cache->m_refs ++;
+
+    pthread_mutex_unlock (& caches_mutex);
+    return cache;
+}
+
+void BlockCache::release (BlockCache * cache)
+{
+    Index<BlockCache *> expired;
+
+    pthread_mutex_lock (& caches_mutex);
+
+    if (! -- cache->m_refs)
+    {
+        /* nobody is going to read the prefetched blocks any time soon */
+        pthread_mutex_lock (& cache->m_mutex);
+
+        for (int block : cache->m_queue)
+            cache->m_blocks[block].state = BLOCK_MISSING;
+
+        cache->m_queue.clear ();
+        pthread_mutex_unlock (& cache->m_mutex);
+    }
+
+    int idle = 0;
+    for (int i = caches.len (); i --; )
+    {
+        if (caches[i]->m_refs)
+            continue;
+
+        if (++ idle > IDLE_CACHES)
+        {
+            expired.append (caches[i]);
+            caches.remove (i, 1);
+        }
+    }
+
+    pthread_mutex_unlock (& caches_mutex);
+
+    /* joining the workers may wait for a request in progress */
+    for (BlockCache * old : expired)
+        delete old;
+}
+
+void BlockCache::cleanup ()
+{
+    pthread_mutex_lock (& caches_mutex);
+
+    for (BlockCache * cache : caches)
+    {
+        if (cache->m_refs)
+            AUDERR ("Block cache for %s still in use\n", (const char *) cache->m_url);
+        else
+            delete cache;
+    }
+
+    caches.clear ();
+    pthread_mutex_unlock (& caches_mutex);
+}
+
+BlockCache::BlockCache (const char * url, const ne_uri & uri, int64_t length) :
+    m_url (url),
+    m_length (length)
+{
+    ne_uri_copy (& m_uri, & uri);
+
+    m_blocks.insert (0, (length + block_size - 1) / block_size);
+
+    m_max_memory = (int64_t) aud::clamp (aud_get_int ("neon", "cache_mb"), 1, 1024) << 20;
+    m_prefetch = aud::clamp (aud_get_int ("neon", "prefetch_blocks"), 0, 64);
+    m_max_workers = aud::clamp (aud_get_int ("neon", "prefetch_threads"), 1, max_workers);
+    m_use_spill = aud_get_bool ("neon", "spill");
+
+    AUDDBG ("Block cache for %s: %d blocks\n", url, m_blocks.len ());
+}
+
+BlockCache::~BlockCache ()
+{
+    pthread_mutex_lock (& m_mutex);
+    m_quit = true;
+    pthread_cond_broadcast (& m_cond);
+    pthread_mutex_unlock (& m_mutex);
+
+    for (int i = 0; i < m_n_workers; i ++)
+        pthread_join (m_workers[i], nullptr);
+
+    if (m_spill)
+        fclose (m_spill);
+
+    ne_uri_free (& m_uri);
+}
+
+int BlockCache::block_len (int block) const
+{
+    return aud::min ((int64_t) block_size, m_length - (int64_t) block * block_size);
+}
+
+/* Queues a block for fetching.  Urgent requests go ahead of prefetches, and
+ * a block that was already queued is moved up if it becomes urgent. */
+void BlockCache::request (int block, bool urgent)
+{
+    Block & b = m_blocks[block];
+
+    if (b.state == BLOCK_PENDING && urgent)
+    {
+        for (int i = 0; i < m_queue.len (); i ++)
+        {
+            if (m_queue[i] == block)
+            {
+                m_queue.remove (i, 1);
+                m_queue.insert (& block, 0, 1);
+                break;
+            }
+        }
+    }
+    else if (b.state == BLOCK_MISSING || b.state == BLOCK_FAILED)
+    {
+        b.state = BLOCK_PENDING;
+        m_queue.insert (& block, urgent ? 0 : -1, 1);
+        pthread_cond_signal (& m_cond);
+    }
+}
+
+/* Brings a spilled block back into memory. */
+bool BlockCache::load (int block)
+{
+    Block & b = m_blocks[block];
+    int len = block_len (block);
+
+    b.data.insert (0, len);
+
+    if (fseeko (m_spill, (int64_t) block * block_size, SEEK_SET) < 0 ||
+     fread (b.data.begin (), 1, len, m_spill) != (size_t) len)
+    {
+        AUDERR ("Failed to read from block cache spill file: %s\n", strerror (errno));
+        b.data.clear ();
+        b.state = BLOCK_MISSING;
+        return false;
+    }
+
+    b.state = BLOCK_MEMORY;
+    m_memory += len;
+    trim_memory (block);
+    return true;
+}
+
+/* Moves the least recently used blocks out of memory until the limit is met. */
+void BlockCache::trim_memory (int keep)
+{
+    while (m_memory > m_max_memory)
+    {
+        int oldest = -1;
+
+        for (int i = 0; i < m_blocks.len (); i ++)
+        {
+            if (i != keep && m_blocks[i].state == BLOCK_MEMORY &&
+             (oldest < 0 || m_blocks[i].last_use < m_blocks[oldest].last_use))
+                oldest = i;
+        }
+
+        if (oldest < 0)
+            break;
+
+        Block & b = m_blocks[oldest];
+        b.state = BLOCK_MISSING;
+
+        if (m_use_spill && ! m_spill && ! (m_spill = tmpfile ()))
+        {
+            AUDERR ("Failed to create block cache spill file: %s\n", strerror (errno));
+            m_use_spill = false;
+        }
+
+        if (m_use_spill)
+        {
+            if (fseeko (m_spill, (int64_t) oldest * block_size, SEEK_SET) == 0 &&
+             fwrite (b.data.begin (), 1, b.data.len (), m_spill) == (size_t) b.data.len ())
+                b.state = BLOCK_SPILLED;
+            else
+                AUDERR ("Failed to write to block cache spill file: %s\n", strerror (errno));
+        }
+
+        m_memory -= b.data.len ();
+        b.data.clear ();
+    }
+}
+
+int64_t BlockCache::read (int64_t pos, void * buf, int64_t len)
+{
+    len = aud::clamp (m_length - pos, (int64_t) 0, len);
+
+    int64_t done = 0;
+
+    pthread_mutex_lock (& m_mutex);
+
+    while (m_n_workers < m_max_workers)
+    {
+        pthread_create (& m_workers[m_n_workers], nullptr, worker_thread, this);
+        m_n_workers ++;
+    }
+
+    while (done < len)
+    {
+        int block = (pos + done) / block_size;
+        int offset = (pos + done) % block_size;
+
+        request (block, true);
+
+        int last = aud::min (block + m_prefetch, m_blocks.len () - 1);
+        for (int next = block + 1; next <= last; next ++)
+            request (next, false);
+
+        Block & b = m_blocks[block];
+        int tries = 1;
+
+        while (true)
+        {
+            while (b.state == BLOCK_PENDING)
+                pthread_cond_wait (& m_cond, & m_mutex);
+
+            if (b.state == BLOCK_SPILLED)
+                load (block);
+
+            if (b.state == BLOCK_MEMORY)
+                break;
+
+            /* A short read would look like the end of the file to a decoder.
+             * The block may have been evicted by another worker before we
+             * woke up, which is no reason to give up. */
+            if (b.state == BLOCK_FAILED && tries ++ >= max_tries)
+                break;
+
+            request (block, true);
+        }
+
+        if (b.state != BLOCK_MEMORY)
+            break;  /* a later read will try again */
+
+        int copy = aud::min (len - done, (int64_t) (b.data.len () - offset));
+        memcpy ((char *) buf + done, & b.data[offset], copy);
+
+        b.last_use = ++ m_use_count;
+        done += copy;
+    }
+
+    pthread_mutex_unlock (& m_mutex);
+    return done;
+}
+
+static bool fetch_range (ne_session * session, const char * path, int64_t start,
+ int len, Index<char> & data)
+{
+    ne_request * request = ne_request_create (session, "GET", path);
+    ne_add_request_header (request, "Range", str_printf ("bytes=%" PRId64
+     "-%" PRId64, start, start + len - 1));
+
+    AUDDBG ("Fetching bytes %" PRId64 "-%" PRId64 " of %s\n", start, start + len - 1, path);
+
+    bool success = false;
+    int ret = ne_begin_request (request);
+
+    if (ret != NE_OK)
+        AUDERR ("Range request failed: %s\n", ne_get_error (session));
+    else if (ne_get_status (request)->code != 206)
+        AUDERR ("Range request failed: HTTP status %d\n", ne_get_status (request)->code);
+    else
+    {
+        int got = 0;
+        data.insert (0, len);
+
+        while (got < len)
+        {
+            ssize_t part = ne_read_response_block (request, & data[got], len - got);
+            if (part <= 0)
+                break;
+
+            got += part;
+        }
+
+        if (got < len)
+            AUDERR ("Range request ended after %d of %d bytes\n", got, len);
+        else
+            success = (ne_end_request (request) == NE_OK);
+    }
+
+    ne_request_destroy (request);
+    return success;
+}
+
+void BlockCache::worker ()
+{
+    StringBuf path = neon_request_path (m_uri);
+
+    pthread_mutex_lock (& m_mutex);
+
+    while (! m_quit)
+    {
+        if (! m_queue.len ())
+        {
+            pthread_cond_wait (& m_cond, & m_mutex);
+            continue;
+        }
+
+        int block = m_queue[0];
+        m_queue.remove (0, 1);
+
+        int len = block_len (block);
+
+        pthread_mutex_unlock (& m_mutex);
+
+        ne_session * session = neon_session_get (m_uri);
+
+        Index<char> data;
+        bool success = fetch_range (session, path, (int64_t) block * block_size, len, data);
+
+        /* after a failure, the connection may be in an unknown state */
+        neon_session_put (session, success);
+
+        pthread_mutex_lock (& m_mutex);
+
+        Block & b = m_blocks[block];
+
+        if (success)
+        {
+            b.data = std::move (data);
+            b.state = BLOCK_MEMORY;
+            b.last_use = ++ m_use_count;
+            m_memory += len;
+            trim_memory (block);
+        }
+        else
+            b.state = BLOCK_FAILED;
+
+        pthread_cond_broadcast (& m_cond);
+    }
+
+    pthread_mutex_unlock (& m_mutex);
+}
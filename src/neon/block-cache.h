@@ -0,0 +1,113 @@
+/*
+ *  Block cache for the neon HTTP transport
+ *  Copyright 2026 Audacious developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NEON_BLOCK_CACHE_H
+#define NEON_BLOCK_CACHE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <libaudcore/index.h>
+#include <libaudcore/objects.h>
+
+#include <ne_uri.h>
+
+/* A remote file on a server that accepts range requests, fetched in fixed-size
+ * blocks by a few worker threads in parallel.  Blocks are kept in memory up to
+ * a configurable limit; beyond that the least recently used ones are moved to
+ * a temporary spill file.  A cache is shared by all handles open on the same
+ * URL, and the most recently used ones are kept for a while after the last
+ * handle is closed, so that reading the tags of a file and then playing it
+ * downloads each block only once. */
+class BlockCache
+{
+public:
+    static constexpr int block_size = 256 * 1024;
+
+    /* Returns the cache for url, creating it if needed.  The data is fetched
+     * from uri, which may differ from url after redirects. */
+    static BlockCache * acquire (const char * url, const ne_uri & uri, int64_t length);
+    static void release (BlockCache * cache);
+
+    /* Frees the caches that are no longer in use */
+    static void cleanup ();
+
+    int64_t length () const
+        { return m_length; }
+
+    /* Copies len bytes starting at pos into buf, fetching any missing blocks
+     * and scheduling the following ones to be prefetched.  Returns the number
+     * of bytes copied, which is short only at the end of the file or after a
+     * block has failed to download several times. */
+    int64_t read (int64_t pos, void * buf, int64_t len);
+
+private:
+    enum BlockState : char {
+        BLOCK_MISSING,
+        BLOCK_PENDING,  /* queued or being fetched */
+        BLOCK_MEMORY,
+        BLOCK_SPILLED,
+        BLOCK_FAILED
+    };
+
+    struct Block {
+        BlockState state = BLOCK_MISSING;
+        Index<char> data;
+        int64_t last_use = 0;
+    };
+
+    BlockCache (const char * url, const ne_uri & uri, int64_t length);
+    ~BlockCache ();
+
+    int block_len (int block) const;
+    void request (int block, bool urgent);
+    bool load (int block);
+    void trim_memory (int keep);
+    void worker ();
+
+    static void * worker_thread (void * data)
+        { ((BlockCache *) data)->worker (); return nullptr; }
+
+    static constexpr int max_workers = 8;
+    static constexpr int max_tries = 6;  /* fetches of a block before a read gives up */
+
+    String m_url;
+    ne_uri m_uri = ne_uri ();
+    int64_t m_length;
+    int m_refs = 0;
+
+    Index<Block> m_blocks;
+    Index<int> m_queue;         /* blocks waiting for a worker, most urgent first */
+    int64_t m_memory = 0;       /* bytes held in memory */
+    int64_t m_use_count = 0;
+    FILE * m_spill = nullptr;
+
+    int64_t m_max_memory;
+    int m_prefetch;
+    bool m_use_spill;
+
+    pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t m_cond = PTHREAD_COND_INITIALIZER;
+    pthread_t m_workers[max_workers];
+    int m_n_workers = 0, m_max_workers;
+    bool m_quit = false;
+};
+
+#endif
@@ -26,9 +26,10 @@
 #include <glib.h>
 
 #include <libaudcore/audstrings.h>
+#include <libaudcore/hook.h>
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
-#include <libaudcore/ringbuf.h>
+#include <libaudcore/preferences.h>
 #include <libaudcore/runtime.h>
 
 #include <ne_auth.h>
@@ -44,9 +45,11 @@
 #include <wincrypt.h>
 #endif
 
+#include "block-cache.h"
 #include "cert_verification.h"
+#include "neon.h"
 
-#define NEON_NETBLKSIZE     (4096)
+#define NEON_NETBLKSIZE     (4096)    /* smallest network read */
 #define NEON_ICY_BUFSIZE    (4096)
 #define NEON_RETRY_COUNT 6
 
@@ -85,6 +88,64 @@ struct reader_status
     }
 };
 
+/* A ring buffer that the network layer fills in place.  The reader thread
+ * asks for the free space at the tail, reads from the socket straight into
+ * it without holding any lock, and then commits what it got.  The positions
+ * are protected by reader_status.mutex; the consumer never touches the free
+ * space and the storage is never reallocated while a reader is running, so
+ * the block in flight needs neither a lock nor a bounce buffer. */
+class NetBuffer
+{
+public:
+    void alloc (int size)
+        { m_data.insert (0, size); }
+
+    int size () const
+        { return m_data.len (); }
+    int len () const
+        { return m_len; }
+    int space () const
+        { return m_data.len () - m_len; }
+
+    /* producer side */
+    char * tail (int & avail)
+    {
+        int end = (m_offset + m_len) % m_data.len ();
+        avail = aud::min (space (), m_data.len () - end);
+        return & m_data[end];
+    }
+
+    void commit (int len)
+        { m_len += len; }
+
+    /* consumer side */
+    char head () const
+        { return m_data[m_offset]; }
+
+    void discard (int len = -1)
+    {
+        if (len < 0)
+            len = m_len;
+
+        m_offset = (m_offset + len) % m_data.len ();
+        m_len -= len;
+    }
+
+    void move_out (char * to, int len)
+    {
+        int part = aud::min (len, m_data.len () - m_offset);
+
+        memcpy (to, & m_data[m_offset], part);
+        memcpy (to + part, & m_data[0], len - part);
+
+        discard (len);
+    }
+
+private:
+    Index<char> m_data;
+    int m_offset = 0, m_len = 0;
+};
+
 struct icy_metadata
 {
     String stream_name;
@@ -96,10 +157,69 @@ struct icy_metadata
 
 static const char * const neon_schemes[] = {"http", "https"};
 
+static const char * const neon_defaults[] = {
+    "buffer_kb", "0",
+    "max_block_kb", "64",
+    "block_cache", "TRUE",
+    "cache_mb", "32",
+    "prefetch_blocks", "8",
+    "prefetch_threads", "3",
+    "spill", "TRUE",
+    "pool", "TRUE",
+    "max_connections", "4",
+    "idle_timeout", "30",
+    nullptr
+};
+
+static const PreferencesWidget neon_widgets[] = {
+    WidgetSpin (N_("Buffer size:"),
+        WidgetInt ("neon", "buffer_kb"),
+        {0, 16384, 16, N_("KiB (0 = use network settings)")}),
+    WidgetSpin (N_("Largest network read:"),
+        WidgetInt ("neon", "max_block_kb"),
+        {4, 1024, 4, N_("KiB")}),
+    WidgetLabel (N_("<b>Seekable Files</b>")),
+    WidgetCheck (N_("Cache blocks fetched with range requests"),
+        WidgetBool ("neon", "block_cache")),
+    WidgetSpin (N_("Memory per file:"),
+        WidgetInt ("neon", "cache_mb"),
+        {1, 1024, 1, N_("MiB")},
+        WIDGET_CHILD),
+    WidgetCheck (N_("Move older blocks to a temporary file"),
+        WidgetBool ("neon", "spill"),
+        WIDGET_CHILD),
+    WidgetSpin (N_("Read ahead:"),
+        WidgetInt ("neon", "prefetch_blocks"),
+        {0, 64, 1, N_("blocks")},
+        WIDGET_CHILD),
+    WidgetSpin (N_("Parallel requests:"),
+        WidgetInt ("neon", "prefetch_threads"),
+        {1, 8, 1},
+        WIDGET_CHILD),
+    WidgetLabel (N_("<b>Connections</b>")),
+    WidgetCheck (N_("Keep connections open for reuse"),
+        WidgetBool ("neon", "pool")),
+    WidgetSpin (N_("Connections per server:"),
+        WidgetInt ("neon", "max_connections"),
+        {1, 32, 1},
+        WIDGET_CHILD),
+    WidgetSpin (N_("Close idle connections after:"),
+        WidgetInt ("neon", "idle_timeout"),
+        {1, 600, 1, N_("seconds")},
+        WIDGET_CHILD)
+};
+
+static const PluginPreferences neon_prefs = {{neon_widgets}};
+
 class NeonTransport : public TransportPlugin
 {
 public:
-    static constexpr PluginInfo info = {N_("Neon HTTP/HTTPS Plugin"), PACKAGE};
+    static constexpr PluginInfo info = {
+        N_("Neon HTTP/HTTPS Plugin"),
+        PACKAGE,
+        nullptr,
+        & neon_prefs
+    };
 
     constexpr NeonTransport () : TransportPlugin (info, neon_schemes) {}
 
@@ -113,6 +233,9 @@ EXPORT NeonTransport aud_plugin_instance;
 
 bool NeonTransport::init ()
 {
+    aud_config_set_defaults ("neon", neon_defaults);
+    timer_add (TimerRate::Hz1, neon_session_pool_purge);
+
     int ret = ne_sock_init ();
 
     if (ret != 0)
@@ -126,6 +249,9 @@ bool NeonTransport::init ()
 
 void NeonTransport::cleanup ()
 {
+    timer_remove (TimerRate::Hz1, neon_session_pool_purge);
+    BlockCache::cleanup ();
+    neon_session_pool_cleanup ();
     ne_sock_exit ();
 }
 
@@ -169,28 +295,31 @@ private:
 
     bool m_eof = false;
 
-    RingBuf<char> m_rb;           /* Ringbuffer for our data */
+    NetBuffer m_rb;               /* Ringbuffer for our data */
+    int m_block = NEON_NETBLKSIZE;  /* Current network read size, adapted to the
+                                       stream's throughput (under m_reader_status.mutex) */
+    int m_max_block;              /* Upper limit for m_block */
     Index<char> m_icy_buf;        /* Buffer for ICY metadata */
     icy_metadata m_icy_metadata;  /* Current ICY metadata */
 
     ne_session * m_session = nullptr;
     ne_request * m_request = nullptr;
+    bool m_request_done = false;  /* Response read to the end, so that the
+                                     connection can be reused */
+
+    BlockCache * m_cache = nullptr;  /* Used instead of m_request after the
+                                        first seek, if the server allows it */
 
     pthread_t m_reader;
     reader_status m_reader_status;
 
     void kill_reader ();
-    int server_auth (const char * realm, int attempt, char * username, char * password);
     void handle_headers ();
     int open_request (int64_t startbyte, String * error);
     FillBufferResult fill_buffer ();
     void reader ();
     int64_t try_fread (void * ptr, int64_t size, int64_t nmemb, bool & data_read);
 
-    static int server_auth_callback (void * data, const char * realm, int attempt,
-     char * username, char * password)
-        { return ((NeonFile *) data)->server_auth (realm, attempt, username, password); }
-
     static void * reader_thread (void * data)
         { ((NeonFile *) data)->reader (); return nullptr; }
 };
@@ -198,8 +327,16 @@ private:
 NeonFile::NeonFile (const char * url) :
     m_url (url)
 {
-    int buffer_kb = aud_get_int ("net_buffer_kb");
-    m_rb.alloc (1024 * aud::clamp (buffer_kb, 16, 1024));
+    int buffer_kb = aud_get_int ("neon", "buffer_kb");
+    if (buffer_kb <= 0)
+        buffer_kb = aud::clamp (aud_get_int ("net_buffer_kb"), 16, 1024);
+
+    m_rb.alloc (1024 * aud::clamp (buffer_kb, 16, 16384));
+
+    /* a single read should not be able to fill more than a quarter of the
+     * buffer, or the reader would sit idle waiting for that much space */
+    m_max_block = 1024 * aud::clamp (aud_get_int ("neon", "max_block_kb"), 4, 1024);
+    m_max_block = aud::clamp (m_max_block, NEON_NETBLKSIZE, m_rb.size () / 4);
 }
 
 NeonFile::~NeonFile ()
@@ -210,7 +347,9 @@ NeonFile::~NeonFile ()
     if (m_request)
         ne_request_destroy (m_request);
     if (m_session)
-        ne_session_destroy (m_session);
+        neon_session_put (m_session, m_request_done);
+    if (m_cache)
+        BlockCache::release (m_cache);
 
     ne_uri_free (& m_purl);
 }
@@ -331,33 +470,6 @@ void NeonFile::kill_reader ()
     AUDDBG ("Reader thread has died\n");
 }
 
-int NeonFile::server_auth (const char * realm, int attempt, char * username, char * password)
-{
-    if (! m_purl.userinfo || ! m_purl.userinfo[0])
-    {
-        AUDERR ("Authentication required, but no credentials set\n");
-        return 1;
-    }
-
-    char * * authtok = g_strsplit (m_purl.userinfo, ":", 2);
-
-    if (strlen (authtok[1]) > NE_ABUFSIZ - 1 || strlen (authtok[0]) > NE_ABUFSIZ - 1)
-    {
-        AUDERR ("Username/Password too long\n");
-        g_strfreev (authtok);
-        return 1;
-    }
-
-    g_strlcpy (username, authtok[0], NE_ABUFSIZ);
-    g_strlcpy (password, authtok[1], NE_ABUFSIZ);
-
-    AUDDBG ("Authenticating: Username: %s, Password: %s\n", username, password);
-
-    g_strfreev (authtok);
-
-    return attempt;
-}
-
 void NeonFile::handle_headers ()
 {
     const char * name;
@@ -431,6 +543,38 @@ void NeonFile::handle_headers ()
     }
 }
 
+/* Credentials for server authentication come from the URI that was passed
+ * to neon_create_session(). */
+static int server_auth_cb (void * data, const char * realm, int attempt,
+ char * username, char * password)
+{
+    const ne_uri * uri = (const ne_uri *) data;
+
+    if (! uri->userinfo || ! uri->userinfo[0])
+    {
+        AUDERR ("Authentication required, but no credentials set\n");
+        return 1;
+    }
+
+    char * * authtok = g_strsplit (uri->userinfo, ":", 2);
+
+    if (strlen (authtok[1]) > NE_ABUFSIZ - 1 || strlen (authtok[0]) > NE_ABUFSIZ - 1)
+    {
+        AUDERR ("Username/Password too long\n");
+        g_strfreev (authtok);
+        return 1;
+    }
+
+    g_strlcpy (username, authtok[0], NE_ABUFSIZ);
+    g_strlcpy (password, authtok[1], NE_ABUFSIZ);
+
+    AUDDBG ("Authenticating: Username: %s, Password: %s\n", username, password);
+
+    g_strfreev (authtok);
+
+    return attempt;
+}
+
 static int neon_proxy_auth_cb (void * userdata, const char * realm, int attempt,
  char * username, char * password)
 {
@@ -443,19 +587,108 @@ static int neon_proxy_auth_cb (void * userdata, const char * realm, int attempt,
     return attempt;
 }
 
+#ifdef _WIN32
+static void trust_win32_root_certs (ne_session * m_session)
+{
+    auto store = CertOpenSystemStore (0, "ROOT");
+    if (! store)
+        return;
+
+    const CERT_CONTEXT * ctx = NULL;
+    while ((ctx = CertEnumCertificatesInStore (store, ctx)))
+    {
+        char * enc = g_base64_encode (ctx->pbCertEncoded, ctx->cbCertEncoded);
+        ne_ssl_certificate * cert = ne_ssl_cert_import (enc);
+        if (cert)
+        {
+            ne_ssl_trust_cert (m_session, cert);
+            ne_ssl_cert_free (cert);
+        }
+        g_free (enc);
+    }
+
+    CertCloseStore (store, 0);
+}
+#endif
+
+ne_session * neon_create_session (ne_uri * uri)
+{
+    if (! uri->port)
+        uri->port = ne_uri_defaultport (uri->scheme);
+
+    AUDDBG ("Creating session to %s://%s:%d\n", uri->scheme, uri->host, uri->port);
+
+    ne_session * session = ne_session_create (uri->scheme, uri->host, uri->port);
+    ne_redirect_register (session);
+    ne_add_server_auth (session, NE_AUTH_BASIC, server_auth_cb, uri);
+    ne_set_session_flag (session, NE_SESSFLAG_PERSIST, 0);
+    ne_set_connect_timeout (session, 10);
+    ne_set_read_timeout (session, 10);
+    ne_set_useragent (session, "Audacious/" PACKAGE_VERSION);
+
+    if (aud_get_bool ("use_proxy"))
+    {
+        String proxy_host = aud_get_str ("proxy_host");
+        int proxy_port = aud_get_int ("proxy_port");
+        bool use_proxy_auth = aud_get_bool ("use_proxy_auth");
+
+        AUDDBG ("Using proxy: %s:%d\n", (const char *) proxy_host, proxy_port);
+
+        if (aud_get_bool ("socks_proxy"))
+        {
+            // ne_session_socks_proxy requires non NULL user and password
+            String proxy_user (""), proxy_pass ("");
+
+            if (use_proxy_auth)
+            {
+                proxy_user = aud_get_str ("proxy_user");
+                proxy_pass = aud_get_str ("proxy_pass");
+            }
+
+            ne_sock_sversion socks_type = (aud_get_int ("socks_type") == 0) ?
+             NE_SOCK_SOCKSV4A : NE_SOCK_SOCKSV5;
+
+            ne_session_socks_proxy (session, socks_type, proxy_host, proxy_port, proxy_user, proxy_pass);
+        }
+        else
+        {
+            ne_session_proxy (session, proxy_host, proxy_port);
+        }
+
+        if (use_proxy_auth)
+        {
+            AUDDBG ("Using proxy authentication\n");
+            ne_add_proxy_auth (session, NE_AUTH_BASIC, neon_proxy_auth_cb, nullptr);
+        }
+    }
+
+    if (! strcmp ("https", uri->scheme))
+    {
+        ne_ssl_trust_default_ca (session);
+#ifdef _WIN32
+        trust_win32_root_certs (session);
+#endif
+        ne_ssl_set_verify (session, neon_vfs_verify_environment_ssl_certs, session);
+    }
+
+    return session;
+}
+
+StringBuf neon_request_path (const ne_uri & uri)
+{
+    if (uri.query && uri.query[0])
+        return str_concat ({uri.path, "?", uri.query});
+
+    return str_copy (uri.path);
+}
+
 int NeonFile::open_request (int64_t startbyte, String * error)
 {
     int ret;
     const ne_status * status;
     ne_uri * rediruri;
 
-    if (m_purl.query && * (m_purl.query))
-    {
-        StringBuf tmp = str_concat ({m_purl.path, "?", m_purl.query});
-        m_request = ne_request_create (m_session, "GET", tmp);
-    }
-    else
-        m_request = ne_request_create (m_session, "GET", m_purl.path);
+    m_request = ne_request_create (m_session, "GET", neon_request_path (m_purl));
 
     if (startbyte > 0)
         ne_add_request_header (m_request, "Range", str_printf ("bytes=%" PRIu64 "-", startbyte));
@@ -549,60 +782,9 @@ int NeonFile::open_request (int64_t startbyte, String * error)
     return -1;
 }
 
-#ifdef _WIN32
-static void trust_win32_root_certs (ne_session * m_session)
-{
-    auto store = CertOpenSystemStore (0, "ROOT");
-    if (! store)
-        return;
-
-    const CERT_CONTEXT * ctx = NULL;
-    while ((ctx = CertEnumCertificatesInStore (store, ctx)))
-    {
-        char * enc = g_base64_encode (ctx->pbCertEncoded, ctx->cbCertEncoded);
-        ne_ssl_certificate * cert = ne_ssl_cert_import (enc);
-        if (cert)
-        {
-            ne_ssl_trust_cert (m_session, cert);
-            ne_ssl_cert_free (cert);
-        }
-        g_free (enc);
-    }
-
-    CertCloseStore (store, 0);
-}
-#endif
-
 int NeonFile::open_handle (int64_t startbyte, String * error)
 {
     int ret;
-    String proxy_host;
-    int proxy_port = 0;
-    String proxy_user (""); // ne_session_socks_proxy requires non NULL user and password
-    String proxy_pass ("");
-    bool socks_proxy = false;
-    ne_sock_sversion socks_type = NE_SOCK_SOCKSV4A;
-
-    bool use_proxy = aud_get_bool ("use_proxy");
-    bool use_proxy_auth = aud_get_bool ("use_proxy_auth");
-
-    if (use_proxy)
-    {
-        proxy_host = aud_get_str ("proxy_host");
-        proxy_port = aud_get_int ("proxy_port");
-        socks_proxy = aud_get_bool ("socks_proxy");
-
-        if (use_proxy_auth)
-        {
-            proxy_user = aud_get_str ("proxy_user");
-            proxy_pass = aud_get_str ("proxy_pass");
-        }
-
-        if (socks_proxy)
-        {
-            socks_type = aud_get_int ("socks_type") == 0 ? NE_SOCK_SOCKSV4A : NE_SOCK_SOCKSV5;
-        }
-    }
 
     m_redircount = 0;
 
@@ -619,50 +801,9 @@ int NeonFile::open_handle (int64_t startbyte, String * error)
 
     while (m_redircount < 10)
     {
-        if (! m_purl.port)
-            m_purl.port = ne_uri_defaultport (m_purl.scheme);
-
-        AUDDBG ("<%p> Creating session to %s://%s:%d\n", this,
-         m_purl.scheme, m_purl.host, m_purl.port);
-        m_session = ne_session_create (m_purl.scheme,
-         m_purl.host, m_purl.port);
-        ne_redirect_register (m_session);
-        ne_add_server_auth (m_session, NE_AUTH_BASIC, server_auth_callback, this);
+        AUDDBG ("<%p> Getting session\n", this);
+        m_session = neon_session_get (m_purl);
         ne_set_session_flag (m_session, NE_SESSFLAG_ICYPROTO, 1);
-        ne_set_session_flag (m_session, NE_SESSFLAG_PERSIST, 0);
-        ne_set_connect_timeout (m_session, 10);
-        ne_set_read_timeout (m_session, 10);
-        ne_set_useragent (m_session, "Audacious/" PACKAGE_VERSION);
-
-        if (use_proxy)
-        {
-            AUDDBG ("<%p> Using proxy: %s:%d\n", this, (const char *) proxy_host, proxy_port);
-            if (socks_proxy)
-            {
-                ne_session_socks_proxy (m_session, socks_type, proxy_host, proxy_port, proxy_user, proxy_pass);
-            }
-            else
-            {
-                ne_session_proxy (m_session, proxy_host, proxy_port);
-            }
-
-            if (use_proxy_auth)
-            {
-                AUDDBG ("<%p> Using proxy authentication\n", this);
-                ne_add_proxy_auth (m_session, NE_AUTH_BASIC,
-                 neon_proxy_auth_cb, (void *) this);
-            }
-        }
-
-        if (! strcmp ("https", m_purl.scheme))
-        {
-            ne_ssl_trust_default_ca (m_session);
-#ifdef _WIN32
-            trust_win32_root_certs (m_session);
-#endif
-            ne_ssl_set_verify (m_session,
-             neon_vfs_verify_environment_ssl_certs, m_session);
-        }
 
         AUDDBG ("<%p> Creating request\n", this);
         ret = open_request (startbyte, error);
@@ -672,13 +813,13 @@ int NeonFile::open_handle (int64_t startbyte, String * error)
 
         if (ret == -1)
         {
-            ne_session_destroy (m_session);
+            neon_session_put (m_session, false);
             m_session = nullptr;
             return -1;
         }
 
         AUDDBG ("<%p> Following redirect...\n", this);
-        ne_session_destroy (m_session);
+        neon_session_put (m_session, false);
         m_session = nullptr;
     }
 
@@ -692,18 +833,22 @@ int NeonFile::open_handle (int64_t startbyte, String * error)
 
 FillBufferResult NeonFile::fill_buffer ()
 {
-    char buffer[NEON_NETBLKSIZE];
-    int to_read;
+    int avail, to_read;
 
     pthread_mutex_lock (& m_reader_status.mutex);
-    to_read = aud::min (m_rb.space (), NEON_NETBLKSIZE);
+    char * tail = m_rb.tail (avail);
+    to_read = aud::min (avail, m_block);
     pthread_mutex_unlock (& m_reader_status.mutex);
 
-    int bsize = ne_read_response_block (m_request, buffer, to_read);
+    /* For reads at least as large as its own socket buffer, neon receives
+     * straight into the given memory, so the data lands in m_rb directly. */
+    int bsize = ne_read_response_block (m_request, tail, to_read);
 
     if (! bsize)
     {
         AUDDBG ("<%p> End of file encountered\n", this);
+        m_request_done = (ne_end_request (m_request) == NE_OK);
+        neon_session_done (m_session);
         return FILL_BUFFER_EOF;
     }
 
@@ -718,7 +863,19 @@ FillBufferResult NeonFile::fill_buffer ()
     AUDDBG ("<%p> Read %d bytes of %d\n", this, bsize, to_read);
 
     pthread_mutex_lock (& m_reader_status.mutex);
-    m_rb.copy_in (buffer, bsize);
+
+    m_rb.commit (bsize);
+
+    /* Grow the read size while the network keeps up with it, and shrink it
+     * again when reads come back mostly empty, so that a slow stream does
+     * not wait for a large block of free space before it is refilled.  A
+     * read cut short by the end of the ring buffer is judged by what was
+     * asked for. */
+    if (bsize == m_block)
+        m_block = aud::min (m_block * 2, m_max_block);
+    else if (bsize < to_read / 4)
+        m_block = aud::max (m_block / 2, NEON_NETBLKSIZE);
+
     pthread_mutex_unlock (& m_reader_status.mutex);
 
     return FILL_BUFFER_SUCCESS;
@@ -730,8 +887,8 @@ void NeonFile::reader ()
 
     while (m_reader_status.reading)
     {
-        /* Hit the network only if we have more than NEON_NETBLKSIZE of free buffer */
-        if (m_rb.space () > NEON_NETBLKSIZE)
+        /* Hit the network only if there is room for a full block */
+        if (m_rb.space () >= m_block)
         {
             pthread_mutex_unlock (& m_reader_status.mutex);
 
@@ -928,13 +1085,17 @@ int64_t NeonFile::try_fread (void * ptr, int64_t size, int64_t nmemb, bool & dat
                 /* The next data in the buffer is a ICY metadata announcement.
                  * Get the length byte */
                 m_icy_len = 16 * (unsigned char) m_rb.head ();
-                m_rb.pop ();
+                m_rb.discard (1);
 
                 AUDDBG ("<%p> Expecting %d bytes of ICY metadata\n", this, m_icy_len);
             }
 
             if (m_icy_buf.len () < m_icy_len)
-                m_rb.move_out (m_icy_buf, -1, aud::min (m_icy_len - m_icy_buf.len (), m_rb.len ()));
+            {
+                int part = aud::min (m_icy_len - m_icy_buf.len (), m_rb.len ());
+                m_icy_buf.insert (-1, part);
+                m_rb.move_out (m_icy_buf.end () - part, part);
+            }
 
             if (m_icy_buf.len () >= m_icy_len)
             {
@@ -965,7 +1126,7 @@ int64_t NeonFile::try_fread (void * ptr, int64_t size, int64_t nmemb, bool & dat
             m_eof = true;
         }
     }
-    else
+    else if (m_rb.space () >= m_block)
         pthread_cond_broadcast (& m_reader_status.cond);
 
     pthread_mutex_unlock (& m_reader_status.mutex);
@@ -984,6 +1145,18 @@ int64_t NeonFile::fread (void * buffer, int64_t size, int64_t count)
 
     AUDDBG ("<%p> fread %d x %d\n", this, (int) size, (int) count);
 
+    if (m_cache && size > 0)
+    {
+        int64_t len = aud::min (size * count, m_cache->length () - m_pos);
+        total = m_cache->read (m_pos, buffer, len - len % size) / size;
+
+        m_pos += total * size;
+        m_eof = (m_pos >= m_cache->length ());
+
+        AUDDBG ("<%p> fread = %d (cached)\n", this, (int) total);
+        return total;
+    }
+
     while (count > 0)
     {
         bool data_read = false;
@@ -1094,6 +1267,13 @@ int NeonFile::fseek (int64_t offset, VFSSeekType whence)
     if (newpos == m_pos)
         return 0;
 
+    if (m_cache)
+    {
+        m_pos = newpos;
+        m_eof = false;
+        return 0;
+    }
+
     /* To seek to the new position we have to
      * - stop the current reader thread, if there is one
      * - destroy the current request
@@ -1110,14 +1290,26 @@ int NeonFile::fseek (int64_t offset, VFSSeekType whence)
 
     if (m_session)
     {
-        ne_session_destroy (m_session);
+        neon_session_put (m_session, m_request_done);
         m_session = nullptr;
+        m_request_done = false;
     }
 
     m_rb.discard ();
     m_icy_buf.clear ();
     m_icy_len = 0;
 
+    /* From now on, read through the block cache.  Seeks then only move the
+     * position, and data that was fetched once is not requested again. */
+    if (m_can_ranges && m_content_length >= 0 && ! m_icy_metaint &&
+     aud_get_bool ("neon", "block_cache"))
+    {
+        m_cache = BlockCache::acquire (m_url, m_purl, content_length);
+        m_pos = newpos;
+        m_eof = false;
+        return 0;
+    }
+
     if (open_handle (newpos) != 0)
     {
         AUDERR ("<%p> Error while creating new request!\n", this);
@@ -0,0 +1,54 @@
+/*
+ *  A neon HTTP input plugin for Audacious
+ *  Copyright 2026 Audacious developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NEON_H
+#define NEON_H
+
+#include <libaudcore/objects.h>
+
+#include <ne_session.h>
+#include <ne_uri.h>
+
+/* Creates a session to the host in uri, set up with the proxy and SSL
+ * settings.  The URI supplies the credentials for server authentication and
+ * must outlive the session.  Connections are not kept alive by default. */
+ne_session * neon_create_session (ne_uri * uri);
+
+/* The path and query of uri, as used in a request line */
+StringBuf neon_request_path (const ne_uri & uri);
+
+/* Takes an idle session to the host in uri from the pool, or creates one.
+ * Blocks for a while if the host already has the maximum number of requests
+ * in flight. */
+ne_session * neon_session_get (const ne_uri & uri);
+
+/* Returns a session to the pool.  Pass keep_connection only if the last
+ * response was read to the end, so that the connection can carry another
+ * request. */
+void neon_session_put (ne_session * session, bool keep_connection);
+
+/* Marks a session that is still held, but will carry no more requests, as no
+ * longer counting toward the connection limit */
+void neon_session_done (ne_session * session);
+
+/* Drops sessions that have been idle for too long; a timer callback */
+void neon_session_pool_purge (void * = nullptr);
+void neon_session_pool_cleanup ();
+
+#endif
@@ -0,0 +1,262 @@
+/*
+ *  Connection pool for the neon HTTP transport
+ *  Copyright 2026 Audacious developers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Sessions are pooled per scheme, host, port and credentials.  A session
+ * returned with its last response read to the end keeps its connection open
+ * for the next request; otherwise the connection is closed, but the session
+ * object is still kept, since neon remembers the TLS session in it and can
+ * resume it on the next handshake instead of doing (and verifying) a full
+ * one.  Idle sessions are dropped after a timeout.
+ *
+ * The connection limit counts only sessions with a request in flight: a file
+ * that has read its response to the end may keep its session until it is
+ * closed, but that does not hold up anyone else.
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/runtime.h>
+
+#include <ne_session.h>
+
+#include "neon.h"
+
+/* how long to wait for a free connection before going over the limit */
+#define WAIT_TIMEOUT 10 /* seconds */
+
+struct PooledSession
+{
+    String key;   /* includes the credentials, so never print it */
+    String name;  /* for log messages */
+    ne_uri uri = ne_uri ();  /* referenced by the session's auth callback */
+    ne_session * session = nullptr;
+    bool in_use = false;
+    bool in_flight = false;  /* in use and not yet done with its requests */
+    int64_t idle_since = 0;  /* microseconds, monotonic */
+
+    ~PooledSession ()
+    {
+        if (session)
+            ne_session_destroy (session);
+
+        ne_uri_free (& uri);
+    }
+};
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static Index<PooledSession *> pool;
+
+static StringBuf pool_key (const ne_uri & uri)
+{
+    int port = uri.port ? uri.port : ne_uri_defaultport (uri.scheme);
+    return str_printf ("%s://%s@%s:%d", uri.scheme, uri.userinfo ? uri.userinfo : "",
+     uri.host, port);
+}
+
+static StringBuf pool_name (const ne_uri & uri)
+{
+    int port = uri.port ? uri.port : ne_uri_defaultport (uri.scheme);
+    return str_printf ("%s://%s:%d", uri.scheme, uri.host, port);
+}
+
+ne_session * neon_session_get (const ne_uri & uri)
+{
+    auto entry = new PooledSession;
+    ne_uri_copy (& entry->uri, & uri);
+    entry->name = String (pool_name (uri));
+
+    if (! aud_get_bool ("neon", "pool"))
+    {
+        entry->session = neon_create_session (& entry->uri);
+        entry->in_use = true;
+        entry->in_flight = true;
+
+        pthread_mutex_lock (& mutex);
+        pool.append (entry);
+        pthread_mutex_unlock (& mutex);
+
+        return entry->session;
+    }
+
+    entry->key = String (pool_key (uri));
+
+    int max_conns = aud::max (1, aud_get_int ("neon", "max_connections"));
+    int64_t deadline = g_get_monotonic_time () + WAIT_TIMEOUT * G_TIME_SPAN_SECOND;
+
+    pthread_mutex_lock (& mutex);
+
+    while (true)
+    {
+        PooledSession * idle = nullptr;
+        int conns = 0;
+
+        for (PooledSession * other : pool)
+        {
+            if (! other->key || strcmp (other->key, entry->key))
+                continue;
+
+            if (other->in_flight)
+                conns ++;
+
+            /* prefer the most recently used one, whose connection is most
+             * likely still open */
+            if (! other->in_use && (! idle || other->idle_since > idle->idle_since))
+                idle = other;
+        }
+
+        if (idle)
+        {
+            AUDDBG ("Reusing session to %s\n", (const char *) entry->name);
+            idle->in_use = true;
+            idle->in_flight = true;
+            pthread_mutex_unlock (& mutex);
+
+            delete entry;
+            return idle->session;
+        }
+
+        if (conns < max_conns)
+            break;
+
+        if (g_get_monotonic_time () >= deadline)
+        {
+            AUDWARN ("Timed out waiting for a connection to %s\n", (const char *) entry->name);
+            break;
+        }
+
+        struct timespec ts;
+        clock_gettime (CLOCK_REALTIME, & ts);
+        ts.tv_sec ++;
+        pthread_cond_timedwait (& cond, & mutex, & ts);
+    }
+
+    /* creating the session does not connect, so it is fine to hold the lock */
+    entry->session = neon_create_session (& entry->uri);
+    ne_set_session_flag (entry->session, NE_SESSFLAG_PERSIST, 1);
+    entry->in_use = true;
+    entry->in_flight = true;
+    pool.append (entry);
+
+    pthread_mutex_unlock (& mutex);
+    return entry->session;
+}
+
+void neon_session_put (ne_session * session, bool keep_connection)
+{
+    PooledSession * expired = nullptr;
+
+    if (! keep_connection)
+        ne_close_connection (session);
+
+    pthread_mutex_lock (& mutex);
+
+    for (int i = 0; i < pool.len (); i ++)
+    {
+        PooledSession * entry = pool[i];
+        if (entry->session != session)
+            continue;
+
+        if (! entry->key)
+        {
+            /* pooling was disabled when the session was created */
+            pool.remove (i, 1);
+            expired = entry;
+        }
+        else
+        {
+            entry->in_use = false;
+            entry->in_flight = false;
+            entry->idle_since = g_get_monotonic_time ();
+            pthread_cond_broadcast (& cond);
+        }
+
+        break;
+    }
+
+    pthread_mutex_unlock (& mutex);
+
+    delete expired;
+}
+
+void neon_session_done (ne_session * session)
+{
+    pthread_mutex_lock (& mutex);
+
+    for (PooledSession * entry : pool)
+    {
+        if (entry->session == session)
+        {
+            entry->in_flight = false;
+            pthread_cond_broadcast (& cond);
+            break;
+        }
+    }
+
+    pthread_mutex_unlock (& mutex);
+}
+
+void neon_session_pool_purge (void *)
+{
+    Index<PooledSession *> expired;
+    int64_t limit = g_get_monotonic_time () -
+     aud_get_int ("neon", "idle_timeout") * G_TIME_SPAN_SECOND;
+
+    pthread_mutex_lock (& mutex);
+
+    for (int i = pool.len (); i --; )
+    {
+        if (! pool[i]->in_use && pool[i]->idle_since <= limit)
+        {
+            expired.append (pool[i]);
+            pool.remove (i, 1);
+        }
+    }
+
+    pthread_mutex_unlock (& mutex);
+
+    /* closing a TLS connection may do I/O */
+    for (PooledSession * entry : expired)
+    {
+        AUDDBG ("Closing idle session to %s\n", (const char *) entry->name);
+        delete entry;
+    }
+}
+
+void neon_session_pool_cleanup ()
+{
+    pthread_mutex_lock (& mutex);
+
+    for (PooledSession * entry : pool)
+    {
+        if (entry->in_use)
+            AUDERR ("Session to %s still in use\n", (const char *) entry->name);
+        else
+            delete entry;
+    }
+
+    pool.clear ();
+    pthread_mutex_unlock (& mutex);
+}
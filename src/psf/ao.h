@@ -33,6 +33,6 @@ enum
 	COMMAND_JUMP
 };
 
-Index<char> ao_get_lib(char *filename);
+Index<char> ao_get_lib(const char *dirpath, char *filename);
 
 #endif // AO_H
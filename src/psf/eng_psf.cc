@@ -45,14 +45,17 @@
 
 #define LE32(x) FROM_LE32(x)
 
-static corlett_t	*c = nullptr;
-static char 		psfby[256];
-int			psf_refresh  = -1;
+static mips_cpu_context *psf_fail(mips_cpu_context *cpu)
+{
+	free(cpu->c);
+	delete cpu;
 
-static uint32_t initialPC, initialGP, initialSP;
+	return nullptr;
+}
 
-int32_t psf_start(uint8_t *buffer, uint32_t length)
+mips_cpu_context *psf_start(const char *dirpath, uint8_t *buffer, uint32_t length, bool endless)
 {
+	mips_cpu_context *cpu = new mips_cpu_context();
 	uint8_t *file, *lib_decoded, *alib_decoded;
 	uint32_t offset, plength, PC, SP, GP, lengthMS, fadeMS;
 	uint64_t file_len, lib_len, alib_len;
@@ -60,15 +63,17 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 	int i;
 	union cpuinfo mipsinfo;
 
+	cpu->psf_refresh = -1;
+
 	// clear PSX work RAM before we start scribbling in it
-	memset(psx_ram, 0, 2*1024*1024);
+	memset(cpu->psx_ram, 0, 2*1024*1024);
 
 //	printf("Length = %d\n", length);
 
 	// Decode the current GSF
-	if (corlett_decode(buffer, length, &file, &file_len, &c) != AO_SUCCESS)
+	if (corlett_decode(buffer, length, &file, &file_len, &cpu->c) != AO_SUCCESS)
 	{
-		return AO_FAIL;
+		return psf_fail(cpu);
 	}
 
 //	printf("file_len %d reserve %d\n", file_len, c->res_size);
@@ -76,7 +81,7 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 	// check for PSX EXE signature
 	if (strncmp((char *)file, "PS-X EXE", 8))
 	{
-		return AO_FAIL;
+		return psf_fail(cpu);
 	}
 
 	#if DEBUG_LOADER
@@ -85,16 +90,16 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 	offset = file[0x1c] | file[0x1d]<<8 | file[0x1e]<<16 | file[0x1f]<<24;
 	printf("Text section size: %x\n", offset);
 	printf("Region: [%s]\n", &file[0x4c]);
-	printf("refresh: [%s]\n", c->inf_refresh);
+	printf("refresh: [%s]\n", cpu->c->inf_refresh);
 	#endif
 
-	if (c->inf_refresh[0] == '5')
+	if (cpu->c->inf_refresh[0] == '5')
 	{
-		psf_refresh = 50;
+		cpu->psf_refresh = 50;
 	}
-	if (c->inf_refresh[0] == '6')
+	if (cpu->c->inf_refresh[0] == '6')
 	{
-		psf_refresh = 60;
+		cpu->psf_refresh = 60;
 	}
 
 	PC = file[0x10] | file[0x11]<<8 | file[0x12]<<16 | file[0x13]<<24;
@@ -106,25 +111,25 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 	#endif
 
 	// Get the library file, if any
-	if (c->lib[0] != 0)
+	if (cpu->c->lib[0] != 0)
 	{
 		#if DEBUG_LOADER
-		printf("Loading library: %s\n", c->lib);
+		printf("Loading library: %s\n", cpu->c->lib);
 		#endif
 
-		Index<char> buf = ao_get_lib(c->lib);
+		Index<char> buf = ao_get_lib(dirpath, cpu->c->lib);
 
 		if (!buf.len())
-			return AO_FAIL;
+			return psf_fail(cpu);
 
 		if (corlett_decode((uint8_t *)buf.begin(), buf.len(), &lib_decoded, &lib_len, &lib) != AO_SUCCESS)
-			return AO_FAIL;
+			return psf_fail(cpu);
 
 		if (strncmp((char *)lib_decoded, "PS-X EXE", 8))
 		{
 			printf("Major error!  PSF was OK, but referenced library is not!\n");
 			free(lib);
-			return AO_FAIL;
+			return psf_fail(cpu);
 		}
 
 		#if DEBUG_LOADER
@@ -137,15 +142,15 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 		#endif
 
 		// if the original file had no refresh tag, give the lib a shot
-		if (psf_refresh == -1)
+		if (cpu->psf_refresh == -1)
 		{
 			if (lib->inf_refresh[0] == '5')
 			{
-				psf_refresh = 50;
+				cpu->psf_refresh = 50;
 			}
 			if (lib->inf_refresh[0] == '6')
 			{
-				psf_refresh = 60;
+				cpu->psf_refresh = 60;
 			}
 		}
 
@@ -171,7 +176,7 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 		#if DEBUG_LOADER
 		printf("library offset: %x plength: %d\n", offset, plength);
 		#endif
-		memcpy(&psx_ram[offset/4], lib_decoded + 2048, plength);
+		memcpy(&cpu->psx_ram[offset/4], lib_decoded + 2048, plength);
 
 		// Dispose the corlett structure for the lib - we don't use it
 		free(lib);
@@ -186,30 +191,30 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 	else
 		plength = file_len - 2048;
 
-	memcpy(&psx_ram[offset/4], file + 2048, plength);
+	memcpy(&cpu->psx_ram[offset/4], file + 2048, plength);
 
 	// load any auxiliary libraries now
 	for (i = 0; i < 8; i++)
 	{
-		if (c->libaux[i][0] != 0)
+		if (cpu->c->libaux[i][0] != 0)
 		{
 			#if DEBUG_LOADER
-			printf("Loading aux library: %s\n", c->libaux[i]);
+			printf("Loading aux library: %s\n", cpu->c->libaux[i]);
 			#endif
 
-			Index<char> buf = ao_get_lib(c->libaux[i]);
+			Index<char> buf = ao_get_lib(dirpath, cpu->c->libaux[i]);
 
 			if (!buf.len())
-				return AO_FAIL;
+				return psf_fail(cpu);
 
 			if (corlett_decode((uint8_t *)buf.begin(), buf.len(), &alib_decoded, &alib_len, &lib) != AO_SUCCESS)
-				return AO_FAIL;
+				return psf_fail(cpu);
 
 			if (strncmp((char *)alib_decoded, "PS-X EXE", 8))
 			{
 				printf("Major error!  PSF was OK, but referenced library is not!\n");
 				free(lib);
-				return AO_FAIL;
+				return psf_fail(cpu);
 			}
 
 			#if DEBUG_LOADER
@@ -229,7 +234,7 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 			else
 				plength = alib_len - 2048;
 
-			memcpy(&psx_ram[offset/4], alib_decoded + 2048, plength);
+			memcpy(&cpu->psx_ram[offset/4], alib_decoded + 2048, plength);
 
 			// Dispose the corlett structure for the lib - we don't use it
 			free(lib);
@@ -240,27 +245,27 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 //	free(lib_decoded);
 
 	// Finally, set psfby tag
-	strcpy(psfby, "n/a");
-	if (c)
+	strcpy(cpu->psfby, "n/a");
+	if (cpu->c)
 	{
 		int i;
 		for (i = 0; i < MAX_UNKNOWN_TAGS; i++)
 		{
-			if (!strcmp_nocase(c->tag_name[i], "psfby"))
-				strcpy(psfby, c->tag_data[i]);
+			if (!strcmp_nocase(cpu->c->tag_name[i], "psfby"))
+				strcpy(cpu->psfby, cpu->c->tag_data[i]);
 		}
 	}
 
-	mips_init();
-	mips_reset(nullptr);
+	mips_init(cpu);
+	mips_reset(cpu, nullptr);
 
 	// set the initial PC, SP, GP
 	#if DEBUG_LOADER
 	printf("Initial PC %x, GP %x, SP %x\n", PC, GP, SP);
-	printf("Refresh = %d\n", psf_refresh);
+	printf("Refresh = %d\n", cpu->psf_refresh);
 	#endif
 	mipsinfo.i = PC;
-	mips_set_info(CPUINFO_INT_PC, &mipsinfo);
+	mips_set_info(cpu, CPUINFO_INT_PC, &mipsinfo);
 
 	// set some reasonable default for the stack
 	if (SP == 0)
@@ -269,28 +274,29 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 	}
 
 	mipsinfo.i = SP;
-	mips_set_info(CPUINFO_INT_REGISTER + MIPS_R29, &mipsinfo);
-	mips_set_info(CPUINFO_INT_REGISTER + MIPS_R30, &mipsinfo);
+	mips_set_info(cpu, CPUINFO_INT_REGISTER + MIPS_R29, &mipsinfo);
+	mips_set_info(cpu, CPUINFO_INT_REGISTER + MIPS_R30, &mipsinfo);
 
 	mipsinfo.i = GP;
-	mips_set_info(CPUINFO_INT_REGISTER + MIPS_R28, &mipsinfo);
+	mips_set_info(cpu, CPUINFO_INT_REGISTER + MIPS_R28, &mipsinfo);
 
 	#if DEBUG_LOADER && 1
 	{
 		FILE *f;
 
 		f = fopen("psxram.bin", "wb");
-		fwrite(psx_ram, 2*1024*1024, 1, f);
+		fwrite(cpu->psx_ram, 2*1024*1024, 1, f);
 		fclose(f);
 	}
 	#endif
 
-	psx_hw_init();
-	SPUinit();
-	SPUopen();
+	psx_hw_init(cpu);
+	SPUinit(cpu);
+	SPUopen(cpu);
+	setendless(cpu, endless);
 
-	lengthMS = psfTimeToMS(c->inf_length);
-	fadeMS = psfTimeToMS(c->inf_fade);
+	lengthMS = psfTimeToMS(cpu->c->inf_length);
+	fadeMS = psfTimeToMS(cpu->c->inf_fade);
 
 	#if DEBUG_LOADER
 	printf("length %d fade %d\n", lengthMS, fadeMS);
@@ -301,55 +307,57 @@ int32_t psf_start(uint8_t *buffer, uint32_t length)
 		lengthMS = ~0;
 	}
 
-	setlength(lengthMS, fadeMS);
+	setlength(cpu, lengthMS, fadeMS);
 
 	// patch illegal Chocobo Dungeon 2 code - CaitSith2 put a jump in the delay slot from a BNE
 	// and rely on Highly Experimental's buggy-ass CPU to rescue them.  Verified on real hardware
 	// that the initial code is wrong.
-	if (!strcmp(c->inf_game, "Chocobo Dungeon 2"))
+	if (!strcmp(cpu->c->inf_game, "Chocobo Dungeon 2"))
 	{
-		if (psx_ram[0xbc090/4] == LE32(0x0802f040))
+		if (cpu->psx_ram[0xbc090/4] == LE32(0x0802f040))
 		{
-			psx_ram[0xbc090/4] = LE32(0);
-			psx_ram[0xbc094/4] = LE32(0x0802f040);
-			psx_ram[0xbc098/4] = LE32(0);
+			cpu->psx_ram[0xbc090/4] = LE32(0);
+			cpu->psx_ram[0xbc094/4] = LE32(0x0802f040);
+			cpu->psx_ram[0xbc098/4] = LE32(0);
 		}
 	}
 
 //	psx_ram[0x118b8/4] = LE32(0);	// crash 2 hack
 
 	// backup the initial state for restart
-	memcpy(initial_ram, psx_ram, 2*1024*1024);
-	memcpy(initial_scratch, psx_scratch, 0x400);
-	initialPC = PC;
-	initialGP = GP;
-	initialSP = SP;
+	memcpy(cpu->initial_ram, cpu->psx_ram, 2*1024*1024);
+	memcpy(cpu->initial_scratch, cpu->psx_scratch, 0x400);
+	cpu->initialPC = PC;
+	cpu->initialGP = GP;
+	cpu->initialSP = SP;
 
-	mips_execute(5000);
+	mips_execute(cpu, 5000);
 
-	return AO_SUCCESS;
+	return cpu;
 }
 
-int32_t psf_execute(void (*update)(const void *, int))
+int32_t psf_execute(mips_cpu_context *cpu, void (*update)(const void *, int, void *), void *user)
 {
 	int i;
 
-	while (!stop_flag) {
+	while (!cpu->stop_flag) {
 		for (i = 0; i < 44100 / 60; i++) {
-			psx_hw_slice();
-			SPUasync(384, update);
+			psx_hw_slice(cpu);
+			SPUasync(cpu, 384, update, user);
 		}
 
-		psx_hw_frame();
+		psx_hw_frame(cpu);
 	}
 
 	return AO_SUCCESS;
 }
 
-int32_t psf_stop(void)
+int32_t psf_stop(mips_cpu_context *cpu)
 {
-	SPUclose();
-	free(c);
+	SPUclose(cpu);
+	SPUshutdown(cpu);
+	free(cpu->c);
+	delete cpu;
 
 	return AO_SUCCESS;
 }
@@ -62,7 +62,6 @@
 #include "corlett.h"
 
 #define DEBUG_LOADER	(0)
-#define MAX_FS		(32)	// maximum # of filesystems (libs and subdirectories)
 
 // ELF relocation helpers
 #define ELF32_R_SYM(val)                ((val) >> 8)
@@ -70,17 +69,6 @@
 
 #define LE32(x) FROM_LE32(x)
 
-static corlett_t	*c = nullptr;
-
-// main RAM
-static uint32_t initialPC, initialSP;
-static uint32_t loadAddr, lengthMS, fadeMS;
-
-static uint8_t *filesys[MAX_FS];
-static Index<char> lib_raw_file;
-static uint32_t fssize[MAX_FS];
-static int num_fs;
-
 static void do_iopmod(uint8_t *start, uint32_t offset)
 {
 	#if DEBUG_LOADER
@@ -100,7 +88,7 @@ static void do_iopmod(uint8_t *start, uint32_t offset)
 	#endif
 }
 
-uint32_t psf2_load_elf(uint8_t *start, uint32_t len)
+uint32_t psf2_load_elf(mips_cpu_context *cpu, uint8_t *start, uint32_t len)
 {
 	uint32_t entry, shoff, shentsize, shnum;
 	uint32_t type, addr, offset, size, shent;
@@ -108,16 +96,17 @@ uint32_t psf2_load_elf(uint8_t *start, uint32_t len)
 	uint32_t totallen;
 	uint32_t i;
 	uint32_t rec;
+	uint32_t hi16offs = 0, hi16target = 0;
 //	FILE *f;
 
-	if (loadAddr & 3)
+	if (cpu->loadAddr & 3)
 	{
-		loadAddr &= ~3;
-		loadAddr += 4;
+		cpu->loadAddr &= ~3;
+		cpu->loadAddr += 4;
 	}
 
 	#if DEBUG_LOADER
-	printf("psf2_load_elf: starting at %08x\n", loadAddr | 0x80000000);
+	printf("psf2_load_elf: starting at %08x\n", cpu->loadAddr | 0x80000000);
 	#endif
 
 	if ((start[0] != 0x7f) || (start[1] != 'E') || (start[2] != 'L') || (start[3] != 'F'))
@@ -160,7 +149,7 @@ uint32_t psf2_load_elf(uint8_t *start, uint32_t len)
 				break;
 
 			case 1:			// PROGBITS: copy data to destination
-				memcpy(&psx_ram[(loadAddr + addr)/4], &start[offset], size);
+				memcpy(&cpu->psx_ram[(cpu->loadAddr + addr)/4], &start[offset], size);
 				totallen += size;
 				break;
 
@@ -171,7 +160,7 @@ uint32_t psf2_load_elf(uint8_t *start, uint32_t len)
 				break;
 
 			case 8:			// NOBITS: BSS region, zero out destination
-				memset(&psx_ram[(loadAddr + addr)/4], 0, size);
+				memset(&cpu->psx_ram[(cpu->loadAddr + addr)/4], 0, size);
 				totallen += size;
 				break;
 
@@ -179,25 +168,24 @@ uint32_t psf2_load_elf(uint8_t *start, uint32_t len)
 		  		for (rec = 0; rec < (size/8); rec++)
 				{
 					uint32_t offs, info, target, temp, val, vallo;
-					static uint32_t hi16offs = 0, hi16target = 0;
 
 					offs = start[offset+(rec*8)] | start[offset+1+(rec*8)]<<8 | start[offset+2+(rec*8)]<<16 | start[offset+3+(rec*8)]<<24;
 					info = start[offset+4+(rec*8)] | start[offset+5+(rec*8)]<<8 | start[offset+6+(rec*8)]<<16 | start[offset+7+(rec*8)]<<24;
-					target = LE32(psx_ram[(loadAddr+offs)/4]);
+					target = LE32(cpu->psx_ram[(cpu->loadAddr+offs)/4]);
 
 //					printf("[%04d] offs %08x type %02x info %08x => %08x\n", rec, offs, ELF32_R_TYPE(info), ELF32_R_SYM(info), target);
 
 					switch (ELF32_R_TYPE(info))
 					{
 						case 2:	      	// R_MIPS_32
-							target += loadAddr;
+							target += cpu->loadAddr;
 //							target |= 0x80000000;
 							break;
 
 						case 4:		// R_MIPS_26
 							temp = (target & 0x03ffffff);
 							target &= 0xfc000000;
-							temp += (loadAddr>>2);
+							temp += (cpu->loadAddr>>2);
 							target |= temp;
 							break;
 
@@ -210,7 +198,7 @@ uint32_t psf2_load_elf(uint8_t *start, uint32_t len)
 							vallo = ((target & 0xffff) ^ 0x8000) - 0x8000;
 
 							val = ((hi16target & 0xffff) << 16) +	vallo;
-							val += loadAddr;
+							val += cpu->loadAddr;
 //							val |= 0x80000000;
 
 							/* Account for the sign extension that will happen in the low bits.  */
@@ -219,10 +207,10 @@ uint32_t psf2_load_elf(uint8_t *start, uint32_t len)
 							hi16target = (hi16target & ~0xffff) | val;
 
 							/* Ok, we're done with the HI16 relocs.  Now deal with the LO16.  */
-							val = loadAddr + vallo;
+							val = cpu->loadAddr + vallo;
 							target = (target & ~0xffff) | (val & 0xffff);
 
-							psx_ram[(loadAddr+hi16offs)/4] = LE32(hi16target);
+							cpu->psx_ram[(cpu->loadAddr+hi16offs)/4] = LE32(hi16target);
 							break;
 
 						default:
@@ -231,7 +219,7 @@ uint32_t psf2_load_elf(uint8_t *start, uint32_t len)
 							break;
 					}
 
-					psx_ram[(loadAddr+offs)/4] = LE32(target);
+					cpu->psx_ram[(cpu->loadAddr+offs)/4] = LE32(target);
 				}
 				break;
 
@@ -249,9 +237,9 @@ uint32_t psf2_load_elf(uint8_t *start, uint32_t len)
 		shent += shentsize;
 	}
 
-	entry += loadAddr;
+	entry += cpu->loadAddr;
 	entry |= 0x80000000;
-	loadAddr += totallen;
+	cpu->loadAddr += totallen;
 
 	#if DEBUG_LOADER
 	printf("psf2_load_elf: entry PC %08x\n", entry);
@@ -259,7 +247,7 @@ uint32_t psf2_load_elf(uint8_t *start, uint32_t len)
 	return entry;
 }
 
-static uint32_t load_file_ex(uint8_t *top, uint8_t *start, uint32_t len, const char *file, uint8_t *buf, uint32_t buflen)
+static uint32_t load_file_ex(mips_cpu_context *cpu, uint8_t *top, uint8_t *start, uint32_t len, const char *file, uint8_t *buf, uint32_t buflen)
 {
 	uint32_t numfiles, i, j;
 	uint8_t *cptr;
@@ -301,7 +289,7 @@ static uint32_t load_file_ex(uint8_t *top, uint8_t *start, uint32_t len, const c
 				#if DEBUG_LOADER
 				printf("Drilling into subdirectory [%s] with [%s] at offset %x\n", matchname, remainder, offs);
 				#endif
-				return load_file_ex(top, &top[offs], len-offs, remainder, buf, buflen);
+				return load_file_ex(cpu, top, &top[offs], len-offs, remainder, buf, buflen);
 			}
 
 			X = (uncomp + bsize - 1) / bsize;
@@ -338,9 +326,9 @@ static uint32_t load_file_ex(uint8_t *top, uint8_t *start, uint32_t len, const c
 	return 0xffffffff;
 }
 
-static uint32_t load_file(int fs, const char *file, uint8_t *buf, uint32_t buflen)
+static uint32_t load_file(mips_cpu_context *cpu, int fs, const char *file, uint8_t *buf, uint32_t buflen)
 {
-	return load_file_ex(filesys[fs], filesys[fs], fssize[fs], file, buf, buflen);
+	return load_file_ex(cpu, cpu->filesys[fs], cpu->filesys[fs], cpu->fssize[fs], file, buf, buflen);
 }
 
 #if 0
@@ -359,8 +347,8 @@ static dump_files(int fs, uint8_t *buf, uint32_t buflen)
 
 	printf("Dumping FS %d\n", fs);
 
-	start = filesys[fs];
-	len = fssize[fs];
+	start = cpu->filesys[fs];
+	len = cpu->fssize[fs];
 
 	cptr = start + 4;
 
@@ -417,14 +405,14 @@ static dump_files(int fs, uint8_t *buf, uint32_t buflen)
 #endif
 
 // find a file on our filesystems
-uint32_t psf2_load_file(const char *file, uint8_t *buf, uint32_t buflen)
+uint32_t psf2_load_file(mips_cpu_context *cpu, const char *file, uint8_t *buf, uint32_t buflen)
 {
 	int i;
 	uint32_t flen;
 
-	for (i = 0; i < num_fs; i++)
+	for (i = 0; i < cpu->num_fs; i++)
 	{
-		flen = load_file(i, file, buf, buflen);
+		flen = load_file(cpu, i, file, buf, buflen);
 		if (flen != 0xffffffff)
 		{
 			return flen;
@@ -434,8 +422,17 @@ uint32_t psf2_load_file(const char *file, uint8_t *buf, uint32_t buflen)
 	return 0xffffffff;
 }
 
-int32_t psf2_start(uint8_t *buffer, uint32_t length)
+static mips_cpu_context *psf2_fail(mips_cpu_context *cpu)
+{
+	free(cpu->c);
+	delete cpu;
+
+	return nullptr;
+}
+
+mips_cpu_context *psf2_start(const char *dirpath, uint8_t *buffer, uint32_t length, bool endless)
 {
+	mips_cpu_context *cpu = new mips_cpu_context();
 	uint8_t *file, *lib_decoded;
 	uint32_t irx_len;
 	uint64_t file_len, lib_len;
@@ -443,196 +440,197 @@ int32_t psf2_start(uint8_t *buffer, uint32_t length)
 	union cpuinfo mipsinfo;
 	corlett_t *lib;
 
-	loadAddr = 0x23f00;	// this value makes allocations work out similarly to how they would
+	cpu->loadAddr = 0x23f00;	// this value makes allocations work out similarly to how they would
 				// in Highly Experimental (as per Shadow Hearts' hard-coded assumptions)
 
 	// clear IOP work RAM before we start scribbling in it
-	memset(psx_ram, 0, 2*1024*1024);
+	memset(cpu->psx_ram, 0, 2*1024*1024);
 
 	// Decode the current PSF2
-	if (corlett_decode(buffer, length, &file, &file_len, &c) != AO_SUCCESS)
+	if (corlett_decode(buffer, length, &file, &file_len, &cpu->c) != AO_SUCCESS)
 	{
-		return AO_FAIL;
+		return psf2_fail(cpu);
 	}
 
 	if (file_len > 0)
 		printf ("ERROR: PSF2 can't have a program section!  ps %lx\n", (unsigned long) file_len);
 
 	#if DEBUG_LOADER
-	printf("FS section: size %x\n", c->res_size);
+	printf("FS section: size %x\n", cpu->c->res_size);
 	#endif
 
-	num_fs = 1;
-	filesys[0] = (uint8_t *)c->res_section;
-	fssize[0] = c->res_size;
+	cpu->num_fs = 1;
+	cpu->filesys[0] = (uint8_t *)cpu->c->res_section;
+	cpu->fssize[0] = cpu->c->res_size;
 
 	// Get the library file, if any
-	if (c->lib[0] != 0)
+	if (cpu->c->lib[0] != 0)
 	{
 		#if DEBUG_LOADER
-		printf("Loading library: %s\n", c->lib);
+		printf("Loading library: %s\n", cpu->c->lib);
 		#endif
 
-		lib_raw_file = ao_get_lib(c->lib);
+		cpu->lib_raw_file = ao_get_lib(dirpath, cpu->c->lib);
 
-		if (!lib_raw_file.len())
-			return AO_FAIL;
+		if (!cpu->lib_raw_file.len())
+			return psf2_fail(cpu);
 
-		if (corlett_decode((uint8_t *)lib_raw_file.begin(), lib_raw_file.len(),
+		if (corlett_decode((uint8_t *)cpu->lib_raw_file.begin(), cpu->lib_raw_file.len(),
 		 &lib_decoded, &lib_len, &lib) != AO_SUCCESS)
-			return AO_FAIL;
+			return psf2_fail(cpu);
 
 		#if DEBUG_LOADER
 		printf("Lib FS section: size %x bytes\n", lib->res_size);
 		#endif
 
-		num_fs++;
-		filesys[1] = (uint8_t *)lib->res_section;
- 		fssize[1] = lib->res_size;
+		cpu->num_fs++;
+		cpu->filesys[1] = (uint8_t *)lib->res_section;
+ 		cpu->fssize[1] = lib->res_size;
 	}
 
 	// dump all files
 	#if 0
 	buf = (uint8_t *)malloc(16*1024*1024);
 	dump_files(0, buf, 16*1024*1024);
-	if (c->lib[0] != 0)
+	if (cpu->c->lib[0] != 0)
 		dump_files(1, buf, 16*1024*1024);
 	free(buf);
 	#endif
 
 	// load psf2.irx, which kicks everything off
 	buf = (uint8_t *)malloc(512*1024);
-	irx_len = psf2_load_file("psf2.irx", buf, 512*1024);
+	irx_len = psf2_load_file(cpu, "psf2.irx", buf, 512*1024);
 
 	if (irx_len != 0xffffffff)
 	{
-		initialPC = psf2_load_elf(buf, irx_len);
-		initialSP = 0x801ffff0;
+		cpu->initialPC = psf2_load_elf(cpu, buf, irx_len);
+		cpu->initialSP = 0x801ffff0;
 	}
 	free(buf);
 
-	if (initialPC == 0xffffffff)
+	if (cpu->initialPC == 0xffffffff)
 	{
-		return AO_FAIL;
+		return psf2_fail(cpu);
 	}
 
-	lengthMS = psfTimeToMS(c->inf_length);
-	fadeMS = psfTimeToMS(c->inf_fade);
-	if (lengthMS == 0)
+	cpu->lengthMS = psfTimeToMS(cpu->c->inf_length);
+	cpu->fadeMS = psfTimeToMS(cpu->c->inf_fade);
+	if (cpu->lengthMS == 0)
 	{
-		lengthMS = ~0;
+		cpu->lengthMS = ~0;
 	}
-	setlength2(lengthMS, fadeMS);
 
-	mips_init();
-	mips_reset(nullptr);
+	mips_init(cpu);
+	mips_reset(cpu, nullptr);
 
-	mipsinfo.i = initialPC;
-	mips_set_info(CPUINFO_INT_PC, &mipsinfo);
+	mipsinfo.i = cpu->initialPC;
+	mips_set_info(cpu, CPUINFO_INT_PC, &mipsinfo);
 
-	mipsinfo.i = initialSP;
-	mips_set_info(CPUINFO_INT_REGISTER + MIPS_R29, &mipsinfo);
-	mips_set_info(CPUINFO_INT_REGISTER + MIPS_R30, &mipsinfo);
+	mipsinfo.i = cpu->initialSP;
+	mips_set_info(cpu, CPUINFO_INT_REGISTER + MIPS_R29, &mipsinfo);
+	mips_set_info(cpu, CPUINFO_INT_REGISTER + MIPS_R30, &mipsinfo);
 
 	// set RA
 	mipsinfo.i = 0x80000000;
-	mips_set_info(CPUINFO_INT_REGISTER + MIPS_R31, &mipsinfo);
+	mips_set_info(cpu, CPUINFO_INT_REGISTER + MIPS_R31, &mipsinfo);
 
 	// set A0 & A1 to point to "aofile:/"
 	mipsinfo.i = 2;	// argc
-	mips_set_info(CPUINFO_INT_REGISTER + MIPS_R4, &mipsinfo);
+	mips_set_info(cpu, CPUINFO_INT_REGISTER + MIPS_R4, &mipsinfo);
 
 	mipsinfo.i = 0x80000004;	// argv
-	mips_set_info(CPUINFO_INT_REGISTER + MIPS_R5, &mipsinfo);
-	psx_ram[1] = LE32(0x80000008);
+	mips_set_info(cpu, CPUINFO_INT_REGISTER + MIPS_R5, &mipsinfo);
+	cpu->psx_ram[1] = LE32(0x80000008);
 
-	buf = (uint8_t *)&psx_ram[2];
+	buf = (uint8_t *)&cpu->psx_ram[2];
 	strcpy((char *)buf, "aofile:/");
 
-	psx_ram[0] = LE32(FUNCT_HLECALL);
+	cpu->psx_ram[0] = LE32(FUNCT_HLECALL);
 
 	// back up initial RAM image to quickly restart songs
-	memcpy(initial_ram, psx_ram, 2*1024*1024);
+	memcpy(cpu->initial_ram, cpu->psx_ram, 2*1024*1024);
 
-	psx_hw_init();
-	SPU2init();
-	SPU2open(nullptr);
+	psx_hw_init(cpu);
+	SPU2init(cpu);
+	SPU2open(cpu, nullptr);
+	setendless2(cpu, endless);
+	setlength2(cpu, cpu->lengthMS, cpu->fadeMS);
 
-	return AO_SUCCESS;
+	return cpu;
 }
 
-int32_t psf2_execute(void (*update)(const void *, int))
+int32_t psf2_execute(mips_cpu_context *cpu, void (*update)(const void *, int, void *), void *user)
 {
 	int i;
 
-	while (!stop_flag)
+	while (!cpu->stop_flag)
 	{
 		for (i = 0; i < 44100 / 60; i++)
 		{
-			SPU2async(update);
-			ps2_hw_slice();
+			SPU2async(cpu, update, user);
+			ps2_hw_slice(cpu);
 		}
 
-		ps2_hw_frame();
+		ps2_hw_frame(cpu);
 	}
 
 	return AO_SUCCESS;
 }
 
-int32_t psf2_stop(void)
+int32_t psf2_stop(mips_cpu_context *cpu)
 {
-	SPU2close();
-	lib_raw_file.clear();
-	free(c);
+	SPU2close(cpu);
+	SPU2shutdown(cpu);
+	free(cpu->c);
+	delete cpu;
 
 	return AO_SUCCESS;
 }
 
-int32_t psf2_command(int32_t command, int32_t parameter)
+int32_t psf2_command(mips_cpu_context *cpu, int32_t command, int32_t parameter)
 {
 	union cpuinfo mipsinfo;
-	uint32_t lengthMS, fadeMS;
 
 	switch (command)
 	{
 		case COMMAND_RESTART:
-			SPU2close();
+			SPU2close(cpu);
 
-			memcpy(psx_ram, initial_ram, 2*1024*1024);
+			memcpy(cpu->psx_ram, cpu->initial_ram, 2*1024*1024);
 
-			mips_init();
-			mips_reset(nullptr);
-			psx_hw_init();
-			SPU2init();
-			SPU2open(nullptr);
+			mips_init(cpu);
+			mips_reset(cpu, nullptr);
+			psx_hw_init(cpu);
+			SPU2init(cpu);
+			SPU2open(cpu, nullptr);
 
-			mipsinfo.i = initialPC;
-			mips_set_info(CPUINFO_INT_PC, &mipsinfo);
+			mipsinfo.i = cpu->initialPC;
+			mips_set_info(cpu, CPUINFO_INT_PC, &mipsinfo);
 
-			mipsinfo.i = initialSP;
-			mips_set_info(CPUINFO_INT_REGISTER + MIPS_R29, &mipsinfo);
-			mips_set_info(CPUINFO_INT_REGISTER + MIPS_R30, &mipsinfo);
+			mipsinfo.i = cpu->initialSP;
+			mips_set_info(cpu, CPUINFO_INT_REGISTER + MIPS_R29, &mipsinfo);
+			mips_set_info(cpu, CPUINFO_INT_REGISTER + MIPS_R30, &mipsinfo);
 
 			// set RA
 			mipsinfo.i = 0x80000000;
-			mips_set_info(CPUINFO_INT_REGISTER + MIPS_R31, &mipsinfo);
+			mips_set_info(cpu, CPUINFO_INT_REGISTER + MIPS_R31, &mipsinfo);
 
 			// set A0 & A1 to point to "aofile:/"
 			mipsinfo.i = 2;	// argc
-			mips_set_info(CPUINFO_INT_REGISTER + MIPS_R4, &mipsinfo);
+			mips_set_info(cpu, CPUINFO_INT_REGISTER + MIPS_R4, &mipsinfo);
 
 			mipsinfo.i = 0x80000004;	// argv
-			mips_set_info(CPUINFO_INT_REGISTER + MIPS_R5, &mipsinfo);
+			mips_set_info(cpu, CPUINFO_INT_REGISTER + MIPS_R5, &mipsinfo);
 
-			psx_hw_init();
+			psx_hw_init(cpu);
 
-			lengthMS = psfTimeToMS(c->inf_length);
-			fadeMS = psfTimeToMS(c->inf_fade);
-			if (lengthMS == 0)
+			cpu->lengthMS = psfTimeToMS(cpu->c->inf_length);
+			cpu->fadeMS = psfTimeToMS(cpu->c->inf_fade);
+			if (cpu->lengthMS == 0)
 			{
-				lengthMS = ~0;
+				cpu->lengthMS = ~0;
 			}
-			setlength2(lengthMS, fadeMS);
+			setlength2(cpu, cpu->lengthMS, cpu->fadeMS);
 
 			return AO_SUCCESS;
 
@@ -640,12 +638,12 @@ int32_t psf2_command(int32_t command, int32_t parameter)
 	return AO_FAIL;
 }
 
-uint32_t psf2_get_loadaddr(void)
+uint32_t psf2_get_loadaddr(mips_cpu_context *cpu)
 {
-	return loadAddr;
+	return cpu->loadAddr;
 }
 
-void psf2_set_loadaddr(uint32_t addr)
+void psf2_set_loadaddr(mips_cpu_context *cpu, uint32_t addr)
 {
-	loadAddr = addr;
+	cpu->loadAddr = addr;
 }
@@ -44,150 +44,149 @@
 #include "peops/registers.h"
 #include "peops/spu.h"
 
-static uint8_t *start_of_file, *song_ptr;
-static uint32_t cur_tick, cur_event, num_events, next_tick, end_tick;
-static int old_fmt;
-static char name[128], song[128], company[128];
-
-int32_t spx_start(uint8_t *buffer, uint32_t length)
+mips_cpu_context *spx_start(const char *dirpath, uint8_t *buffer, uint32_t length, bool endless)
 {
 	int i;
 	uint16_t reg;
+	mips_cpu_context *cpu;
 
 	if (strncmp((char *)buffer, "SPU", 3) && strncmp((char *)buffer, "SPX", 3))
 	{
-		return AO_FAIL;
+		return nullptr;
 	}
 
-	start_of_file = buffer;
+	cpu = new mips_cpu_context();
+
+	cpu->start_of_file = buffer;
 
-	SPUinit();
-	SPUopen();
-	setlength(~0, 0);
+	SPUinit(cpu);
+	SPUopen(cpu);
+	setendless(cpu, endless);
+	setlength(cpu, ~0, 0);
 
 	// upload the SPU RAM image
-	SPUinjectRAMImage((unsigned short *)&buffer[0]);
+	SPUinjectRAMImage(cpu, (unsigned short *)&buffer[0]);
 
 	// apply the register image
 	for (i = 0; i < 512; i += 2)
 	{
 		reg = buffer[0x80000+i] | buffer[0x80000+i+1]<<8;
 
-		SPUwriteRegister((i/2)+0x1f801c00, reg);
+		SPUwriteRegister(cpu, (i/2)+0x1f801c00, reg);
 	}
 
-	old_fmt = 1;
+	cpu->old_fmt = 1;
 
 	if ((buffer[0x80200] != 0x44) || (buffer[0x80201] != 0xac) || (buffer[0x80202] != 0x00) || (buffer[0x80203] != 0x00))
 	{
-		old_fmt = 0;
+		cpu->old_fmt = 0;
 	}
 
-	if (old_fmt)
+	if (cpu->old_fmt)
 	{
-		num_events = buffer[0x80204] | buffer[0x80205]<<8 | buffer[0x80206]<<16 | buffer[0x80207]<<24;
+		cpu->num_events = buffer[0x80204] | buffer[0x80205]<<8 | buffer[0x80206]<<16 | buffer[0x80207]<<24;
 
-		if (((num_events * 12) + 0x80208) > length)
+		if (((cpu->num_events * 12) + 0x80208) > length)
 		{
-			old_fmt = 0;
+			cpu->old_fmt = 0;
 		}
 		else
 		{
-			cur_tick = 0;
+			cpu->cur_tick = 0;
 		}
 	}
 
-	if (!old_fmt)
+	if (!cpu->old_fmt)
 	{
-		end_tick = buffer[0x80200] | buffer[0x80201]<<8 | buffer[0x80202]<<16 | buffer[0x80203]<<24;
-		cur_tick = buffer[0x80204] | buffer[0x80205]<<8 | buffer[0x80206]<<16 | buffer[0x80207]<<24;
-		next_tick = cur_tick;
+		cpu->end_tick = buffer[0x80200] | buffer[0x80201]<<8 | buffer[0x80202]<<16 | buffer[0x80203]<<24;
+		cpu->cur_tick = buffer[0x80204] | buffer[0x80205]<<8 | buffer[0x80206]<<16 | buffer[0x80207]<<24;
+		cpu->next_tick = cpu->cur_tick;
 	}
 
-	song_ptr = &buffer[0x80208];
-	cur_event = 0;
+	cpu->song_ptr = &buffer[0x80208];
+	cpu->cur_event = 0;
 
-	strncpy((char *)&buffer[4], name, 128);
-	strncpy((char *)&buffer[0x44], song, 128);
-	strncpy((char *)&buffer[0x84], company, 128);
+	strncpy((char *)&buffer[4], cpu->name, 128);
+	strncpy((char *)&buffer[0x44], cpu->song, 128);
+	strncpy((char *)&buffer[0x84], cpu->company, 128);
 
-	return AO_SUCCESS;
+	return cpu;
 }
 
-static void spx_tick(void)
+static void spx_tick(mips_cpu_context *cpu)
 {
 	uint32_t time, reg, size;
 	uint16_t rdata;
 	uint8_t opcode;
 
-	if (old_fmt)
+	if (cpu->old_fmt)
 	{
-		time = song_ptr[0] | song_ptr[1]<<8 | song_ptr[2]<<16 | song_ptr[3]<<24;
+		time = cpu->song_ptr[0] | cpu->song_ptr[1]<<8 | cpu->song_ptr[2]<<16 | cpu->song_ptr[3]<<24;
 
-		while ((time == cur_tick) && (cur_event < num_events))
+		while ((time == cpu->cur_tick) && (cpu->cur_event < cpu->num_events))
 		{
-			reg = song_ptr[4] | song_ptr[5]<<8 | song_ptr[6]<<16 | song_ptr[7]<<24;
-			rdata = song_ptr[8] | song_ptr[9]<<8;
+			reg = cpu->song_ptr[4] | cpu->song_ptr[5]<<8 | cpu->song_ptr[6]<<16 | cpu->song_ptr[7]<<24;
+			rdata = cpu->song_ptr[8] | cpu->song_ptr[9]<<8;
 
-			SPUwriteRegister(reg, rdata);
+			SPUwriteRegister(cpu, reg, rdata);
 
-			cur_event++;
-			song_ptr += 12;
+			cpu->cur_event++;
+			cpu->song_ptr += 12;
 
-			time = song_ptr[0] | song_ptr[1]<<8 | song_ptr[2]<<16 | song_ptr[3]<<24;
+			time = cpu->song_ptr[0] | cpu->song_ptr[1]<<8 | cpu->song_ptr[2]<<16 | cpu->song_ptr[3]<<24;
 		}
 	}
 	else
 	{
-		if (cur_tick < end_tick)
+		if (cpu->cur_tick < cpu->end_tick)
 		{
-			while (cur_tick == next_tick)
+			while (cpu->cur_tick == cpu->next_tick)
 			{
-				opcode = song_ptr[0];
-				song_ptr++;
+				opcode = cpu->song_ptr[0];
+				cpu->song_ptr++;
 
 				switch (opcode)
 				{
 					case 0:	// write register
-						reg = song_ptr[0] | song_ptr[1]<<8 | song_ptr[2]<<16 | song_ptr[3]<<24;
-						rdata = song_ptr[4] | song_ptr[5]<<8;
+						reg = cpu->song_ptr[0] | cpu->song_ptr[1]<<8 | cpu->song_ptr[2]<<16 | cpu->song_ptr[3]<<24;
+						rdata = cpu->song_ptr[4] | cpu->song_ptr[5]<<8;
 
-						SPUwriteRegister(reg, rdata);
+						SPUwriteRegister(cpu, reg, rdata);
 
-						next_tick = song_ptr[6] | song_ptr[7]<<8 | song_ptr[8]<<16 | song_ptr[9]<<24;
-						song_ptr += 10;
+						cpu->next_tick = cpu->song_ptr[6] | cpu->song_ptr[7]<<8 | cpu->song_ptr[8]<<16 | cpu->song_ptr[9]<<24;
+						cpu->song_ptr += 10;
 						break;
 
 					case 1:	// read register
-				 		reg = song_ptr[0] | song_ptr[1]<<8 | song_ptr[2]<<16 | song_ptr[3]<<24;
-						SPUreadRegister(reg);
-						next_tick = song_ptr[4] | song_ptr[5]<<8 | song_ptr[6]<<16 | song_ptr[7]<<24;
-						song_ptr += 8;
+				 		reg = cpu->song_ptr[0] | cpu->song_ptr[1]<<8 | cpu->song_ptr[2]<<16 | cpu->song_ptr[3]<<24;
+						SPUreadRegister(cpu, reg);
+						cpu->next_tick = cpu->song_ptr[4] | cpu->song_ptr[5]<<8 | cpu->song_ptr[6]<<16 | cpu->song_ptr[7]<<24;
+						cpu->song_ptr += 8;
 						break;
 
 					case 2: // dma write
-						size = song_ptr[0] | song_ptr[1]<<8 | song_ptr[2]<<16 | song_ptr[3]<<24;
-						song_ptr += (4 + size);
-						next_tick = song_ptr[0] | song_ptr[1]<<8 | song_ptr[2]<<16 | song_ptr[3]<<24;
-						song_ptr += 4;
+						size = cpu->song_ptr[0] | cpu->song_ptr[1]<<8 | cpu->song_ptr[2]<<16 | cpu->song_ptr[3]<<24;
+						cpu->song_ptr += (4 + size);
+						cpu->next_tick = cpu->song_ptr[0] | cpu->song_ptr[1]<<8 | cpu->song_ptr[2]<<16 | cpu->song_ptr[3]<<24;
+						cpu->song_ptr += 4;
 						break;
 
 					case 3: // dma read
-						next_tick = song_ptr[4] | song_ptr[5]<<8 | song_ptr[6]<<16 | song_ptr[7]<<24;
-						song_ptr += 8;
+						cpu->next_tick = cpu->song_ptr[4] | cpu->song_ptr[5]<<8 | cpu->song_ptr[6]<<16 | cpu->song_ptr[7]<<24;
+						cpu->song_ptr += 8;
 						break;
 
 					case 4: // xa play
-						song_ptr += (32 + 16384);
-						next_tick = song_ptr[0] | song_ptr[1]<<8 | song_ptr[2]<<16 | song_ptr[3]<<24;
-						song_ptr += 4;
+						cpu->song_ptr += (32 + 16384);
+						cpu->next_tick = cpu->song_ptr[0] | cpu->song_ptr[1]<<8 | cpu->song_ptr[2]<<16 | cpu->song_ptr[3]<<24;
+						cpu->song_ptr += 4;
 						break;
 
 					case 5: // cdda play
-						size = song_ptr[0] | song_ptr[1]<<8 | song_ptr[2]<<16 | song_ptr[3]<<24;
-						song_ptr += (4 + size);
-						next_tick = song_ptr[0] | song_ptr[1]<<8 | song_ptr[2]<<16 | song_ptr[3]<<24;
-						song_ptr += 4;
+						size = cpu->song_ptr[0] | cpu->song_ptr[1]<<8 | cpu->song_ptr[2]<<16 | cpu->song_ptr[3]<<24;
+						cpu->song_ptr += (4 + size);
+						cpu->next_tick = cpu->song_ptr[0] | cpu->song_ptr[1]<<8 | cpu->song_ptr[2]<<16 | cpu->song_ptr[3]<<24;
+						cpu->song_ptr += 4;
 						break;
 
 					default:
@@ -199,26 +198,26 @@ static void spx_tick(void)
 		}
 	}
 
-	cur_tick++;
+	cpu->cur_tick++;
 }
 
-int32_t spx_execute(void (*update)(const void *, int))
+int32_t spx_execute(mips_cpu_context *cpu, void (*update)(const void *, int, void *), void *user)
 {
 	int i, run = 1;
 
-	while (!stop_flag)
+	while (!cpu->stop_flag)
 	{
-		if (old_fmt && (cur_event >= num_events))
+		if (cpu->old_fmt && (cpu->cur_event >= cpu->num_events))
 			run = 0;
-		else if (cur_tick >= end_tick)
+		else if (cpu->cur_tick >= cpu->end_tick)
 			run = 0;
 
 		if (run)
 		{
 			for (i = 0; i < 44100 / 60; i++)
 			{
-			  	spx_tick();
-				SPUasync(384, update);
+			  	spx_tick(cpu);
+				SPUasync(cpu, 384, update, user);
 			}
 		}
 	}
@@ -226,9 +225,11 @@ int32_t spx_execute(void (*update)(const void *, int))
 	return AO_SUCCESS;
 }
 
-int32_t spx_stop(void)
+int32_t spx_stop(mips_cpu_context *cpu)
 {
-	SPUclose();
+	SPUclose(cpu);
+	SPUshutdown(cpu);
+	delete cpu;
 
 	return AO_SUCCESS;
 }
@@ -26,5 +26,5 @@
 
 #include <stdint.h>
 
-void SPUwriteDMAMem(uint32_t usPSXMem, int iSize);
-void SPUreadDMAMem(uint32_t usPSXMem, int iSize);
+void SPUwriteDMAMem(mips_cpu_context *cpu, uint32_t usPSXMem, int iSize);
+void SPUreadDMAMem(mips_cpu_context *cpu, uint32_t usPSXMem, int iSize);
@@ -197,4 +197,53 @@ typedef struct
  int IN_COEF_R;      // (coef.)
 } REVERBInfo;
 
+///////////////////////////////////////////////////////////
+
+// SPU STATE, one per emulated PSX (hangs off mips_cpu_context)
+typedef struct spu_state_t
+{
+ // psx buffer / addresses
+ u16               regArea[0x200];
+ u16               spuMem[256*1024];
+ u8 *              spuMemC;
+ u8 *              pSpuIrq;
+ u8 *              pSpuBuffer;
+
+ // user settings
+ int               iVolume;
+
+ // MAIN infos struct for each channel
+ SPUCHAN           s_chan[MAXCHAN+1];                  // channel + 1 infos (1 is security for fmod handling)
+ REVERBInfo        rvb;
+
+ u32               dwNoiseVal;                         // global noise generator
+
+ u16               spuCtrl;                            // some vars to store psx reg infos
+ u16               spuStat;
+ u16               spuIrq;
+ u32               spuAddr;                            // address into spu mem
+ int               bSPUIsOpen;
+
+ s16 *             pS;
+ s32               ttemp;
+
+ u32               sampcount;
+ u32               decaybegin;
+ u32               decayend;
+ u32               seektime;
+ int               endless;
+
+ // reverb.cc
+ s32               downbuf[2][8];
+ s32               upbuf[2][8];
+ int               dbpos,ubpos;
+
+ // adsr.cc
+ u32               RateTable[160];
+
+#ifdef TIMEO
+ u64               begintime;
+#endif
+} spu_state_t;
+
 #endif // PEOPS_EXTERNALS
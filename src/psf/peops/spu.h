@@ -26,17 +26,17 @@
 
 void SPUirq(void);
 
-int psf_seek(uint32_t t);
-void setendless(int e);
-void setlength(int32_t stop, int32_t fade);
+int psf_seek(mips_cpu_context *cpu, uint32_t t);
+void setendless(mips_cpu_context *cpu, int e);
+void setlength(mips_cpu_context *cpu, int32_t stop, int32_t fade);
 
-int SPUasync(uint32_t cycles, void (*update)(const void *, int));
+int SPUasync(mips_cpu_context *cpu, uint32_t cycles, void (*update)(const void *, int, void *), void *user);
 void SPU_flushboot(void);
-int SPUinit(void);
-int SPUopen(void);
-int SPUclose(void);
-int SPUshutdown(void);
-void SPUinjectRAMImage(uint16_t *pIncoming);
-void SPUreadDMAMem(uint32_t usPSXMem, int iSize);
-void SPUwriteDMAMem(uint32_t usPSXMem, int iSize);
-uint16_t SPUreadRegister(uint32_t reg);
+int SPUinit(mips_cpu_context *cpu);
+int SPUopen(mips_cpu_context *cpu);
+int SPUclose(mips_cpu_context *cpu);
+int SPUshutdown(mips_cpu_context *cpu);
+void SPUinjectRAMImage(mips_cpu_context *cpu, uint16_t *pIncoming);
+void SPUreadDMAMem(mips_cpu_context *cpu, uint32_t usPSXMem, int iSize);
+void SPUwriteDMAMem(mips_cpu_context *cpu, uint32_t usPSXMem, int iSize);
+uint16_t SPUreadRegister(mips_cpu_context *cpu, uint32_t reg);
@@ -24,5 +24,5 @@
 //
 //*************************************************************************//
 
-void StartADSR(int ch);
-int  MixADSR(int ch);
+void StartADSR(spu2_state_t *spu, int ch);
+int  MixADSR(spu2_state_t *spu, int ch);
@@ -26,12 +26,12 @@
 
 #include <stdint.h>
 
-void InterruptDMA4(void);
-void InterruptDMA7(void);
+void InterruptDMA4(spu2_state_t *spu);
+void InterruptDMA7(spu2_state_t *spu);
 
-void SPU2readDMA4Mem(uint32_t usPSXMem,int iSize);
-void SPU2writeDMA4Mem(uint32_t usPSXMem,int iSize);
-void SPU2readDMA7Mem(uint32_t usPSXMem,int iSize);
-void SPU2writeDMA7Mem(uint32_t usPSXMem,int iSize);
-void SPU2interruptDMA4(void);
-void SPU2interruptDMA7(void);
+void SPU2readDMA4Mem(mips_cpu_context *cpu, uint32_t usPSXMem,int iSize);
+void SPU2writeDMA4Mem(mips_cpu_context *cpu, uint32_t usPSXMem,int iSize);
+void SPU2readDMA7Mem(mips_cpu_context *cpu, uint32_t usPSXMem,int iSize);
+void SPU2writeDMA7Mem(mips_cpu_context *cpu, uint32_t usPSXMem,int iSize);
+void SPU2interruptDMA4(mips_cpu_context *cpu);
+void SPU2interruptDMA7(mips_cpu_context *cpu);
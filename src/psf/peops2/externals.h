@@ -252,14 +252,6 @@ typedef struct
 
 #ifndef _IN_SPU
 
-// psx buffers / addresses
-
-extern unsigned short  regArea[];
-extern unsigned short  spuMem[];
-extern unsigned char * spuMemC;
-extern unsigned char * pSpuIrq[];
-extern unsigned char * pSpuBuffer;
-
 // user settings
 
 extern int        iUseXA;
@@ -272,31 +264,6 @@ extern int        iRecordMode;
 extern int        iUseReverb;
 extern int        iUseInterpolation;
 extern int        iDisStereo;
-// MISC
-
-extern SPUCHAN2 s_chan[];
-extern REVERBInfo2 rvb[];
-
-extern unsigned long dwNoiseVal;
-extern unsigned short spuCtrl2[];
-extern unsigned short spuStat2[];
-extern unsigned long  spuIrq2[];
-extern unsigned long  spuAddr2[];
-extern unsigned long   spuRvbAddr2[];
-extern unsigned long   spuRvbAEnd2[];
-
-extern int      bEndThread;
-extern int      bThreadEnded;
-extern int      bSpuInit;
-
-extern int      SSumR[];
-extern int      SSumL[];
-extern int      iCycle;
-extern short *  pS;
-extern unsigned long dwNewChannel2[];
-extern unsigned long dwEndChannel2[];
-
-extern int iSpuAsyncWait;
 
 #ifdef _WINDOWS
 //extern HWND    hWMain;                               // window handle
@@ -366,15 +333,60 @@ extern int           iRightXAVol;
 #endif
 
 ///////////////////////////////////////////////////////////
-// REVERB.C globals
+// SPU2 STATE, one per emulated PS2 IOP (hangs off mips_cpu_context)
 ///////////////////////////////////////////////////////////
 
-#ifndef _IN_REVERB
-
-extern int *          sRVBPlay[];
-extern int *          sRVBEnd[];
-extern int *          sRVBStart[];
-
-#endif
+typedef struct spu2_state_t
+{
+ // psx buffers / addresses
+ unsigned short  regArea[32*1024];
+ unsigned short  spuMem[1*1024*1024];
+ unsigned char * spuMemC;
+ unsigned char * pSpuIrq[2];
+ unsigned char * pSpuBuffer;
+
+ // MAIN infos struct for each channel
+ SPUCHAN2        s_chan[MAXCHAN+1];                     // channel + 1 infos (1 is security for fmod handling)
+ REVERBInfo2     rvb[2];
+
+ unsigned long   dwNoiseVal;                            // global noise generator
+
+ unsigned short  spuCtrl2[2];                           // some vars to store psx reg infos
+ unsigned short  spuStat2[2];
+ unsigned long   spuIrq2[2];
+ unsigned long   spuAddr2[2];                           // address into spu mem
+ unsigned long   spuRvbAddr2[2];
+ unsigned long   spuRvbAEnd2[2];
+ int             bEndThread;                            // thread handlers
+ int             bThreadEnded;
+ int             bSpuInit;
+ int             bSPUIsOpen;
+
+ unsigned long   dwNewChannel2[2];                      // flags for faster testing, if new channel starts
+ unsigned long   dwEndChannel2[2];
+
+ int             SSumR[NSSIZE];
+ int             SSumL[NSSIZE];
+ short *         pS;
+
+ int             lastch;                                // last channel processed on spu irq in timer mode
+ int             iSecureStart;                          // secure start counter
+
+ u32             sampcount;
+ u32             decaybegin;
+ u32             decayend;
+ u32             seektime;
+ int             endless;
+
+ int             iSpuAsyncWait;
+
+ // reverb.cc
+ int *           sRVBPlay[2];
+ int *           sRVBEnd[2];
+ int *           sRVBStart[2];
+
+ // adsr.cc
+ unsigned long   RateTable[160];
+} spu2_state_t;
 
 #endif // PEOPS2_EXTERNALS
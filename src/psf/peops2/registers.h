@@ -150,8 +150,8 @@
 #define H_ExtRight       0x0db6
 #define H_Reverb         0x0dc0
 
-unsigned short SPU2read(unsigned long reg);
-void SPU2write(unsigned long reg, unsigned short val);
+unsigned short SPU2read(mips_cpu_context *cpu, unsigned long reg);
+void SPU2write(mips_cpu_context *cpu, unsigned long reg, unsigned short val);
 
 //###########################################################################
 
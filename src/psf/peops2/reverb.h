@@ -28,7 +28,7 @@
 //*************************************************************************//
 
 
-void StartREVERB(int ch);
-void StoreREVERB(int ch,int ns);
-int MixREVERBLeft(int ns,int core);
-int MixREVERBRight(int core);
+void StartREVERB(spu2_state_t *spu, int ch);
+void StoreREVERB(spu2_state_t *spu, int ch,int ns);
+int MixREVERBLeft(spu2_state_t *spu, int ns,int core);
+int MixREVERBRight(spu2_state_t *spu, int core);
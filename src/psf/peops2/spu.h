@@ -27,12 +27,13 @@
 //
 //*************************************************************************//
 
-void setendless2(int e);
-void setlength2(int32_t stop, int32_t fade);
+void setendless2(mips_cpu_context *cpu, int e);
+void setlength2(mips_cpu_context *cpu, int32_t stop, int32_t fade);
 
-long SPU2init(void);
-long SPU2open(void *pDsp);
-void SPU2async(void (*update)(const void *, int));
-void SPU2close(void);
+long SPU2init(mips_cpu_context *cpu);
+long SPU2open(mips_cpu_context *cpu, void *pDsp);
+void SPU2async(mips_cpu_context *cpu, void (*update)(const void *, int, void *), void *user);
+void SPU2close(mips_cpu_context *cpu);
+void SPU2shutdown(mips_cpu_context *cpu);
 
-int psf2_seek(uint32_t t);
+int psf2_seek(mips_cpu_context *cpu, uint32_t t);
@@ -41,6 +41,11 @@
 #include "peops/spu.h"
 #include "peops2/spu.h"
 
+#include "../render-common/measure.h"
+
+/* how long to render a file without a length before giving up on it */
+#define MEASURE_MAX_LENGTH (5 * 60 * 1000)
+
 class PSFPlugin : public InputPlugin
 {
 public:
@@ -67,7 +72,7 @@ public:
     bool play(const char *filename, VFSFile &file);
 
 protected:
-    static void update(const void *data, int bytes);
+    static void update(const void *data, int bytes, void *user);
 };
 
 EXPORT PSFPlugin aud_plugin_instance;
@@ -81,10 +86,10 @@ typedef enum {
 } PSFEngine;
 
 typedef struct {
-    int32_t (*start)(uint8_t *buffer, uint32_t length);
-    int32_t (*stop)(void);
-    int32_t (*seek)(uint32_t);
-    int32_t (*execute)(void (*update)(const void *, int));
+    mips_cpu_context *(*start)(const char *dirpath, uint8_t *buffer, uint32_t length, bool endless);
+    int32_t (*stop)(mips_cpu_context *cpu);
+    int32_t (*seek)(mips_cpu_context *cpu, uint32_t);
+    int32_t (*execute)(mips_cpu_context *cpu, void (*update)(const void *, int, void *), void *user);
 } PSFEngineFunctors;
 
 static PSFEngineFunctors psf_functor_map[ENG_COUNT] = {
@@ -97,6 +102,7 @@ static PSFEngineFunctors psf_functor_map[ENG_COUNT] = {
 const char* const PSFPlugin::defaults[] =
 {
     "ignore_length", "FALSE",
+    "measure", "FALSE",
     nullptr
 };
 
@@ -106,15 +112,17 @@ bool PSFPlugin::init()
     return true;
 }
 
-static PSFEngineFunctors *f;
-static String dirpath;
+/* Everything a single playback needs; each play() call has its own, so several
+ * files can be decoded at once. */
+struct PSFPlayback {
+    PSFEngineFunctors *f;
+    mips_cpu_context *cpu;
 
-bool stop_flag = false;
-
-/* The emulation engine can only seek forward, not back.  This variable is set
- * a non-negative time (milliseconds) when the song is to be restarted in order
- * to seek backward. */
-static int reverse_seek;
+    /* The emulation engine can only seek forward, not back.  This variable is
+     * set a non-negative time (milliseconds) when the song is to be restarted
+     * in order to seek backward. */
+    int reverse_seek;
+};
 
 static PSFEngine psf_probe(const char *buf, int len)
 {
@@ -136,13 +144,71 @@ static PSFEngine psf_probe(const char *buf, int len)
     return ENG_NONE;
 }
 
+static String get_dirpath(const char *filename)
+{
+    const char * slash = strrchr (filename, '/');
+    if (! slash)
+        return String ();
+
+    return String (str_copy (filename, slash + 1 - filename));
+}
+
 /* ao_get_lib: called to load secondary files */
-Index<char> ao_get_lib(char *filename)
+Index<char> ao_get_lib(const char *dirpath, char *filename)
 {
     VFSFile file(filename_build({dirpath, filename}), "r");
     return file ? file.read_all() : Index<char>();
 }
 
+struct PSFRender {
+    mips_cpu_context *cpu;
+    TrackMeter *meter;
+    bool timed;
+};
+
+static void render_update(const void *data, int bytes, void *user)
+{
+    PSFRender *r = (PSFRender *)user;
+
+    if (!data)
+    {
+        r->cpu->stop_flag = true;
+        return;
+    }
+
+    r->meter->add((const int16_t *)data, bytes / 2);
+
+    if (!r->timed && (r->meter->silent() || r->meter->time() >= MEASURE_MAX_LENGTH))
+        r->cpu->stop_flag = true;
+}
+
+/* Renders a file into the meter without opening the output, as fast as the
+ * engine runs.  The engine keeps its state in the mips_cpu_context, so several
+ * files can be rendered at once.  A file with a length is rendered up to the
+ * end of its fade; one without is rendered until it falls silent, for at most
+ * MEASURE_MAX_LENGTH. */
+static bool render_track(const char *dirpath, Index<char> &buf, bool timed, TrackMeter &meter)
+{
+    PSFEngine eng = psf_probe(buf.begin(), buf.len());
+    if (eng == ENG_NONE || eng == ENG_COUNT)
+        return false;
+
+    PSFEngineFunctors *f = &psf_functor_map[eng];
+
+    PSFRender r;
+    r.cpu = f->start(dirpath, (uint8_t *)buf.begin(), buf.len(), false);
+    r.meter = &meter;
+    r.timed = timed;
+
+    if (!r.cpu)
+        return false;
+
+    f->execute(r.cpu, render_update, &r);
+    f->stop(r.cpu);
+
+    return true;
+}
+
 bool PSFPlugin::read_tag(const char *filename, VFSFile &file, Tuple &tuple, Index<char> *image)
 {
     Index<char> buf = file.read_all ();
@@ -153,6 +219,8 @@ bool PSFPlugin::read_tag(const char *filename, VFSFile &file, Tuple &tuple, Inde
     if (corlett_decode((uint8_t *)buf.begin(), buf.len(), nullptr, nullptr, &c) != AO_SUCCESS)
         return false;
 
+    bool timed = (psfTimeToMS(c->inf_length) > 0);
+
     tuple.set_int(Tuple::Length, psfTimeToMS(c->inf_length) + psfTimeToMS(c->inf_fade));
     tuple.set_str(Tuple::Artist, c->inf_artist);
     tuple.set_str(Tuple::Album, c->inf_game);
@@ -164,6 +232,21 @@ bool PSFPlugin::read_tag(const char *filename, VFSFile &file, Tuple &tuple, Inde
 
     free(c);
 
+    String dirpath = get_dirpath(filename);
+
+    if (aud_get_bool("psf", "measure") && dirpath)
+    {
+        TrackMeter meter(44100, 2);
+
+        if (render_track(dirpath, buf, timed, meter))
+        {
+            if (!timed && meter.silent())
+                tuple.set_int(Tuple::Length, meter.end_time());
+
+            meter.apply(tuple);
+        }
+    }
+
     return true;
 }
 
@@ -171,12 +254,10 @@ bool PSFPlugin::play(const char *filename, VFSFile &file)
 {
     bool error = false;
 
-    const char * slash = strrchr (filename, '/');
-    if (! slash)
+    String dirpath = get_dirpath(filename);
+    if (! dirpath)
         return false;
 
-    dirpath = String (str_copy (filename, slash + 1 - filename));
-
     Index<char> buf = file.read_all ();
 
     bool ignore_len = aud_get_bool("psf", "ignore_length");
@@ -188,54 +269,47 @@ bool PSFPlugin::play(const char *filename, VFSFile &file)
         goto cleanup;
     }
 
-    if(eng == ENG_PSF1 || eng == ENG_SPX)
-        setendless(ignore_len);
-
-    if(eng == ENG_PSF2)
-        setendless2(ignore_len);
-
-    f = &psf_functor_map[eng];
+    PSFPlayback pb;
+    pb.f = &psf_functor_map[eng];
 
     set_stream_bitrate(44100*2*2*8);
     open_audio(FMT_S16_NE, 44100, 2);
 
-    reverse_seek = -1;
+    pb.reverse_seek = -1;
 
     /* This loop will restart playback from the beginning when necessary to seek
      * backwards in the file (reverse_seek >= 0). */
     do
     {
-        if (f->start((uint8_t *)buf.begin(), buf.len()) != AO_SUCCESS)
+        pb.cpu = pb.f->start(dirpath, (uint8_t *)buf.begin(), buf.len(), ignore_len);
+        if (!pb.cpu)
         {
             error = true;
             goto cleanup;
         }
 
-        if (reverse_seek >= 0)
+        if (pb.reverse_seek >= 0)
         {
-            f->seek(reverse_seek); /* should never fail here */
-            reverse_seek = -1;
+            pb.f->seek(pb.cpu, pb.reverse_seek); /* should never fail here */
+            pb.reverse_seek = -1;
         }
 
-        stop_flag = false;
-
-        f->execute(update);
-        f->stop();
+        pb.f->execute(pb.cpu, update, &pb);
+        pb.f->stop(pb.cpu);
     }
-    while (reverse_seek >= 0);
+    while (pb.reverse_seek >= 0);
 
 cleanup:
-    f = nullptr;
-    dirpath = String ();
-
     return ! error;
 }
 
-void PSFPlugin::update(const void *data, int bytes)
+void PSFPlugin::update(const void *data, int bytes, void *user)
 {
+    PSFPlayback *pb = (PSFPlayback *)user;
+
     if (!data || check_stop())
     {
-        stop_flag = true;
+        pb->cpu->stop_flag = true;
         return;
     }
 
@@ -243,10 +317,10 @@ void PSFPlugin::update(const void *data, int bytes)
 
     if (seek >= 0)
     {
-        if (!f->seek(seek))
+        if (!pb->f->seek(pb->cpu, seek))
         {
-            reverse_seek = seek;
-            stop_flag = true;
+            pb->reverse_seek = seek;
+            pb->cpu->stop_flag = true;
         }
 
         return;
@@ -269,6 +343,7 @@ const char *const PSFPlugin::exts[] = { "psf", "minipsf", "psf2", "minipsf2", "s
 const PreferencesWidget PSFPlugin::widgets[] = {
     WidgetLabel(N_("<b>OpenPSF Configuration</b>")),
     WidgetCheck(N_("Ignore length from file"), WidgetBool("psf", "ignore_length")),
+    WidgetCheck(N_("Measure song length and loudness"), WidgetBool("psf", "measure")),
 };
 
 const PluginPreferences PSFPlugin::prefs = {{widgets}};
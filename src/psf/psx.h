@@ -2,12 +2,14 @@
 #define _MIPS_H
 
 #include "ao.h"
+#include "corlett.h"
+#include "osd_cpu.h"
 //#include "driver.h"
 
 typedef void genf(void);
 typedef uint32_t offs_t;
 
-#define cpu_readop32(pc) program_read_dword_32le(pc)
+#define cpu_readop32(pc) program_read_dword_32le(cpu, pc)
 #define change_pc(pc)																	\
 
 
@@ -63,6 +65,8 @@ struct address_map_t
 };
 typedef struct address_map_t *(*construct_map_t)(struct address_map_t *map);
 
+struct mips_cpu_context;
+
 union cpuinfo
 {
 	int64_t	i;											/* generic integers */
@@ -70,15 +74,15 @@ union cpuinfo
 	genf *  f;											/* generic function pointers */
 	char *	s;											/* generic strings */
 
-	void	(*setinfo)(uint32_t state, union cpuinfo *info);/* CPUINFO_PTR_SET_INFO */
+	void	(*setinfo)(struct mips_cpu_context *cpu, uint32_t state, union cpuinfo *info);/* CPUINFO_PTR_SET_INFO */
 	void	(*getcontext)(void *context);				/* CPUINFO_PTR_GET_CONTEXT */
 	void	(*setcontext)(void *context);				/* CPUINFO_PTR_SET_CONTEXT */
-	void	(*init)(void);								/* CPUINFO_PTR_INIT */
-	void	(*reset)(void *param);						/* CPUINFO_PTR_RESET */
+	void	(*init)(struct mips_cpu_context *cpu);		/* CPUINFO_PTR_INIT */
+	void	(*reset)(struct mips_cpu_context *cpu, void *param);	/* CPUINFO_PTR_RESET */
 	void	(*exit)(void);								/* CPUINFO_PTR_EXIT */
-	int		(*execute)(int cycles);						/* CPUINFO_PTR_EXECUTE */
+	int		(*execute)(struct mips_cpu_context *cpu, int cycles);	/* CPUINFO_PTR_EXECUTE */
 	void	(*burn)(int cycles);						/* CPUINFO_PTR_BURN */
-	offs_t	(*disassemble)(char *buffer, offs_t pc);	/* CPUINFO_PTR_DISASSEMBLE */
+	offs_t	(*disassemble)(struct mips_cpu_context *cpu, char *buffer, offs_t pc);	/* CPUINFO_PTR_DISASSEMBLE */
 	int		(*irqcallback)(int state);					/* CPUINFO_PTR_IRQCALLBACK */
 	int *	icount;										/* CPUINFO_PTR_INSTRUCTION_COUNTER */
 	construct_map_t internal_map;						/* CPUINFO_PTR_INTERNAL_MEMORY_MAP */
@@ -282,71 +286,232 @@ extern unsigned DasmMIPS(char *buff, unsigned _pc);
 #endif
 
 #if (HAS_PSXCPU)
-extern void psxcpu_get_info(uint32_t state, union cpuinfo *info);
+extern void psxcpu_get_info(struct mips_cpu_context *cpu, uint32_t state, union cpuinfo *info);
 #endif
 
-/* eng_psf.cc */
-extern int psf_refresh;
+#define MAX_FILE_SLOTS	(32)
+#define SEMA_MAX	(64)
+#define MAX_FS		(32)	// maximum # of filesystems (libs and subdirectories)
+
+typedef struct
+{
+	char name[10];
+	uint32_t dispatch;
+} ExternLibEntries;
+
+typedef struct
+{
+	uint32_t type;
+	uint32_t value;
+	uint32_t param;
+	int    inUse;
+} EventFlag;
+
+typedef struct
+{
+	uint32_t attr;
+	uint32_t option;
+	int32_t init;
+	int32_t current;
+	int32_t max;
+	int32_t threadsWaiting;
+	int32_t inuse;
+} Semaphore;
+
+typedef struct
+{
+	int32_t  iState;		// state of thread
+
+	uint32_t flags;		// flags
+	uint32_t routine;		// start of code for the thread
+	uint32_t stackloc;	// stack location in IOP RAM
+	uint32_t stacksize;	// stack size
+	uint32_t refCon;		// user value passed in at CreateThread time
 
-int32_t psf_start(uint8_t *buffer, uint32_t length);
-int32_t psf_execute(void (*update)(const void *, int));
-int32_t psf_stop(void);
+	uint32_t waitparm;	// what we're waiting on if in one the TS_WAIT* states
+
+	uint32_t save_regs[37];	// CPU registers belonging to this thread
+} Thread;
+
+typedef struct
+{
+	int32_t  iActive;
+	uint32_t count;
+	uint32_t target;
+	uint32_t source;
+	uint32_t prescale;
+	uint32_t handler;
+	uint32_t hparam;
+	uint32_t mode;
+} IOPTimer;
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t mode;
+	uint32_t target;
+	uint32_t sysclock;
+	uint32_t interrupt;
+} Counter;
+
+typedef struct
+{
+	uint32_t desc;
+	int32_t status;
+	int32_t mode;
+	uint32_t fhandler;
+} EvtCtrlBlk[32];
+
+struct spu_state_t;
+struct spu2_state_t;
+
+// Everything one emulated machine needs: the R3000 core, the PSX/IOP
+// hardware and HLE BIOS, the SPU, and the loader state of whichever engine
+// started it.  Nothing is shared between contexts, so several can run at
+// once on different threads.
+typedef struct mips_cpu_context
+{
+	/* psx.cc */
+	uint32_t op;
+	uint32_t pc;
+	uint32_t prevpc;
+	uint32_t delayv;
+	uint32_t delayr;
+	uint32_t hi;
+	uint32_t lo;
+	uint32_t r[ 32 ];
+	uint32_t cp0r[ 32 ];
+	PAIR cp2cr[ 32 ];
+	PAIR cp2dr[ 32 ];
+	int (*irq_callback)(int irqline);
+	int mips_ICount;
+
+	/* psx_hw.cc */
+	uint32_t psx_ram[(2*1024*1024)/4+4];		// PSX main RAM
+	uint32_t psx_scratch[0x400];
+	uint32_t initial_ram[(2*1024*1024)/4+4];	// backup image to restart songs
+	uint32_t initial_scratch[0x400];
+
+	volatile int softcall_target;
+	int filestat[MAX_FILE_SLOTS];
+	uint8_t *filedata[MAX_FILE_SLOTS];
+	uint32_t filesize[MAX_FILE_SLOTS], filepos[MAX_FILE_SLOTS];
+	int intr_susp;
+
+	uint64_t sys_time;
+	int timerexp;
+
+	int32_t iNumLibs;
+	ExternLibEntries reglibs[32];
+
+	int32_t iNumFlags;
+	EventFlag evflags[32];
+
+	int32_t iNumSema;
+	Semaphore semaphores[SEMA_MAX];
+
+	int32_t iNumThreads, iCurThread;
+	Thread threads[32];
+
+	IOPTimer iop_timers[8];
+	int32_t iNumTimers;
+
+	Counter root_cnts[4];	// 4 of the bastards
+
+	EvtCtrlBlk *Event;
+	EvtCtrlBlk *CounterEvent;
+
+	uint32_t spu_delay, dma_icr, irq_data, irq_mask, dma_timer, WAI;
+	uint32_t dma4_madr, dma4_bcr, dma4_chcr, dma4_delay;
+	uint32_t dma7_madr, dma7_bcr, dma7_chcr, dma7_delay;
+	uint32_t dma4_cb, dma7_cb, dma4_fval, dma4_flag, dma7_fval, dma7_flag;
+	uint32_t irq9_cb, irq9_fval, irq9_flag;
+	uint32_t gpu_stat;
+	int fcnt;
+
+	uint32_t heap_addr, entry_int;
+	uint32_t irq_regs[37];
+	int irq_mutex;
+
+	/* peops/spu.cc, peops2/spu.cc */
+	struct spu_state_t *spu;
+	struct spu2_state_t *spu2;
+
+	/* eng_psf.cc, eng_psf2.cc */
+	corlett_t *c;
+	char psfby[256];
+	int psf_refresh;
+	uint32_t initialPC, initialGP, initialSP;
+
+	/* eng_psf2.cc */
+	uint32_t loadAddr, lengthMS, fadeMS;
+	uint8_t *filesys[MAX_FS];
+	Index<char> lib_raw_file;
+	uint32_t fssize[MAX_FS];
+	int num_fs;
+
+	/* eng_spx.cc */
+	uint8_t *start_of_file, *song_ptr;
+	uint32_t cur_tick, cur_event, num_events, next_tick, end_tick;
+	int old_fmt;
+	char name[128], song[128], company[128];
+
+	/* plugin.cc */
+	bool stop_flag;
+} mips_cpu_context;
+
+/* eng_psf.cc */
+mips_cpu_context *psf_start(const char *dirpath, uint8_t *buffer, uint32_t length, bool endless);
+int32_t psf_execute(mips_cpu_context *cpu, void (*update)(const void *, int, void *), void *user);
+int32_t psf_stop(mips_cpu_context *cpu);
 
 /* eng_psf2.cc */
-uint32_t psf2_load_elf(uint8_t *start, uint32_t len);
-uint32_t psf2_load_file(const char *file, uint8_t *buf, uint32_t buflen);
-int32_t psf2_start(uint8_t *, uint32_t length);
-int32_t psf2_execute(void (*update)(const void *, int));
-int32_t psf2_stop(void);
-int32_t psf2_command(int32_t, int32_t);
-uint32_t psf2_get_loadaddr(void);
-void psf2_set_loadaddr(uint32_t addr);
+uint32_t psf2_load_elf(mips_cpu_context *cpu, uint8_t *start, uint32_t len);
+uint32_t psf2_load_file(mips_cpu_context *cpu, const char *file, uint8_t *buf, uint32_t buflen);
+mips_cpu_context *psf2_start(const char *dirpath, uint8_t *buffer, uint32_t length, bool endless);
+int32_t psf2_execute(mips_cpu_context *cpu, void (*update)(const void *, int, void *), void *user);
+int32_t psf2_stop(mips_cpu_context *cpu);
+int32_t psf2_command(mips_cpu_context *cpu, int32_t, int32_t);
+uint32_t psf2_get_loadaddr(mips_cpu_context *cpu);
+void psf2_set_loadaddr(mips_cpu_context *cpu, uint32_t addr);
 
 /* eng_spx.cc */
-int32_t spx_start(uint8_t *buffer, uint32_t length);
-int32_t spx_execute(void (*update)(const void *, int));
-int32_t spx_stop(void);
-
-/* plugin.cc */
-extern bool stop_flag;
+mips_cpu_context *spx_start(const char *dirpath, uint8_t *buffer, uint32_t length, bool endless);
+int32_t spx_execute(mips_cpu_context *cpu, void (*update)(const void *, int, void *), void *user);
+int32_t spx_stop(mips_cpu_context *cpu);
 
 /* psx.cc */
-void mips_init(void);
-void mips_reset(void *param);
-void mips_shorten_frame(void);
-int mips_execute(int cycles);
-void mips_set_info(uint32_t state, union cpuinfo *info);
-void mips_get_info(uint32_t state, union cpuinfo *info);
-uint32_t mips_get_cause(void);
-uint32_t mips_get_status(void);
-void mips_set_status(uint32_t status);
-uint32_t mips_get_ePC(void);
-int mips_get_icount(void);
-void mips_set_icount(int count);
+void mips_init(mips_cpu_context *cpu);
+void mips_reset(mips_cpu_context *cpu, void *param);
+void mips_shorten_frame(mips_cpu_context *cpu);
+int mips_execute(mips_cpu_context *cpu, int cycles);
+void mips_set_info(mips_cpu_context *cpu, uint32_t state, union cpuinfo *info);
+void mips_get_info(mips_cpu_context *cpu, uint32_t state, union cpuinfo *info);
+uint32_t mips_get_cause(mips_cpu_context *cpu);
+uint32_t mips_get_status(mips_cpu_context *cpu);
+void mips_set_status(mips_cpu_context *cpu, uint32_t status);
+uint32_t mips_get_ePC(mips_cpu_context *cpu);
+int mips_get_icount(mips_cpu_context *cpu);
+void mips_set_icount(mips_cpu_context *cpu, int count);
 
 /* psx_hw.cc */
-extern uint32_t psx_ram[((2*1024*1024)/4)+4];
-extern uint32_t psx_scratch[0x400];
-extern uint32_t initial_ram[((2*1024*1024)/4)+4];
-extern uint32_t initial_scratch[0x400];
-
-void psx_hw_slice(void);
-void ps2_hw_slice(void);
-void psx_hw_frame(void);
-void ps2_hw_frame(void);
+void psx_hw_slice(mips_cpu_context *cpu);
+void ps2_hw_slice(mips_cpu_context *cpu);
+void psx_hw_frame(mips_cpu_context *cpu);
+void ps2_hw_frame(mips_cpu_context *cpu);
 
-void psx_hw_init(void);
-void psx_bios_hle(uint32_t pc);
-void psx_hw_runcounters(void);
+void psx_hw_init(mips_cpu_context *cpu);
+void psx_bios_hle(mips_cpu_context *cpu, uint32_t pc);
+void psx_hw_runcounters(mips_cpu_context *cpu);
 
-uint8_t program_read_byte_32le(offs_t address);
-uint16_t program_read_word_32le(offs_t address);
-uint32_t program_read_dword_32le(offs_t address);
+uint8_t program_read_byte_32le(mips_cpu_context *cpu, offs_t address);
+uint16_t program_read_word_32le(mips_cpu_context *cpu, offs_t address);
+uint32_t program_read_dword_32le(mips_cpu_context *cpu, offs_t address);
 
-void program_write_byte_32le(offs_t address, uint8_t data);
-void program_write_word_32le(offs_t address, uint16_t data);
-void program_write_dword_32le(offs_t address, uint32_t data);
+void program_write_byte_32le(mips_cpu_context *cpu, offs_t address, uint8_t data);
+void program_write_word_32le(mips_cpu_context *cpu, offs_t address, uint16_t data);
+void program_write_dword_32le(mips_cpu_context *cpu, offs_t address, uint32_t data);
 
-void psx_iop_call(uint32_t pc, uint32_t callnum);
+void psx_iop_call(mips_cpu_context *cpu, uint32_t pc, uint32_t callnum);
 
 #endif
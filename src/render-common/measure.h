@@ -0,0 +1,136 @@
+/*
+ * Offline Track Measurement
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef RENDER_COMMON_MEASURE_H
+#define RENDER_COMMON_MEASURE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include <libaudcore/index.h>
+#include <libaudcore/tuple.h>
+
+/* Input plugins for sequenced music can render a track as fast as their
+ * emulator runs, without opening the output, to find out how long and how
+ * loud it is.  Each plugin has a render function that feeds the samples to a
+ * TrackMeter; apply() then writes the results into the tuple.  A meter shares
+ * no state, so tracks can be measured in parallel on the playlist scanner
+ * threads.  An emulator core with global state must not be used for this
+ * unless it is serialised: console skips VGMs that need the YM2413 core, and
+ * xsf does not measure at all, since DeSmuME can only run one instance.
+ *
+ * Loudness is the RMS level of the loudest 5% of 50 ms blocks, as in
+ * ReplayGain but without the equal-loudness filter. */
+
+class TrackMeter
+{
+public:
+    static constexpr int block_rate = 20;         /* blocks per second */
+    static constexpr float block_percentile = 0.95;
+    static constexpr float reference_level = -20;  /* dB, full scale = 0 */
+    static constexpr int silence_threshold = 16;  /* largest "silent" sample */
+
+    /* silence_ms is how long the track must be silent to count as ended */
+    TrackMeter (int rate, int channels, int silence_ms = 3000) :
+        m_rate (rate),
+        m_channels (channels),
+        m_block_size (aud::max (rate / block_rate, 1)),
+        m_silence_limit ((int64_t) rate * silence_ms / 1000) {}
+
+    /* interleaved, signed 16-bit samples */
+    void add (const int16_t * data, int samples)
+    {
+        for (int i = 0; i < samples; i ++)
+        {
+            int sample = abs (data[i]);
+
+            m_peak = aud::max (m_peak, sample);
+            m_block_sum += (double) sample * sample;
+            m_frame_loud |= (sample > silence_threshold);
+
+            if (++ m_channel < m_channels)
+                continue;
+
+            m_channel = 0;
+            m_frames ++;
+            m_silent_frames = m_frame_loud ? 0 : m_silent_frames + 1;
+            m_frame_loud = false;
+
+            if (++ m_block_frames == m_block_size)
+            {
+                m_blocks.append (m_block_sum / ((double) m_channels * m_block_size));
+                m_block_frames = 0;
+                m_block_sum = 0;
+            }
+        }
+    }
+
+    /* milliseconds rendered so far */
+    int time () const
+        { return m_frames * 1000 / m_rate; }
+
+    /* whether the track has been silent for long enough to have ended */
+    bool silent () const
+        { return m_silent_frames >= m_silence_limit; }
+
+    /* the time at which the current stretch of silence began */
+    int end_time () const
+        { return (m_frames - m_silent_frames) * 1000 / m_rate; }
+
+    /* loudness in dB, full scale = 0 */
+    float level ()
+    {
+        if (! m_blocks.len ())
+            return -100;
+
+        float * nth = m_blocks.begin () + (int) (m_blocks.len () * block_percentile);
+        if (nth == m_blocks.end ())
+            nth --;
+
+        std::nth_element (m_blocks.begin (), nth, m_blocks.end ());
+        return (* nth > 0) ? 10 * log10f (* nth / (32768.0f * 32768.0f)) : -100;
+    }
+
+    /* sets TrackGain and TrackPeak; the length is up to the plugin */
+    void apply (Tuple & tuple)
+    {
+        tuple.set_int (Tuple::TrackGain, (reference_level - level ()) * 1000);
+        tuple.set_int (Tuple::TrackPeak, m_peak / 32768.0f * 1000);
+        tuple.set_int (Tuple::GainDivisor, 1000);
+        tuple.set_int (Tuple::PeakDivisor, 1000);
+    }
+
+private:
+    const int m_rate, m_channels, m_block_size;
+    const int64_t m_silence_limit;
+
+    int64_t m_frames = 0, m_silent_frames = 0;
+    int m_channel = 0;
+    bool m_frame_loud = false;
+
+    int m_block_frames = 0;
+    double m_block_sum = 0;
+    Index<float> m_blocks;  /* mean square of each block */
+    int m_peak = 0;
+};
+
+#endif /* RENDER_COMMON_MEASURE_H */
@@ -25,6 +25,8 @@
 #include <libaudcore/preferences.h>
 #include <libaudcore/audstrings.h>
 
+#include "../effect-common/profile.h"
+
 #define MIN_RATE 8000
 #define MAX_RATE 192000
 #define RATE_STEP 50
@@ -66,6 +68,8 @@ private:
 
 EXPORT Resampler aud_plugin_instance;
 
+static EffectProfile profile (N_("Sample Rate Converter"));
+
 const char * const Resampler::defaults[] = {
  "method", aud::numeric_string<SRC_SINC_FASTEST>::str,
  "default-rate", "44100",
@@ -106,6 +110,8 @@ void Resampler::cleanup ()
 
 void Resampler::start (int & channels, int & rate)
 {
+    profile.start (channels, rate);
+
     if (state)
     {
         src_delete (state);
@@ -141,6 +147,8 @@ void Resampler::start (int & channels, int & rate)
 
 Index<float> & Resampler::resample (Index<float> & data, bool finish)
 {
+    EffectProfile::Timer timer (profile, data);
+
     if (! state || ! data.len ())
         return data;
 
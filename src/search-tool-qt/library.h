@@ -20,19 +20,32 @@
 #ifndef LIBRARY_H
 #define LIBRARY_H
 
+#include <stdint.h>
+
 #include <libaudcore/hook.h>
+#include <libaudcore/mainloop.h>
 #include <libaudcore/multihash.h>
+#include <libaudcore/objects.h>
 #include <libaudcore/playlist.h>
 
+#include "library-index.h"
+
 class Library
 {
 public:
-    Library () { find_playlist (); }
-    ~Library () { set_adding (false); }
+    Library ();
+    ~Library ();
 
     Playlist playlist () const { return m_playlist; }
-    bool is_ready () const { return m_is_ready; }
 
+    /* the library can be searched either when the playlist is ready or, until
+     * then, through the index saved last time */
+    bool is_ready () const { return m_is_ready || m_index_valid; }
+    const LibraryIndex * index () const
+        { return (! m_is_ready && m_index_valid) ? & m_index : nullptr; }
+
+    /* the folder is read by a pool of threads, whose number is set by the
+     * "scan_threads" setting */
     void begin_add (const char * uri);
     void check_ready_and_update (bool force);
 
@@ -41,25 +54,78 @@ public:
         update_data = data;
     };
 
+    struct Progress
+    {
+        int64_t files, bytes;
+        double seconds;
+    };
+
+    /* returns false if no folder is being read */
+    bool get_progress (Progress & progress) const;
+
 private:
+    class Walker;
+
     void find_playlist ();
     void create_playlist ();
     bool check_playlist (bool require_added, bool require_scanned);
-    void set_adding (bool adding);
 
-    static bool filter_cb (const char * filename, void *);
+    void load_index ();
+    void save_index ();
+    void invalidate_index ();
+
+    bool found_file (const char * filename, const FileStat & stat);
+    void lost_file (const char * filename);
+    void walk_complete ();
 
     void add_complete (void);
     void scan_complete (void);
     void playlist_update (void);
 
+    /* state of each file during an add */
+    enum class FileState {
+        Absent,  /* not in the playlist */
+        Unseen,  /* in the playlist, not (yet) found on disk */
+        Seen,    /* in the playlist and found on disk */
+        Changed, /* found on disk, but modified since it was last scanned */
+        Added    /* found on disk and being added to the playlist */
+    };
+
+    struct FileInfo
+    {
+        FileState state;
+        FileStat stat;
+    };
+
+    /* The file table is split into shards, each with its own lock, so that the
+     * walker threads seldom wait for each other.  Outside of an add, only the
+     * main thread uses it, without locking. */
+    static constexpr int FILE_SHARDS = 16;
+
+    struct FileShard
+    {
+        aud::spinlock lock;
+        SimpleHash<String, FileInfo> files;
+    };
+
+    FileShard & shard_for (const String & filename)
+        { return m_shards[filename.hash () % FILE_SHARDS]; }
+
+    FileInfo * lookup_file (const String & filename)
+        { return shard_for (filename).files.lookup (filename); }
+
     Playlist m_playlist;
     bool m_is_ready = false;
-    SimpleHash<String, bool> m_added_table;
+    bool m_adding = false;
+
+    FileShard m_shards[FILE_SHARDS];
+    QueuedFunc m_walk_done;
+    SmartPtr<Walker> m_walker;
 
-    /* to allow safe callback access from playlist add thread */
-    static aud::spinlock s_adding_lock;
-    static Library * s_adding_library;
+    /* persistent state, saved in the library index */
+    LibraryIndex m_index;
+    bool m_index_valid = false;
+    bool m_index_dirty = false;
 
     void (* update_func) (void *) = nullptr;
     void * update_data = nullptr;
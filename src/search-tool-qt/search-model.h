@@ -27,6 +27,8 @@
 #include <libaudcore/multihash.h>
 #include <libaudcore/playlist.h>
 
+#include "library-index.h"
+
 enum class SearchField {
     Genre,
     Artist,
@@ -47,6 +49,16 @@ static inline const char * parent_prefix (SearchField parent)
      SearchField::HiddenAlbum) ? _("on") : _("by");
 }
 
+struct Trigram
+{
+    unsigned value;
+
+    bool operator== (const Trigram & b) const
+        { return value == b.value; }
+    unsigned hash () const
+        { return value * 0x9e3779b1u; }
+};
+
 struct Key
 {
     SearchField field;
@@ -64,12 +76,14 @@ struct Item
     String name, folded;
     Item * parent;
     SimpleHash<Key, Item> children;
-    Index<int> matches;
+    Index<int> matches; /* sorted by entry number */
+    int id = -1; /* index into SearchModel::m_item_table */
 
-    Item (SearchField field, const String & name, Item * parent) :
+    Item (SearchField field, const String & name, const String & folded,
+     Item * parent) :
         field (field),
         name (name),
-        folded (str_tolower_utf8 (name)),
+        folded (folded),
         parent (parent) {}
 
     Item (Item &&) = default;
@@ -85,9 +99,31 @@ public:
 
     void update ();
     void destroy_database ();
-    void create_database (Playlist playlist);
+    /* if an index is given, the entries are read from it instead of from the
+     * playlist (whose entries it must match) */
+    void create_database (Playlist playlist, const LibraryIndex * index = nullptr);
+    /* re-indexes only the entries changed since the last update, falling
+     * back to create_database() if the playlist or index is a different one */
+    void update_database (Playlist playlist, const LibraryIndex * index = nullptr);
     void do_search (const Index<String> & terms, int max_results);
 
+    struct Token;
+    struct EntryInfo;
+
+    struct Match
+    {
+        int id;
+        float quality;
+        Match (int id, float quality) : id (id), quality (quality) {}
+    };
+
+    struct Result
+    {
+        const Item * item;
+        float score;
+        Result (const Item * item, float score) : item (item), score (score) {}
+    };
+
 protected:
     int rowCount (const QModelIndex & parent) const
     {
@@ -113,12 +149,38 @@ protected:
     QMimeData * mimeData (const QModelIndexList & indexes) const;
 
 private:
-    void add_to_database (int entry, std::initializer_list<Key> keys);
+    void index_entries (int first, int count, Index<Item *> * touched);
+    void add_entry (int entry, const EntryInfo & info, Index<Item *> * touched);
+    void add_to_database (int entry, std::initializer_list<Token> tokens,
+     Index<Item *> * touched);
+    void remove_entries (int first, int count, int shift);
+
+    void register_item (Item * item);
+    void unregister_item (Item * item);
+
+    void find_term (const char * term, Index<Match> & found);
+    void mark_subtree (Item * item, float quality, int64_t stamp, int n_terms,
+     Index<int> & touched);
 
     Playlist m_playlist;
+    const LibraryIndex * m_index = nullptr;
+    int m_entries = 0;
     SimpleHash<Key, Item> m_database;
     Index<const Item *> m_items;
     int m_hidden_items = 0;
+
+    /* every item in the database by id, for the trigram index */
+    Index<Item *> m_item_table;
+    Index<int> m_free_ids;
+    SimpleHash<Trigram, Index<int>> m_trigrams;
+
+    /* scratch space for do_search(), indexed by item id */
+    Index<int> m_term_counts;
+    Index<int64_t> m_term_stamps;
+    int64_t m_stamp = 0;
+    Index<float> m_scores;
+    Index<int> m_gram_counts, m_gram_touched;
+    Index<Result> m_results;
     int m_rows = 0;
 };
 
@@ -46,6 +46,7 @@
 
 #define CFG_ID "search-tool"
 #define SEARCH_DELAY 300
+#define PROGRESS_INTERVAL 1000
 
 class SearchToolQt : public GeneralPlugin
 {
@@ -121,6 +122,8 @@ public:
 
 private:
     void init_library ();
+    void begin_add (const char * uri);
+    void update_progress ();
     void show_hide_widgets ();
     void search_timeout ();
     void library_updated ();
@@ -141,7 +144,7 @@ private:
     SmartPtr<QFileSystemWatcher> m_watcher;
     QStringList m_watcher_paths;
 
-    QueuedFunc m_search_timer;
+    QueuedFunc m_search_timer, m_progress_timer;
     bool m_search_pending = false;
 
     QLabel m_help_label, m_wait_label, m_stats_label;
@@ -158,6 +161,7 @@ const char * const SearchToolQt::defaults[] = {
     "max_results", "20",
     "rescan_on_startup", "FALSE",
     "monitor", "FALSE",
+    "scan_threads", "4",
     nullptr
 };
 
@@ -168,7 +172,10 @@ const PreferencesWidget SearchToolQt::widgets[] = {
     WidgetCheck (N_("Rescan library at startup"),
         WidgetBool (CFG_ID, "rescan_on_startup")),
     WidgetCheck (N_("Monitor library for changes"),
-        WidgetBool (CFG_ID, "monitor", [] () { s_widget->reset_monitor (); }))
+        WidgetBool (CFG_ID, "monitor", [] () { s_widget->reset_monitor (); })),
+    WidgetSpin (N_("Threads for reading the library:"),
+        WidgetInt (CFG_ID, "scan_threads"),
+         {1, 32, 1})
 };
 
 const PluginPreferences SearchToolQt::prefs = {{widgets}};
@@ -272,11 +279,45 @@ void SearchWidget::init_library ()
      (aud::obj_member<SearchWidget, & SearchWidget::library_updated>, this);
 
     if (aud_get_bool (CFG_ID, "rescan_on_startup"))
-        m_library.begin_add (get_uri ());
+        begin_add (get_uri ());
 
     m_library.check_ready_and_update (true);
 }
 
+void SearchWidget::begin_add (const char * uri)
+{
+    m_library.begin_add (uri);
+    m_progress_timer.start (PROGRESS_INTERVAL, [this] () { update_progress (); });
+}
+
+void SearchWidget::update_progress ()
+{
+    Library::Progress progress;
+
+    if (! m_library.get_progress (progress))
+    {
+        m_wait_label.setText (_("Please wait ..."));
+        m_progress_timer.stop ();
+
+        // restore the result count
+        if (m_library.is_ready ())
+            search_timeout ();
+
+        return;
+    }
+
+    double seconds = aud::max (progress.seconds, 0.001);
+    StringBuf text = str_printf (_("Reading library: %d files (%d files/s, %.1f MB/s)"),
+     (int) progress.files, (int) (progress.files / seconds),
+     progress.bytes / seconds / (1 << 20));
+
+    m_wait_label.setText ((const char *) text);
+
+    // the saved index may be searched in the meantime
+    if (m_library.is_ready ())
+        m_stats_label.setText ((const char *) text);
+}
+
 void SearchWidget::show_hide_widgets ()
 {
     if (m_library.playlist () == Playlist ())
@@ -344,7 +385,7 @@ void SearchWidget::library_updated ()
 {
     if (m_library.is_ready ())
     {
-        m_model.create_database (m_library.playlist ());
+        m_model.update_database (m_library.playlist (), m_library.index ());
         search_timeout ();
     }
     else
@@ -369,7 +410,7 @@ void SearchWidget::location_changed ()
     StringBuf path = uri_to_filename (uri);
     aud_set_str (CFG_ID, "path", path ? path : uri);
 
-    m_library.begin_add (uri);
+    begin_add (uri);
     m_library.check_ready_and_update (true);
     reset_monitor ();
 }
@@ -409,7 +450,7 @@ void SearchWidget::setup_monitor ()
     {
         AUDINFO ("Library directory changed, refreshing library.\n");
 
-        m_library.begin_add (get_uri ());
+        begin_add (get_uri ());
         m_library.check_ready_and_update (true);
 
         walk_library_paths ();
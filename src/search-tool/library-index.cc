@@ -0,0 +1,221 @@
+/*
+ * library-index.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "library-index.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/multihash.h>
+#include <libaudcore/runtime.h>
+#include <libaudcore/tuple.h>
+
+#define INDEX_MAGIC "AUDLIBIX"
+#define INDEX_VERSION 1
+
+struct LibraryIndex::Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entries;
+    uint64_t records_offset; /* the string pool lies between header and records */
+    uint64_t file_size;
+};
+
+struct LibraryIndex::Record
+{
+    uint32_t strings[n_fields]; /* offsets into the pool; 0 means not set */
+    int64_t mtime, size;
+};
+
+bool LibraryIndex::open (const char * path)
+{
+    close ();
+
+    GMappedFile * file = g_mapped_file_new (path, false, nullptr);
+    if (! file)
+        return false;
+
+    auto data = g_mapped_file_get_contents (file);
+    int64_t size = g_mapped_file_get_length (file);
+    auto header = (const Header *) data;
+
+    if (size < (int64_t) sizeof (Header) ||
+     memcmp (header->magic, INDEX_MAGIC, sizeof header->magic) ||
+     header->version != INDEX_VERSION || (int64_t) header->file_size != size ||
+     header->records_offset <= sizeof (Header) ||
+     header->records_offset % alignof (Record) ||
+     (size - header->records_offset) / sizeof (Record) != header->entries ||
+     data[header->records_offset - 1] != 0) /* last string is terminated */
+    {
+        AUDWARN ("Ignoring invalid library index %s\n", path);
+        g_mapped_file_unref (file);
+        return false;
+    }
+
+    m_file = file;
+    m_pool = data + sizeof (Header);
+    m_pool_size = header->records_offset - sizeof (Header);
+    m_records = (const Record *) (data + header->records_offset);
+    m_entries = header->entries;
+
+    return true;
+}
+
+void LibraryIndex::close ()
+{
+    if (m_file)
+        g_mapped_file_unref (m_file);
+
+    m_file = nullptr;
+    m_pool = nullptr;
+    m_pool_size = 0;
+    m_records = nullptr;
+    m_entries = 0;
+}
+
+const char * LibraryIndex::get (int entry, Field field) const
+{
+    uint32_t offset = m_records[entry].strings[field];
+    return (offset && offset < m_pool_size) ? m_pool + offset : nullptr;
+}
+
+FileStat LibraryIndex::stat (int entry) const
+{
+    FileStat stat;
+    stat.mtime = m_records[entry].mtime;
+    stat.size = m_records[entry].size;
+    return stat;
+}
+
+/* Writes the strings to the pool as they come, remembering where each one went
+ * so that repeated artist, album, and genre names are stored only once. */
+class PoolWriter
+{
+public:
+    PoolWriter (FILE * file) : m_file (file)
+        { fputc (0, file); }
+
+    uint32_t add (const String & str)
+    {
+        if (! str)
+            return 0;
+
+        uint32_t * offset = m_offsets.lookup (str);
+        if (offset)
+            return * offset;
+
+        int len = strlen (str) + 1;
+
+        /* offsets are 32-bit */
+        if (m_size + len > UINT32_MAX)
+        {
+            m_overflow = true;
+            return 0;
+        }
+
+        fwrite (str, 1, len, m_file);
+        m_offsets.add (str, m_size);
+        m_size += len;
+
+        return m_size - len;
+    }
+
+    int64_t size () const { return m_size; }
+    bool overflow () const { return m_overflow; }
+
+private:
+    FILE * m_file;
+    SimpleHash<String, uint32_t> m_offsets;
+    int64_t m_size = 1;
+    bool m_overflow = false;
+};
+
+bool LibraryIndex::write (const char * path, Playlist playlist,
+ const Index<FileStat> & stats)
+{
+    StringBuf temp = str_concat ({path, ".tmp"});
+    FILE * file = g_fopen (temp, "wb");
+
+    if (! file)
+    {
+        AUDWARN ("Failed to write library index %s\n", (const char *) temp);
+        return false;
+    }
+
+    int entries = aud::min (playlist.n_entries (), stats.len ());
+
+    /* the header is filled in last, so that a partial file is never valid */
+    Header header {};
+    fwrite (& header, sizeof header, 1, file);
+
+    Index<Record> records;
+    records.insert (0, entries);
+
+    PoolWriter pool (file);
+
+    for (int entry = 0; entry < entries; entry ++)
+    {
+        String filename = playlist.entry_filename (entry);
+        Tuple tuple = playlist.entry_tuple (entry, Playlist::NoWait);
+        auto & record = records[entry];
+
+        record.strings[Filename] = pool.add (filename);
+        record.strings[Genre] = pool.add (tuple.get_str (Tuple::Genre));
+        record.strings[Artist] = pool.add (tuple.get_str (Tuple::Artist));
+        record.strings[AlbumArtist] = pool.add (tuple.get_str (Tuple::AlbumArtist));
+        record.strings[Album] = pool.add (tuple.get_str (Tuple::Album));
+        record.strings[Title] = pool.add (tuple.get_str (Tuple::Title));
+
+        record.mtime = stats[entry].mtime;
+        record.size = stats[entry].size;
+    }
+
+    /* pad the pool so that the records are aligned */
+    int64_t pool_end = sizeof header + pool.size ();
+    int64_t padding = (alignof (Record) - pool_end % alignof (Record)) % alignof (Record);
+
+    for (int i = 0; i < padding; i ++)
+        fputc (0, file);
+
+    header.records_offset = pool_end + padding;
+    header.file_size = header.records_offset + sizeof (Record) * (int64_t) entries;
+
+    fwrite (records.begin (), sizeof (Record), entries, file);
+
+    memcpy (header.magic, INDEX_MAGIC, sizeof header.magic);
+    header.version = INDEX_VERSION;
+    header.entries = entries;
+
+    bool ok = ! pool.overflow () && ! fseek (file, 0, SEEK_SET) &&
+     fwrite (& header, sizeof header, 1, file) == 1;
+
+    if (fclose (file) || ! ok || g_rename (temp, path) < 0)
+    {
+        AUDWARN ("Failed to write library index %s\n", path);
+        g_unlink (temp);
+        return false;
+    }
+
+    return true;
+}
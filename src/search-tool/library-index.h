@@ -0,0 +1,88 @@
+/*
+ * library-index.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef LIBRARY_INDEX_H
+#define LIBRARY_INDEX_H
+
+#include <stdint.h>
+
+#include <libaudcore/index.h>
+#include <libaudcore/playlist.h>
+
+/* modification time and size of a file on disk */
+struct FileStat
+{
+    int64_t mtime = -1, size = -1;
+
+    bool valid () const
+        { return mtime >= 0; }
+    bool operator== (const FileStat & b) const
+        { return mtime == b.mtime && size == b.size; }
+    bool operator!= (const FileStat & b) const
+        { return ! operator== (b); }
+};
+
+/* The library index is a snapshot of the library playlist, saved to disk so
+ * that it can be searched at startup before the playlist is ready.  For each
+ * entry, it holds the filename, the fields used by the search model, and the
+ * file's modification time and size as of the last scan.  The file is mapped
+ * into memory as is; strings are NUL-terminated and stored only once. */
+class LibraryIndex
+{
+public:
+    enum Field {
+        Filename,
+        Genre,
+        Artist,
+        AlbumArtist,
+        Album,
+        Title,
+        n_fields
+    };
+
+    LibraryIndex () = default;
+    LibraryIndex (const LibraryIndex &) = delete;
+    LibraryIndex & operator= (const LibraryIndex &) = delete;
+    ~LibraryIndex () { close (); }
+
+    bool open (const char * path);
+    void close ();
+
+    int n_entries () const { return m_entries; }
+
+    /* returns nullptr if the field is not set */
+    const char * get (int entry, Field field) const;
+    FileStat stat (int entry) const;
+
+    /* stats holds the modification time and size for each playlist entry */
+    static bool write (const char * path, Playlist playlist,
+     const Index<FileStat> & stats);
+
+private:
+    struct Header;
+    struct Record;
+
+    struct _GMappedFile * m_file = nullptr;
+    const char * m_pool = nullptr;
+    int64_t m_pool_size = 0;
+    const Record * m_records = nullptr;
+    int m_entries = 0;
+};
+
+#endif // LIBRARY_INDEX_H
@@ -19,11 +19,267 @@
 
 #include "library.h"
 
+#include <pthread.h>
 #include <string.h>
+
+#include <atomic>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
+#include <libaudcore/probe.h>
+#include <libaudcore/runtime.h>
+#include <libaudcore/vfs.h>
+
+#define CFG_ID "search-tool"
+#define MAX_SCAN_THREADS 32
+
+/* The folder is read by a pool of worker threads sharing a stack of folders
+ * still to be read.  Each worker takes a folder, lists it, pushes the
+ * subfolders it finds, and checks the files against the file table.  The last
+ * worker to finish tells the main thread, which then adds the new files to the
+ * playlist. */
+class Library::Walker
+{
+public:
+    Walker (Library * library, const char * uri, int threads);
+    ~Walker ();
+
+    void get_progress (Progress & progress) const;
+    Index<PlaylistAddItem> take_added ();
+
+private:
+    static void * run_cb (void * data)
+        { ((Walker *) data)->run (); return nullptr; }
+
+    void run ();
+    void read_folder (const char * uri, Index<String> & folders,
+     Index<PlaylistAddItem> & added);
+
+    Library * m_library;
+    bool m_fast_probe;
+
+    pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t m_cond = PTHREAD_COND_INITIALIZER;
+
+    /* protected by m_mutex */
+    Index<String> m_folders;
+    Index<PlaylistAddItem> m_added;
+    int m_busy = 0, m_running = 0;
+
+    std::atomic<bool> m_cancel {false};
+    std::atomic<int64_t> m_files {0}, m_bytes {0};
+    int64_t m_start_time;
+
+    Index<pthread_t> m_threads;
+};
+
+/* Finds out whether a file is a folder, and gets its modification time and
+ * size if it is a local file.  Returns false for links to folders, which are
+ * not followed so that they cannot lead into a loop. */
+static bool stat_file (const char * uri, bool & is_folder, FileStat & stat)
+{
+    StringBuf path = uri_to_filename (uri);
+
+    if (! path)
+    {
+        auto test = VFSFile::test_file (uri,
+         VFSFileTest (VFS_IS_REGULAR | VFS_IS_DIR | VFS_IS_SYMLINK));
+
+        is_folder = (test & VFS_IS_DIR);
+        return (test & VFS_IS_REGULAR) || (is_folder && ! (test & VFS_IS_SYMLINK));
+    }
+
+    GStatBuf buf;
+    if (g_lstat (path, & buf) < 0)
+        return false;
+
+#ifdef S_ISLNK
+    if (S_ISLNK (buf.st_mode))
+    {
+        if (g_stat (path, & buf) < 0 || S_ISDIR (buf.st_mode))
+            return false;
+    }
+#endif
 
-aud::spinlock Library::s_adding_lock;
-Library * Library::s_adding_library = nullptr;
+    is_folder = S_ISDIR (buf.st_mode);
+    stat.mtime = buf.st_mtime;
+    stat.size = buf.st_size;
+
+    return is_folder || S_ISREG (buf.st_mode);
+}
+
+Library::Walker::Walker (Library * library, const char * uri, int threads) :
+    m_library (library),
+    m_fast_probe (! aud_get_bool (nullptr, "slow_probe")),
+    m_start_time (g_get_monotonic_time ())
+{
+    threads = aud::clamp (threads, 1, MAX_SCAN_THREADS);
+
+    m_folders.append (String (uri));
+    m_running = threads;
+    m_threads.insert (0, threads);
+
+    for (pthread_t & thread : m_threads)
+        pthread_create (& thread, nullptr, run_cb, this);
+}
+
+Library::Walker::~Walker ()
+{
+    pthread_mutex_lock (& m_mutex);
+    m_cancel = true;
+    pthread_cond_broadcast (& m_cond);
+    pthread_mutex_unlock (& m_mutex);
+
+    for (pthread_t & thread : m_threads)
+        pthread_join (thread, nullptr);
+}
+
+void Library::Walker::get_progress (Progress & progress) const
+{
+    progress.files = m_files;
+    progress.bytes = m_bytes;
+    progress.seconds = (g_get_monotonic_time () - m_start_time) / 1000000.0;
+}
+
+Index<PlaylistAddItem> Library::Walker::take_added ()
+{
+    pthread_mutex_lock (& m_mutex);
+    Index<PlaylistAddItem> added = std::move (m_added);
+    pthread_mutex_unlock (& m_mutex);
+
+    return added;
+}
+
+void Library::Walker::run ()
+{
+    Index<PlaylistAddItem> added;
+
+    pthread_mutex_lock (& m_mutex);
+
+    while (! m_cancel)
+    {
+        if (! m_folders.len ())
+        {
+            /* done when no other worker can find more folders */
+            if (! m_busy)
+                break;
+
+            pthread_cond_wait (& m_cond, & m_mutex);
+            continue;
+        }
+
+        int last = m_folders.len () - 1;
+        String uri = std::move (m_folders[last]);
+        m_folders.remove (last, 1);
+        m_busy ++;
+
+        pthread_mutex_unlock (& m_mutex);
+
+        Index<String> folders;
+        read_folder (uri, folders, added);
+
+        pthread_mutex_lock (& m_mutex);
+
+        for (String & folder : folders)
+            m_folders.append (std::move (folder));
+
+        m_busy --;
+        pthread_cond_broadcast (& m_cond);
+    }
+
+    for (PlaylistAddItem & item : added)
+        m_added.append (std::move (item));
+
+    bool last = ! (-- m_running) && ! m_cancel;
+
+    pthread_cond_broadcast (& m_cond);
+    pthread_mutex_unlock (& m_mutex);
+
+    if (last)
+        m_library->m_walk_done.queue ([library = m_library] () { library->walk_complete (); });
+}
+
+void Library::Walker::read_folder (const char * uri, Index<String> & folders,
+ Index<PlaylistAddItem> & added)
+{
+    String error;
+    Index<String> files = VFSFile::read_folder (uri, error);
+
+    if (error)
+        AUDWARN ("Error reading %s: %s\n", uri, (const char *) error);
+
+    for (const String & file : files)
+    {
+        if (m_cancel)
+            break;
+
+        /* skip hidden files */
+        const char * slash = strrchr (file, '/');
+        if ((slash ? slash[1] : file[0]) == '.')
+            continue;
+
+        bool is_folder = false;
+        FileStat stat;
+
+        if (! stat_file (file, is_folder, stat))
+            continue;
+
+        if (is_folder)
+        {
+            folders.append (file);
+            continue;
+        }
+
+        m_files ++;
+        if (stat.size > 0)
+            m_bytes += stat.size;
+
+        if (m_library->found_file (file, stat))
+        {
+            /* only new files need to be probed */
+            VFSFile handle;
+            PluginHandle * decoder = aud_file_find_decoder (file, m_fast_probe, handle);
+
+            if (decoder)
+                added.append (String (file), Tuple (), decoder);
+            else
+                m_library->lost_file (file);
+        }
+    }
+}
+
+static StringBuf index_path ()
+{
+    return filename_build ({aud_get_path (AudPath::UserDir), "library-index"});
+}
+
+Library::Library ()
+{
+    find_playlist ();
+    load_index ();
+}
+
+Library::~Library ()
+{
+    /* waits for the walker threads */
+    m_walker.clear ();
+    m_walk_done.stop ();
+
+    if (m_index_dirty && check_playlist (true, true))
+        save_index ();
+}
+
+bool Library::get_progress (Progress & progress) const
+{
+    if (! m_walker)
+        return false;
+
+    m_walker->get_progress (progress);
+    return true;
+}
 
 void Library::find_playlist ()
 {
@@ -47,6 +303,78 @@ void Library::create_playlist ()
     m_playlist.active_playlist ();
 }
 
+/* The index is only used for searching if it matches the playlist entry for
+ * entry; the file modification times are kept either way. */
+void Library::load_index ()
+{
+    StringBuf path = index_path ();
+
+    /* write a new index once the playlist is ready */
+    if (! m_index.open (path))
+    {
+        m_index_dirty = true;
+        return;
+    }
+
+    int entries = m_index.n_entries ();
+
+    for (int entry = 0; entry < entries; entry ++)
+    {
+        FileStat stat = m_index.stat (entry);
+        const char * filename = m_index.get (entry, LibraryIndex::Filename);
+
+        if (filename && stat.valid ())
+        {
+            String key (filename);
+            shard_for (key).files.add (key, {FileState::Absent, stat});
+        }
+    }
+
+    if (m_playlist.exists () && m_playlist.n_entries () == entries)
+    {
+        m_index_valid = true;
+
+        for (int entry = 0; entry < entries && m_index_valid; entry ++)
+        {
+            const char * filename = m_index.get (entry, LibraryIndex::Filename);
+            if (! filename || strcmp (m_playlist.entry_filename (entry), filename))
+                m_index_valid = false;
+        }
+    }
+
+    if (! m_index_valid)
+    {
+        m_index.close ();
+        m_index_dirty = true;
+    }
+}
+
+void Library::save_index ()
+{
+    StringBuf path = index_path ();
+
+    /* the old file may still be mapped */
+    invalidate_index ();
+
+    Index<FileStat> stats;
+    int entries = m_playlist.n_entries ();
+
+    for (int entry = 0; entry < entries; entry ++)
+    {
+        FileInfo * info = lookup_file (m_playlist.entry_filename (entry));
+        stats.append (info ? info->stat : FileStat ());
+    }
+
+    if (LibraryIndex::write (path, m_playlist, stats))
+        m_index_dirty = false;
+}
+
+void Library::invalidate_index ()
+{
+    m_index_valid = false;
+    m_index.close ();
+}
+
 bool Library::check_playlist (bool require_added, bool require_scanned)
 {
     if (! m_playlist.exists ())
@@ -55,7 +383,7 @@ bool Library::check_playlist (bool require_added, bool require_scanned)
         return false;
     }
 
-    if (require_added && m_playlist.add_in_progress ())
+    if (require_added && (m_walker || m_playlist.add_in_progress ()))
         return false;
     if (require_scanned && m_playlist.scan_in_progress ())
         return false;
@@ -63,50 +391,81 @@ bool Library::check_playlist (bool require_added, bool require_scanned)
     return true;
 }
 
-void Library::set_adding (bool adding)
+/* Called from the walker threads for each file found on disk.  Returns true
+ * if the file is not in the playlist; it is then marked as being added. */
+bool Library::found_file (const char * filename, const FileStat & stat)
 {
-    auto lh = s_adding_lock.take ();
-    s_adding_library = adding ? this : nullptr;
-}
+    String key (filename);
+    FileShard & shard = shard_for (key);
 
-bool Library::filter_cb (const char * filename, void *)
-{
-    bool add = false;
-    auto lh = s_adding_lock.take ();
+    auto lh = shard.lock.take ();
+    FileInfo * info = shard.files.lookup (key);
 
-    if (s_adding_library)
+    if (! info)
     {
-        bool * added = s_adding_library->m_added_table.lookup (String (filename));
-
-        if ((add = ! added))
-            s_adding_library->m_added_table.add (String (filename), true);
-        else
-            (* added) = true;
+        shard.files.add (key, {FileState::Added, stat});
+        return true;
     }
 
-    return add;
+    FileState state = info->state;
+
+    if (state == FileState::Unseen)
+        info->state = (info->stat.valid () && stat.valid () && stat != info->stat) ?
+         FileState::Changed : FileState::Seen;
+    else if (state == FileState::Absent)
+        info->state = FileState::Added;
+
+    if (stat.valid ())
+        info->stat = stat;
+
+    return (state == FileState::Absent);
+}
+
+/* Called from the walker threads for a new file that cannot be played. */
+void Library::lost_file (const char * filename)
+{
+    String key (filename);
+    FileShard & shard = shard_for (key);
+
+    auto lh = shard.lock.take ();
+    FileInfo * info = shard.files.lookup (key);
+
+    if (info)
+        info->state = FileState::Absent;
 }
 
 void Library::begin_add (const char * uri)
 {
-    if (s_adding_library)
+    if (m_adding)
         return;
 
     if (! check_playlist (false, false))
         create_playlist ();
 
-    m_added_table.clear ();
+    /* every file is first taken to be missing from the playlist, then those
+     * in the playlist to be missing from disk */
+    for (FileShard & shard : m_shards)
+    {
+        shard.files.iterate ([] (const String &, FileInfo & info)
+            { info.state = FileState::Absent; });
+    }
 
     int entries = m_playlist.n_entries ();
 
     for (int entry = 0; entry < entries; entry ++)
     {
         String filename = m_playlist.entry_filename (entry);
+        FileInfo * info = lookup_file (filename);
 
-        if (! m_added_table.lookup (filename))
+        if (! info)
         {
             m_playlist.select_entry (entry, false);
-            m_added_table.add (filename, false);
+            shard_for (filename).files.add (filename, {FileState::Unseen, FileStat ()});
+        }
+        else if (info->state == FileState::Absent)
+        {
+            m_playlist.select_entry (entry, false);
+            info->state = FileState::Unseen;
         }
         else
             m_playlist.select_entry (entry, true);
@@ -114,21 +473,45 @@ void Library::begin_add (const char * uri)
 
     m_playlist.remove_selected ();
 
-    set_adding (true);
+    m_adding = true;
+    m_walker.capture (new Walker (this, uri, aud_get_int (CFG_ID, "scan_threads")));
+}
+
+void Library::walk_complete ()
+{
+    Index<PlaylistAddItem> added = m_walker->take_added ();
+    m_walker.clear ();
 
-    Index<PlaylistAddItem> add;
-    add.append (String (uri));
-    m_playlist.insert_filtered (-1, std::move (add), filter_cb, nullptr, false);
+    if (! check_playlist (false, false))
+    {
+        m_adding = false;
+        return;
+    }
+
+    if (added.len ())
+        m_playlist.insert_items (-1, std::move (added), false);
+    else
+        add_complete ();
 }
 
 void Library::check_ready_and_update (bool force)
 {
     bool now_ready = check_playlist (true, true);
-    if (now_ready != m_is_ready || force)
+    bool changed = (now_ready != m_is_ready);
+
+    m_is_ready = now_ready;
+
+    /* from now on, the playlist itself is searched */
+    if (m_is_ready && changed)
     {
-        m_is_ready = now_ready;
-        signal_update ();
+        if (m_index_dirty)
+            save_index ();
+        else
+            invalidate_index ();
     }
+
+    if (changed || force)
+        signal_update ();
 }
 
 void Library::add_complete ()
@@ -136,22 +519,18 @@ void Library::add_complete ()
     if (! check_playlist (true, false))
         return;
 
-    if (s_adding_library)
+    if (m_adding)
     {
-        set_adding (false);
+        m_adding = false;
 
         int entries = m_playlist.n_entries ();
 
         for (int entry = 0; entry < entries; entry ++)
         {
-            String filename = m_playlist.entry_filename (entry);
-            bool * added = m_added_table.lookup (filename);
-
-            m_playlist.select_entry (entry, ! added || ! (* added));
+            FileInfo * info = lookup_file (m_playlist.entry_filename (entry));
+            m_playlist.select_entry (entry, ! info || info->state == FileState::Unseen);
         }
 
-        m_added_table.clear ();
-
         /* don't clear the playlist if nothing was added */
         if (m_playlist.n_selected () < entries)
             m_playlist.remove_selected ();
@@ -159,6 +538,21 @@ void Library::add_complete ()
             m_playlist.select_all (false);
 
         m_playlist.sort_entries (Playlist::Path);
+
+        /* read the tags again from files modified since the last scan */
+        entries = m_playlist.n_entries ();
+
+        for (int entry = 0; entry < entries; entry ++)
+        {
+            FileInfo * info = lookup_file (m_playlist.entry_filename (entry));
+            m_playlist.select_entry (entry, info && info->state == FileState::Changed);
+        }
+
+        if (m_playlist.n_selected ())
+        {
+            m_playlist.rescan_selected ();
+            m_playlist.select_all (false);
+        }
     }
 
     if (! m_playlist.update_pending ())
@@ -173,5 +567,20 @@ void Library::scan_complete ()
 
 void Library::playlist_update ()
 {
-    check_ready_and_update (m_playlist.update_detail ().level >= Playlist::Metadata);
+    auto update = m_playlist.update_detail ();
+
+    if (update.level >= Playlist::Metadata)
+        m_index_dirty = true;
+
+    /* entries added at the end leave the index usable */
+    bool force = (update.level >= Playlist::Metadata);
+
+    if (m_index_valid && update.level >= Playlist::Structure &&
+     update.before < m_index.n_entries ())
+    {
+        invalidate_index ();
+        force = true;
+    }
+
+    check_ready_and_update (force);
 }
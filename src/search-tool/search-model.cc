@@ -18,29 +18,267 @@
  */
 
 #include "search-model.h"
+
+#include <pthread.h>
 #include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+/* Playlist entries are read and their fields case-folded on worker threads,
+ * BATCH_ENTRIES at a time; the results are then added to the database on the
+ * calling thread. */
+#define BATCH_ENTRIES 16384
+#define MIN_ENTRIES_PER_THREAD 1024
+#define MAX_THREADS 8
+
+/* longest term that is matched approximately */
+#define MAX_FUZZY_LEN 32
+
+struct SearchModel::Token
+{
+    SearchField field;
+    const String & name;
+    const String & folded;
+};
+
+struct SearchModel::EntryInfo
+{
+    String genre, artist, album_artist, album, title;
+    String genre_f, artist_f, album_artist_f, album_f, title_f;
+};
+
+struct ScanJob
+{
+    Playlist playlist;
+    const LibraryIndex * index;
+    int first, count;
+    SearchModel::EntryInfo * infos;
+    pthread_t thread;
+};
+
+static String fold (const String & str)
+{
+    return str ? String (str_tolower_utf8 (str)) : String ();
+}
+
+static void * scan_worker (void * data)
+{
+    auto job = (ScanJob *) data;
+
+    for (int i = 0; i < job->count; i ++)
+    {
+        int entry = job->first + i;
+        auto & info = job->infos[i];
+
+        if (job->index)
+        {
+            info.genre = String (job->index->get (entry, LibraryIndex::Genre));
+            info.artist = String (job->index->get (entry, LibraryIndex::Artist));
+            info.album_artist = String (job->index->get (entry, LibraryIndex::AlbumArtist));
+            info.album = String (job->index->get (entry, LibraryIndex::Album));
+            info.title = String (job->index->get (entry, LibraryIndex::Title));
+        }
+        else
+        {
+            Tuple tuple = job->playlist.entry_tuple (entry, Playlist::NoWait);
+
+            info.genre = tuple.get_str (Tuple::Genre);
+            info.artist = tuple.get_str (Tuple::Artist);
+            info.album_artist = tuple.get_str (Tuple::AlbumArtist);
+            info.album = tuple.get_str (Tuple::Album);
+            info.title = tuple.get_str (Tuple::Title);
+        }
+
+        info.genre_f = fold (info.genre);
+        info.artist_f = fold (info.artist);
+        info.album_artist_f = fold (info.album_artist);
+        info.album_f = fold (info.album);
+        info.title_f = fold (info.title);
+    }
+
+    return nullptr;
+}
+
+static void scan_entries (Playlist playlist, const LibraryIndex * index,
+ int first, int count, Index<SearchModel::EntryInfo> & infos)
+{
+    infos.clear ();
+    infos.insert (0, count);
+
+    int cpus = aud::max (1, (int) sysconf (_SC_NPROCESSORS_ONLN));
+    int n_jobs = aud::clamp (count / MIN_ENTRIES_PER_THREAD, 1, aud::min (cpus, MAX_THREADS));
+
+    ScanJob jobs[MAX_THREADS];
+    int done = 0;
+
+    for (int j = 0; j < n_jobs; j ++)
+    {
+        int end = (int64_t) count * (j + 1) / n_jobs;
+        jobs[j] = {playlist, index, first + done, end - done, & infos[done]};
+        done = end;
+    }
+
+    /* the calling thread takes the first share */
+    for (int j = 1; j < n_jobs; j ++)
+        pthread_create (& jobs[j].thread, nullptr, scan_worker, & jobs[j]);
+
+    scan_worker (& jobs[0]);
+
+    for (int j = 1; j < n_jobs; j ++)
+        pthread_join (jobs[j].thread, nullptr);
+}
+
+static void get_trigrams (const char * str, Index<unsigned> & trigrams)
+{
+    trigrams.clear ();
+
+    int len = strlen (str);
+    for (int i = 0; i + 3 <= len; i ++)
+    {
+        auto p = (const unsigned char *) str + i;
+        trigrams.append (p[0] | (p[1] << 8) | (p[2] << 16));
+    }
+
+    trigrams.sort ([] (const unsigned & a, const unsigned & b)
+        { return (a > b) - (a < b); });
+
+    /* remove duplicates */
+    int out = 0;
+    for (int i = 0; i < trigrams.len (); i ++)
+    {
+        if (! out || trigrams[i] != trigrams[out - 1])
+            trigrams[out ++] = trigrams[i];
+    }
+
+    trigrams.remove (out, -1);
+}
+
+static int lower_bound (const Index<int> & list, int value)
+{
+    int lo = 0, hi = list.len ();
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (list[mid] < value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
 
 void SearchModel::destroy_database ()
 {
     m_playlist = Playlist ();
+    m_index = nullptr;
+    m_entries = 0;
     m_items.clear ();
     m_hidden_items = 0;
     m_database.clear ();
+
+    m_item_table.clear ();
+    m_free_ids.clear ();
+    m_trigrams.clear ();
+    m_term_counts.clear ();
+    m_term_stamps.clear ();
+    m_scores.clear ();
+    m_gram_counts.clear ();
+    m_results.clear ();
+}
+
+void SearchModel::register_item (Item * item)
+{
+    if (m_free_ids.len ())
+    {
+        item->id = m_free_ids[m_free_ids.len () - 1];
+        m_free_ids.remove (m_free_ids.len () - 1, 1);
+        m_item_table[item->id] = item;
+    }
+    else
+    {
+        item->id = m_item_table.len ();
+        m_item_table.append (item);
+        m_term_counts.append (0);
+        m_term_stamps.append (0);
+        m_scores.append (0);
+        m_gram_counts.append (0);
+    }
+
+    Index<unsigned> trigrams;
+    get_trigrams (item->folded, trigrams);
+
+    for (unsigned value : trigrams)
+    {
+        Index<int> * ids = m_trigrams.lookup ({value});
+        if (! ids)
+            ids = m_trigrams.add ({value}, Index<int> ());
+
+        ids->append (item->id);
+    }
+}
+
+/* also unregisters all children, which are destroyed along with the item */
+void SearchModel::unregister_item (Item * item)
+{
+    item->children.iterate ([&] (const Key &, Item & child)
+        { unregister_item (& child); });
+
+    Index<unsigned> trigrams;
+    get_trigrams (item->folded, trigrams);
+
+    for (unsigned value : trigrams)
+    {
+        Index<int> * ids = m_trigrams.lookup ({value});
+        if (! ids)
+            continue;
+
+        for (int i = 0; i < ids->len (); i ++)
+        {
+            if ((* ids)[i] == item->id)
+            {
+                /* order does not matter, so just move the last one here */
+                (* ids)[i] = (* ids)[ids->len () - 1];
+                ids->remove (ids->len () - 1, 1);
+                break;
+            }
+        }
+
+        if (! ids->len ())
+            m_trigrams.remove ({value});
+    }
+
+    m_item_table[item->id] = nullptr;
+    m_free_ids.append (item->id);
+    item->id = -1;
 }
 
-void SearchModel::add_to_database (int entry, std::initializer_list<Key> keys)
+void SearchModel::add_to_database (int entry,
+ std::initializer_list<Token> tokens, Index<Item *> * touched)
 {
     Item * parent = nullptr;
     auto hash = & m_database;
 
-    for (auto & key : keys)
+    for (auto & token : tokens)
     {
-        if (! key.name)
+        if (! token.name)
             continue;
 
+        Key key = {token.field, token.name};
         Item * item = hash->lookup (key);
+
         if (! item)
-            item = hash->add (key, Item (key.field, key.name, parent));
+        {
+            item = hash->add (key, Item (token.field, token.name, token.folded, parent));
+            register_item (item);
+        }
+
+        /* incremental updates can add entries out of order */
+        if (touched && item->matches.len () &&
+         item->matches[item->matches.len () - 1] > entry)
+            touched->append (item);
 
         item->matches.append (entry);
 
@@ -49,80 +287,317 @@ void SearchModel::add_to_database (int entry, std::initializer_list<Key> keys)
     }
 }
 
-void SearchModel::create_database (Playlist playlist)
+void SearchModel::add_entry (int e, const EntryInfo & info, Index<Item *> * touched)
+{
+    if (info.album_artist && info.album_artist != info.artist)
+    {
+        /* album and song have different artists;
+         * add separately under respective artists */
+        add_to_database (e,
+         {{SearchField::Artist, info.album_artist, info.album_artist_f},
+          {SearchField::Album, info.album, info.album_f}}, touched);
+        /* add Title node under a HiddenAlbum node so that it can
+         * still be searched by album name (without listing the
+         * album twice) */
+        add_to_database (e,
+         {{SearchField::Artist, info.artist, info.artist_f},
+          {SearchField::HiddenAlbum, info.album, info.album_f},
+          {SearchField::Title, info.title, info.title_f}}, touched);
+    }
+    else
+    {
+        /* album and song have the same artist;
+         * add hierarchically under that artist */
+        add_to_database (e,
+         {{SearchField::Artist, info.artist, info.artist_f},
+          {SearchField::Album, info.album, info.album_f},
+          {SearchField::Title, info.title, info.title_f}}, touched);
+    }
+
+    /* add separately under genre */
+    add_to_database (e,
+     {{SearchField::Genre, info.genre, info.genre_f}}, touched);
+}
+
+void SearchModel::index_entries (int first, int count, Index<Item *> * touched)
+{
+    Index<EntryInfo> infos;
+
+    for (int done = 0; done < count; done += BATCH_ENTRIES)
+    {
+        int batch = aud::min (count - done, BATCH_ENTRIES);
+        scan_entries (m_playlist, m_index, first + done, batch, infos);
+
+        for (int i = 0; i < batch; i ++)
+            add_entry (first + done + i, infos[i], touched);
+    }
+}
+
+void SearchModel::create_database (Playlist playlist, const LibraryIndex * index)
 {
     destroy_database ();
 
-    int entries = playlist.n_entries ();
+    m_playlist = playlist;
+    m_index = index;
+    m_entries = index ? index->n_entries () : playlist.n_entries ();
+
+    index_entries (0, m_entries, nullptr);
+}
 
-    for (int e = 0; e < entries; e ++)
+/* Removes entries [first, first + count) from all items, and moves the entries
+ * after them by shift.  Items left without entries are deleted. */
+void SearchModel::remove_entries (int first, int count, int shift)
+{
+    Index<Item *> empty;
+
+    for (Item * item : m_item_table)
     {
-        Tuple tuple = playlist.entry_tuple (e, Playlist::NoWait);
-        String album_artist = tuple.get_str (Tuple::AlbumArtist);
-        String artist = tuple.get_str (Tuple::Artist);
+        if (! item)
+            continue;
 
-        if (album_artist && album_artist != artist)
+        auto & matches = item->matches;
+        int lo = lower_bound (matches, first);
+        int hi = lower_bound (matches, first + count);
+
+        matches.remove (lo, hi - lo);
+
+        if (shift)
         {
-            /* album and song have different artists;
-             * add separately under respective artists */
-            add_to_database (e,
-             {{SearchField::Artist, album_artist},
-              {SearchField::Album, tuple.get_str (Tuple::Album)}});
-            /* add Title node under a HiddenAlbum node so that it can
-             * still be searched by album name (without listing the
-             * album twice) */
-            add_to_database (e,
-             {{SearchField::Artist, artist},
-              {SearchField::HiddenAlbum, tuple.get_str (Tuple::Album)},
-              {SearchField::Title, tuple.get_str (Tuple::Title)}});
+            for (int i = lo; i < matches.len (); i ++)
+                matches[i] += shift;
         }
-        else
+
+        if (! matches.len ())
+            empty.append (item);
+    }
+
+    /* children of a deleted item are deleted along with it, so only delete
+     * the topmost ones (and look at all of them before deleting any) */
+    Index<Item *> roots;
+
+    for (Item * item : empty)
+    {
+        bool parent_empty = false;
+        for (Item * p = item->parent; p; p = p->parent)
         {
-            /* album and song have the same artist;
-             * add hierarchically under that artist */
-            add_to_database (e,
-             {{SearchField::Artist, artist},
-              {SearchField::Album, tuple.get_str (Tuple::Album)},
-              {SearchField::Title, tuple.get_str (Tuple::Title)}});
+            if (! p->matches.len ())
+                parent_empty = true;
         }
 
-        /* add separately under genre */
-        add_to_database (e,
-         {{SearchField::Genre, tuple.get_str (Tuple::Genre)}});
+        if (! parent_empty)
+            roots.append (item);
     }
 
-    m_playlist = playlist;
+    for (Item * item : roots)
+    {
+        unregister_item (item);
+
+        auto hash = item->parent ? & item->parent->children : & m_database;
+        hash->remove ({item->field, item->name});
+    }
+}
+
+void SearchModel::update_database (Playlist playlist, const LibraryIndex * index)
+{
+    auto update = playlist.update_detail ();
+    int entries = playlist.n_entries ();
+
+    if (playlist != m_playlist || index != m_index)
+    {
+        create_database (playlist, index);
+        return;
+    }
+
+    /* the index does not change */
+    if (index)
+        return;
+
+    if (update.level < Playlist::Metadata)
+    {
+        /* nothing to do, unless an update was missed */
+        if (entries != m_entries)
+            create_database (playlist);
+
+        return;
+    }
+
+    int removed = m_entries - update.before - update.after;
+    int added = entries - update.before - update.after;
+
+    if (removed < 0 || added < 0)
+    {
+        create_database (playlist);
+        return;
+    }
+
+    m_items.clear ();
+    m_hidden_items = 0;
+
+    remove_entries (update.before, removed, added - removed);
+    m_entries = entries;
+
+    Index<Item *> touched;
+    index_entries (update.before, added, & touched);
+
+    for (Item * item : touched)
+    {
+        item->matches.sort ([] (const int & a, const int & b)
+            { return (a > b) - (a < b); });
+    }
+}
+
+/* How well a term matches a name.  Matches at the start of a word rank above
+ * matches inside a word, which rank above approximate matches. */
+static float match_quality (const char * name, const char * found)
+{
+    if (found == name)
+        return 4;
+    if (found[-1] == ' ' || found[-1] == '-' || found[-1] == '(')
+        return 3;
+
+    return 2;
 }
 
-static void search_recurse (SimpleHash<Key, Item> & domain,
- const Index<String> & terms, int mask, Index<const Item *> & results)
+/* Smallest number of edits needed to turn the pattern into some substring of
+ * the text (Sellers' algorithm), or max + 1 if it is more than max. */
+static int fuzzy_distance (const char * text, const char * pattern, int len, int max)
 {
-    domain.iterate ([&] (const Key & key, Item & item)
+    int col[MAX_FUZZY_LEN + 1];
+
+    for (int i = 0; i <= len; i ++)
+        col[i] = i;
+
+    int best = col[len];
+
+    for (; * text && best; text ++)
     {
-        int count = terms.len ();
-        int new_mask = mask;
+        int diag = col[0];
+        col[0] = 0;
 
-        for (int t = 0, bit = 1; t < count; t ++, bit <<= 1)
+        for (int i = 1; i <= len; i ++)
         {
-            if (! (new_mask & bit))
-                continue; /* skip term if it is already found */
+            int above = col[i];
+            col[i] = aud::min (aud::min (above, col[i - 1]) + 1,
+             diag + (pattern[i - 1] != * text));
+            diag = above;
+        }
+
+        best = aud::min (best, col[len]);
+    }
+
+    return aud::min (best, max + 1);
+}
+
+/* Finds all items whose folded name contains the given term.  If the term is
+ * long enough, only items sharing its rarest trigram are looked at.  Long
+ * terms also match approximately (with one edit from 6 bytes, two from 9);
+ * candidates for that must share enough trigrams with the term. */
+void SearchModel::find_term (const char * term, Index<Match> & found)
+{
+    found.clear ();
+
+    Index<unsigned> trigrams;
+    get_trigrams (term, trigrams);
 
-            if (strstr (item.folded, terms[t]))
-                new_mask &= ~bit; /* we found it */
-            else if (! item.children.n_items ())
-                break; /* quit early if there are no children to search */
+    if (! trigrams.len ())
+    {
+        for (const Item * item : m_item_table)
+        {
+            const char * pos;
+            if (item && (pos = strstr (item->folded, term)))
+                found.append (item->id, match_quality (item->folded, pos));
+        }
+
+        return;
+    }
+
+    int len = strlen (term);
+    int max_edits = (len > MAX_FUZZY_LEN) ? 0 : (len >= 9) ? 2 : (len >= 6) ? 1 : 0;
+
+    const Index<int> * rarest = nullptr;
+    bool exact_possible = true;
+
+    for (unsigned value : trigrams)
+    {
+        const Index<int> * ids = m_trigrams.lookup ({value});
+
+        if (! ids)
+            exact_possible = false;
+        else if (max_edits)
+        {
+            /* each edit can break up to three trigrams */
+            for (int id : * ids)
+            {
+                if (! m_gram_counts[id] ++)
+                    m_gram_touched.append (id);
+            }
+        }
+
+        if (ids && (! rarest || ids->len () < rarest->len ()))
+            rarest = ids;
+    }
+
+    if (exact_possible)
+    {
+        for (int id : * rarest)
+        {
+            const char * folded = m_item_table[id]->folded;
+            const char * pos = strstr (folded, term);
+
+            if (pos)
+            {
+                found.append (id, match_quality (folded, pos));
+
+                if (max_edits)
+                    m_gram_counts[id] = -1; /* no need to look again */
+            }
+        }
+    }
+
+    /* a repetitive term has few distinct trigrams, so this could otherwise
+     * drop to zero and let through the exact matches marked -1 above */
+    int needed = aud::max (trigrams.len () - 3 * max_edits, 1);
+
+    for (int id : m_gram_touched)
+    {
+        if (m_gram_counts[id] >= needed)
+        {
+            int dist = fuzzy_distance (m_item_table[id]->folded, term, len, max_edits);
+            if (dist > 0 && dist <= max_edits)  /* not an exact match */
+                found.append (id, 1.0f / dist);
         }
 
-        /* adding an item with exactly one child is redundant, so avoid it */
-        if (! new_mask && item.children.n_items () != 1 &&
-         item.field != SearchField::HiddenAlbum)
-            results.append (& item);
+        m_gram_counts[id] = 0;
+    }
 
-        search_recurse (item.children, terms, new_mask, results);
-    });
+    m_gram_touched.clear ();
 }
 
-static int item_compare (const Item * const & a, const Item * const & b)
+/* Counts one more matched term for the item and all its descendants, adding
+ * the quality of the match to their scores.  Each (item, term) pair is counted
+ * only once, using the stamp, so the best matches must be marked first. */
+void SearchModel::mark_subtree (Item * item, float quality, int64_t stamp,
+ int n_terms, Index<int> & touched)
+{
+    if (m_term_stamps[item->id] == stamp)
+        return;
+
+    m_term_stamps[item->id] = stamp;
+    m_scores[item->id] += quality;
+
+    if (! m_term_counts[item->id] ++)
+        touched.append (item->id);
+
+    /* adding an item with exactly one child is redundant, so avoid it */
+    if (m_term_counts[item->id] == n_terms && item->children.n_items () != 1 &&
+     item->field != SearchField::HiddenAlbum)
+        m_results.append (item, m_scores[item->id]);
+
+    item->children.iterate ([&] (const Key &, Item & child)
+        { mark_subtree (& child, quality, stamp, n_terms, touched); });
+}
+
+static int item_compare (const Item * a, const Item * b)
 {
     if (a->field < b->field)
         return -1;
@@ -139,34 +614,82 @@ static int item_compare (const Item * const & a, const Item * const & b)
         return b->parent ? -1 : 0;
 }
 
-static int item_compare_pass1 (const Item * const & a, const Item * const & b)
+/* best match first, then items with the most songs */
+static bool rank_before (const SearchModel::Result & a, const SearchModel::Result & b)
 {
-    if (a->matches.len () > b->matches.len ())
-        return -1;
-    if (a->matches.len () < b->matches.len ())
-        return 1;
+    if (a.score != b.score)
+        return a.score > b.score;
+    if (a.item->matches.len () != b.item->matches.len ())
+        return a.item->matches.len () > b.item->matches.len ();
 
-    return item_compare (a, b);
+    return item_compare (a.item, b.item) < 0;
+}
+
+/* by item type, then best match, then item name */
+static bool display_before (const SearchModel::Result & a, const SearchModel::Result & b)
+{
+    if (a.item->field != b.item->field)
+        return a.item->field < b.item->field;
+    if (a.score != b.score)
+        return a.score > b.score;
+
+    return item_compare (a.item, b.item) < 0;
 }
 
 void SearchModel::do_search (const Index<String> & terms, int max_results)
 {
     m_items.clear ();
+    m_results.clear ();
     m_hidden_items = 0;
 
-    /* effectively limits number of search terms to 32 */
-    search_recurse (m_database, terms, (1 << terms.len ()) - 1, m_items);
+    /* an item matches if each term is found in its own name or in the name of
+     * one of its parents */
+    if (! terms.len ())
+    {
+        for (const Item * item : m_item_table)
+        {
+            if (item && item->children.n_items () != 1 &&
+             item->field != SearchField::HiddenAlbum)
+                m_results.append (item, 0.0f);
+        }
+    }
+    else
+    {
+        Index<Match> found;
+        Index<int> touched;
 
-    /* first sort by number of songs per item */
-    m_items.sort (item_compare_pass1);
+        for (const String & term : terms)
+        {
+            find_term (term, found);
+
+            std::stable_sort (found.begin (), found.end (),
+             [] (const Match & a, const Match & b) { return a.quality > b.quality; });
+
+            m_stamp ++;
+            for (const Match & match : found)
+                mark_subtree (m_item_table[match.id], match.quality, m_stamp,
+                 terms.len (), touched);
+        }
 
-    /* limit to items with most songs */
-    if (m_items.len () > max_results)
+        for (int id : touched)
+        {
+            m_term_counts[id] = 0;
+            m_scores[id] = 0;
+        }
+    }
+
+    /* keep only the best results, without sorting the rest */
+    if (m_results.len () > max_results)
     {
-        m_hidden_items = m_items.len () - max_results;
-        m_items.remove (max_results, -1);
+        std::nth_element (m_results.begin (), m_results.begin () + max_results,
+         m_results.end (), rank_before);
+
+        m_hidden_items = m_results.len () - max_results;
+        m_results.remove (max_results, -1);
     }
 
-    /* sort by item type, then item name */
-    m_items.sort (item_compare);
+    std::sort (m_results.begin (), m_results.end (), display_before);
+
+    for (const Result & result : m_results)
+        m_items.append (result.item);
 }
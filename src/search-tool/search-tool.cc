@@ -37,6 +37,7 @@
 
 #define CFG_ID "search-tool"
 #define SEARCH_DELAY 300
+#define PROGRESS_INTERVAL 1000
 
 class SearchTool : public GeneralPlugin
 {
@@ -67,6 +68,7 @@ static void trigger_search ();
 const char * const SearchTool::defaults[] = {
     "max_results", "20",
     "rescan_on_startup", "FALSE",
+    "scan_threads", "4",
     nullptr
 };
 
@@ -75,7 +77,10 @@ const PreferencesWidget SearchTool::widgets[] = {
         WidgetInt (CFG_ID, "max_results", trigger_search),
          {10, 10000, 10}),
     WidgetCheck (N_("Rescan library at startup"),
-        WidgetBool (CFG_ID, "rescan_on_startup"))
+        WidgetBool (CFG_ID, "rescan_on_startup")),
+    WidgetSpin (N_("Threads for reading the library:"),
+        WidgetInt (CFG_ID, "scan_threads"),
+         {1, 32, 1})
 };
 
 const PluginPreferences SearchTool::prefs = {{widgets}};
@@ -84,7 +89,7 @@ static Library * s_library = nullptr;
 static SearchModel s_model;
 static Index<bool> s_selection;
 
-static QueuedFunc s_search_timer;
+static QueuedFunc s_search_timer, s_progress_timer;
 static bool s_search_pending;
 
 static GtkWidget * entry, * help_label, * wait_label, * scrolled, * results_list, * stats_label;
@@ -173,7 +178,7 @@ void Library::signal_update ()
 {
     if (s_library->is_ready ())
     {
-        s_model.create_database (s_library->playlist ());
+        s_model.update_database (s_library->playlist (), s_library->index ());
         search_timeout ();
     }
     else
@@ -187,12 +192,46 @@ void Library::signal_update ()
     show_hide_widgets ();
 }
 
+static void update_progress ()
+{
+    Library::Progress progress;
+
+    if (! s_library->get_progress (progress))
+    {
+        gtk_label_set_text ((GtkLabel *) wait_label, _("Please wait ..."));
+        s_progress_timer.stop ();
+
+        /* restore the result count */
+        if (s_library->is_ready ())
+            search_timeout ();
+
+        return;
+    }
+
+    double seconds = aud::max (progress.seconds, 0.001);
+    StringBuf text = str_printf (_("Reading library: %d files (%d files/s, %.1f MB/s)"),
+     (int) progress.files, (int) (progress.files / seconds),
+     progress.bytes / seconds / (1 << 20));
+
+    gtk_label_set_text ((GtkLabel *) wait_label, text);
+
+    /* the saved index may be searched in the meantime */
+    if (s_library->is_ready ())
+        gtk_label_set_text ((GtkLabel *) stats_label, text);
+}
+
+static void begin_add (const char * uri)
+{
+    s_library->begin_add (uri);
+    s_progress_timer.start (PROGRESS_INTERVAL, update_progress);
+}
+
 static void search_init ()
 {
     s_library = new Library;
 
     if (aud_get_bool (CFG_ID, "rescan_on_startup"))
-        s_library->begin_add (get_uri ());
+        begin_add (get_uri ());
 
     s_library->check_ready_and_update (true);
 }
@@ -200,6 +239,7 @@ static void search_init ()
 static void search_cleanup ()
 {
     s_search_timer.stop ();
+    s_progress_timer.stop ();
     s_search_pending = false;
 
     delete s_library;
@@ -424,7 +464,7 @@ static void refresh_cb (GtkButton * button, GtkWidget * file_entry)
         StringBuf path = uri_to_filename (uri);
         aud_set_str (CFG_ID, "path", path ? path : uri);
 
-        s_library->begin_add (uri);
+        begin_add (uri);
         s_library->check_ready_and_update (true);
     }
 }
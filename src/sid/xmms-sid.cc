@@ -34,6 +34,11 @@
 #include "xs_config.h"
 #include "xs_sidplay2.h"
 
+#include "../render-common/measure.h"
+
+/* how long to render a tune of unknown length before giving up on it */
+#define MEASURE_MAX_LENGTH (5 * 60 * 1000)
+
 class SIDPlugin : public InputPlugin
 {
 public:
@@ -255,6 +260,30 @@ static void xs_fill_subtunes(Tuple &tuple, const xs_tuneinfo_t &info)
     tuple.set_subtunes (subtunes.len (), subtunes.begin ());
 }
 
+/*
+ * Measure the length (if unknown) and loudness of a sub-tune
+ */
+static void xs_measure(Tuple &tuple, const xs_tuneinfo_t &info, const Index<char> &buf, int subTune)
+{
+    if (subTune < 1 || subTune > info.nsubTunes)
+        subTune = info.startTune;
+    if (subTune < 1 || subTune > info.nsubTunes)
+        return;
+
+    int length = info.subTunes[subTune - 1].tuneLength;
+    int maxLength = xs_cfg.playMaxTimeEnable ? xs_cfg.playMaxTime * 1000 : MEASURE_MAX_LENGTH;
+
+    TrackMeter meter(xs_cfg.audioFrequency, xs_cfg.audioChannels);
+
+    if (!xs_sidplayfp_render(buf.begin(), buf.len(), subTune, length, maxLength, meter))
+        return;
+
+    if (length < 0 && meter.silent())
+        tuple.set_int(Tuple::Length, meter.end_time());
+
+    meter.apply(tuple);
+}
+
 bool SIDPlugin::read_tag(const char *filename, VFSFile &file, Tuple &tuple, Index<char> *image)
 {
     if (!delayed_init())
@@ -276,6 +305,8 @@ bool SIDPlugin::read_tag(const char *filename, VFSFile &file, Tuple &tuple, Inde
 
     if (xs_cfg.subAutoEnable && info.nsubTunes > 1 && tune < 0)
         xs_fill_subtunes(tuple, info);
+    else if (xs_cfg.measure)
+        xs_measure(tuple, info, buf, tune);
 
     return true;
 }
@@ -46,6 +46,7 @@ static constexpr const char * const defaults[] = {
     "playMaxTime", "150",
     "playMinTimeEnable", "FALSE",
     "playMinTime", "15",
+    "measure", "FALSE",
     "subAutoEnable", "TRUE",
     "subAutoMinOnly", "TRUE",
     "subAutoMinTime", "15",
@@ -93,6 +94,8 @@ static constexpr PreferencesWidget widgets[] = {
         WidgetInt("sid", "playMinTime"),
         {5, 3600, 5, N_("seconds")},
         WIDGET_CHILD),
+    WidgetCheck(N_("Measure song length and loudness"),
+        WidgetBool("sid", "measure")),
     WidgetLabel(N_("<b>Subtunes</b>")),
     WidgetCheck(N_("Enable subtunes"),
         WidgetBool("sid", "subAutoEnable")),
@@ -134,6 +137,8 @@ void xs_init_configuration()
     xs_cfg.playMinTimeEnable = aud_get_bool("sid", "playMinTimeEnable");
     xs_cfg.playMinTime = aud_get_int("sid", "playMinTime");
 
+    xs_cfg.measure = aud_get_bool("sid", "measure");
+
     xs_cfg.subAutoEnable = aud_get_bool("sid", "subAutoEnable");
     xs_cfg.subAutoMinOnly = aud_get_bool("sid", "subAutoMinOnly");
     xs_cfg.subAutoMinTime = aud_get_int("sid", "subAutoMinTime");
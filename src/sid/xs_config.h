@@ -47,6 +47,8 @@ extern struct xs_cfg_t {
     bool    playMinTimeEnable;
     int     playMinTime;        /* MIN playtime in seconds */
 
+    bool    measure;            /* render tunes to measure length and loudness */
+
     /* Miscellaneous settings */
     bool    subAutoEnable,
             subAutoMinOnly;
@@ -40,10 +40,20 @@
 #include <libaudcore/runtime.h>
 #include <libaudcore/vfs.h>
 
+#include "../render-common/measure.h"
+
+/* An emulator instance: one for playback and one for each offline render,
+ * so that rendering can run alongside playback and other renders. */
+struct SidEngine {
+    sidplayfp *eng = nullptr;
+    sidbuilder *builder = nullptr;
+    SidTune *tune = nullptr;
+};
+
 struct SidState {
-    sidplayfp *currEng;
-    sidbuilder *currBuilder;
-    SidTune *currTune;
+    SidEngine playback;
+
+    Index<char> kernal, basic, chargen;
 
     SidDatabase database;
     bool database_loaded = false;
@@ -64,15 +74,28 @@ bool xs_sidplayfp_probe(const void *buf, int64_t bufSize)
 }
 
 
-/* Initialize SIDPlayFP
+static void xs_engine_destroy(SidEngine &engine)
+{
+    delete engine.builder;
+    engine.builder = nullptr;
+
+    delete engine.eng;
+    engine.eng = nullptr;
+
+    delete engine.tune;
+    engine.tune = nullptr;
+}
+
+
+/* Set up an emulator instance according to the configuration
  */
-bool xs_sidplayfp_init()
+static bool xs_engine_create(SidEngine &engine)
 {
     /* Initialize the engine */
-    state.currEng = new sidplayfp;
+    engine.eng = new sidplayfp;
 
     /* Get current configuration */
-    SidConfig config = state.currEng->config();
+    SidConfig config = engine.eng->config();
 
     /* Configure channels and stuff */
     switch (xs_cfg.audioChannels)
@@ -90,38 +113,28 @@ bool xs_sidplayfp_init()
     config.frequency = xs_cfg.audioFrequency;
 
     /* Initialize builder object */
-    state.currBuilder = new ReSIDfpBuilder("ReSIDfp builder");
+    engine.builder = new ReSIDfpBuilder("ReSIDfp builder");
 
     /* Builder object created, initialize it */
-    state.currBuilder->create(state.currEng->info().maxsids());
-    if (!state.currBuilder->getStatus()) {
+    engine.builder->create(engine.eng->info().maxsids());
+    if (!engine.builder->getStatus()) {
         AUDERR("reSID->create() failed.\n");
         return false;
     }
 
-    state.currBuilder->filter(xs_cfg.emulateFilters);
-    if (!state.currBuilder->getStatus()) {
+    engine.builder->filter(xs_cfg.emulateFilters);
+    if (!engine.builder->getStatus()) {
         AUDERR("reSID->filter(%d) failed.\n", xs_cfg.emulateFilters);
         return false;
     }
 
-    config.sidEmulation = state.currBuilder;
+    config.sidEmulation = engine.builder;
 
-    /* Clockspeed settings */
-    switch (xs_cfg.clockSpeed) {
-    case XS_CLOCK_NTSC:
+    /* Clockspeed settings (checked in xs_sidplayfp_init) */
+    if (xs_cfg.clockSpeed == XS_CLOCK_NTSC)
         config.defaultC64Model = SidConfig::NTSC;
-        break;
-
-    default:
-        AUDERR("[SIDPlayFP] Invalid clockSpeed=%d, falling back to PAL.\n",
-            xs_cfg.clockSpeed);
-
-    case XS_CLOCK_PAL:
+    else
         config.defaultC64Model = SidConfig::PAL;
-        xs_cfg.clockSpeed = XS_CLOCK_PAL;
-        break;
-    }
 
     config.forceC64Model = xs_cfg.forceSpeed;
 
@@ -134,11 +147,31 @@ bool xs_sidplayfp_init()
     config.forceSidModel = xs_cfg.forceModel;
 
     /* Now set the emulator configuration */
-    if (!state.currEng->config(config)) {
+    if (!engine.eng->config(config)) {
         AUDERR("[SIDPlayFP] Emulator engine configuration failed!\n");
         return false;
     }
 
+    if (state.kernal.len())
+        engine.eng->setRoms((uint8_t*)state.kernal.begin(), (uint8_t*)state.basic.begin(), (uint8_t*)state.chargen.begin());
+
+    /* Create the sidtune */
+    engine.tune = new SidTune(0);
+
+    return true;
+}
+
+
+/* Initialize SIDPlayFP
+ */
+bool xs_sidplayfp_init()
+{
+    if (xs_cfg.clockSpeed != XS_CLOCK_NTSC && xs_cfg.clockSpeed != XS_CLOCK_PAL) {
+        AUDERR("[SIDPlayFP] Invalid clockSpeed=%d, falling back to PAL.\n",
+            xs_cfg.clockSpeed);
+        xs_cfg.clockSpeed = XS_CLOCK_PAL;
+    }
+
     /* Load ROMs */
     VFSFile kernal_file("file://" SIDDATADIR "/sidplayfp/kernal", "r");
     VFSFile basic_file("file://" SIDDATADIR "/sidplayfp/basic", "r");
@@ -151,16 +184,17 @@ bool xs_sidplayfp_init()
         Index<char> chargen = chargen_file.read_all();
 
         if (kernal.len() == 8192 && basic.len() == 8192 && chargen.len() == 4096)
-            state.currEng->setRoms((uint8_t*)kernal.begin(), (uint8_t*)basic.begin(), (uint8_t*)chargen.begin());
+        {
+            state.kernal = std::move(kernal);
+            state.basic = std::move(basic);
+            state.chargen = std::move(chargen);
+        }
     }
 
     /* Load song length database */
     state.database_loaded = state.database.open(SIDDATADIR "/sidplayfp/Songlengths.md5");
 
-    /* Create the sidtune */
-    state.currTune = new SidTune(0);
-
-    return true;
+    return xs_engine_create(state.playback);
 }
 
 
@@ -169,36 +203,25 @@ bool xs_sidplayfp_init()
 void xs_sidplayfp_close()
 {
     /* Free internals */
-    if (state.currBuilder) {
-        delete state.currBuilder;
-        state.currBuilder = nullptr;
-    }
-
-    if (state.currEng) {
-        delete state.currEng;
-        state.currEng = nullptr;
-    }
+    xs_engine_destroy(state.playback);
 
-    if (state.currTune) {
-        delete state.currTune;
-        state.currTune = nullptr;
-    }
+    state.kernal.clear();
+    state.basic.clear();
+    state.chargen.clear();
 
     if (state.database_loaded)
         state.database.close();
 }
 
 
-/* Initialize current song and sub-tune
- */
-bool xs_sidplayfp_initsong(int subtune)
+static bool xs_engine_initsong(SidEngine &engine, int subtune)
 {
-    if (!state.currTune->selectSong(subtune)) {
+    if (!engine.tune->selectSong(subtune)) {
         AUDERR("[SIDPlayFP] currTune->selectSong() failed\n");
         return false;
     }
 
-    if (!state.currEng->load(state.currTune)) {
+    if (!engine.eng->load(engine.tune)) {
         AUDERR("[SIDPlayFP] currEng->load() failed\n");
         return false;
     }
@@ -207,11 +230,19 @@ bool xs_sidplayfp_initsong(int subtune)
 }
 
 
+/* Initialize current song and sub-tune
+ */
+bool xs_sidplayfp_initsong(int subtune)
+{
+    return xs_engine_initsong(state.playback, subtune);
+}
+
+
 /* Emulate and render audio data to given buffer
  */
 unsigned xs_sidplayfp_fillbuffer(char * audioBuffer, unsigned audioBufSize)
 {
-    return state.currEng->play((short *)audioBuffer, audioBufSize / 2) * 2;
+    return state.playback.eng->play((short *)audioBuffer, audioBufSize / 2) * 2;
 }
 
 
@@ -220,9 +251,47 @@ unsigned xs_sidplayfp_fillbuffer(char * audioBuffer, unsigned audioBufSize)
 bool xs_sidplayfp_load(const void *buf, int64_t bufSize)
 {
     /* Try to get the tune */
-    state.currTune->read((const uint8_t*)buf, bufSize);
+    state.playback.tune->read((const uint8_t*)buf, bufSize);
+
+    return state.playback.tune->getStatus();
+}
+
+
+/* Render a sub-tune into the meter on a private emulator instance, as fast
+ * as it runs.  A sub-tune of known length is rendered to its end; SID tunes
+ * never end by themselves, so any other is rendered until it falls silent,
+ * for at most maxLength milliseconds.
+ */
+bool xs_sidplayfp_render(const void *buf, int64_t bufSize, int subtune,
+    int length, int maxLength, TrackMeter &meter)
+{
+    SidEngine engine;
+    bool success = false;
+
+    if (xs_engine_create(engine))
+    {
+        engine.tune->read((const uint8_t*)buf, bufSize);
+
+        if (engine.tune->getStatus() && xs_engine_initsong(engine, subtune))
+        {
+            int16_t audioBuffer[4096];
+
+            while (length >= 0 ? meter.time() < length :
+                   (!meter.silent() && meter.time() < maxLength))
+            {
+                unsigned samples = engine.eng->play(audioBuffer, aud::n_elems(audioBuffer));
+                if (!samples)
+                    break;
+
+                meter.add(audioBuffer, samples);
+            }
+
+            success = true;
+        }
+    }
 
-    return state.currTune->getStatus();
+    xs_engine_destroy(engine);
+    return success;
 }
 
 
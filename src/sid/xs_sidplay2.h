@@ -5,6 +5,8 @@
 
 #include <stdint.h>
 
+class TrackMeter;
+
 bool xs_sidplayfp_probe(const void *buf, int64_t bufSize);
 void xs_sidplayfp_close();
 bool xs_sidplayfp_init();
@@ -12,5 +14,7 @@ bool xs_sidplayfp_initsong(int subtune);
 unsigned xs_sidplayfp_fillbuffer(char *, unsigned);
 bool xs_sidplayfp_load(const void *buf, int64_t bufSize);
 bool xs_sidplayfp_getinfo(xs_tuneinfo_t &ti, const void *buf, int64_t bufSize);
+bool xs_sidplayfp_render(const void *buf, int64_t bufSize, int subtune,
+    int length, int maxLength, TrackMeter &meter);
 
 #endif /* XS_SIDPLAYFP_H */
@@ -25,6 +25,8 @@
 
 #include <math.h>
 
+#include "../effect-common/profile.h"
+
 #define MAX_BUFFER_SECS  10
 
 class SilenceRemoval : public EffectPlugin
@@ -54,6 +56,8 @@ public:
 
 EXPORT SilenceRemoval aud_plugin_instance;
 
+static EffectProfile profile (N_("Silence Removal"));
+
 const char SilenceRemoval::about[] =
  N_("Silence Removal Plugin for Audacious\n"
     "Copyright 2014 John Lindgren");
@@ -91,6 +95,8 @@ void SilenceRemoval::cleanup ()
 
 void SilenceRemoval::start (int & channels, int & rate)
 {
+    profile.start (channels, rate);
+
     buffer.discard ();
     buffer.alloc (channels * rate * MAX_BUFFER_SECS);
     output.resize (0);
@@ -133,6 +139,8 @@ static void buffer_with_overflow (const float * data, int len)
 
 Index<float> & SilenceRemoval::process (Index<float> & data)
 {
+    EffectProfile::Timer timer (profile, data);
+
     const int threshold_db = aud_get_int ("silence-removal", "threshold");
     const float threshold = powf (10.0f, threshold_db / 20.0f);
 
@@ -28,6 +28,8 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/profile.h"
+
 #define MIN_RATE 8000
 #define MAX_RATE 192000
 #define RATE_STEP 50
@@ -60,6 +62,8 @@ public:
 
 EXPORT SoXResampler aud_plugin_instance;
 
+static EffectProfile profile (N_("SoX Resampler"));
+
 const char * const SoXResampler::defaults[] = {
     "quality", aud::numeric_string<SOXR_HQ>::str,
     "rate", "44100",
@@ -95,6 +99,8 @@ void SoXResampler::cleanup ()
 
 void SoXResampler::start (int & channels, int & rate)
 {
+    profile.start (channels, rate);
+
     soxr_delete (soxr);
     soxr = 0;
 
@@ -130,6 +136,8 @@ void SoXResampler::start (int & channels, int & rate)
 
 Index<float> & SoXResampler::process (Index<float> & data)
 {
+    EffectProfile::Timer timer (profile, data);
+
     if (! soxr)
          return data;
 
@@ -25,6 +25,17 @@
 #include <libaudcore/runtime.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
+#include <libaudcore/ringbuf.h>
+
+#include "../effect-common/profile.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define USE_X86_KERNELS
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_NEON_KERNELS
+#endif
 
 /* The general idea of the speed change algorithm is to divide the input signal
  * into pieces, spaced at a time interval A, using a cosine-shaped window
@@ -35,6 +46,16 @@
 #define FREQ    10
 #define OVERLAP  3
 
+/* In WSOLA (waveform-similarity overlap-add) mode, each piece may be moved by up
+ * to WSOLA_SEARCH_MS from its nominal position in the input, to wherever it
+ * best lines up with the natural continuation of the previous piece.  This
+ * avoids the phasing of plain overlap-add.  The pieces overlap by half and are
+ * kept short so that the added latency stays under 20 ms. */
+
+#define WSOLA_WINDOW_MS 12
+#define WSOLA_SEARCH_MS  4
+#define WSOLA_CHUNK   1024 /* frames passed through the resampler at a time */
+
 #define CFGSECT "speed-pitch"
 #define MINSPEED 0.5
 #define MAXSPEED 2.0
@@ -77,6 +98,8 @@ private:
 
 EXPORT SpeedPitch aud_plugin_instance;
 
+static EffectProfile profile (N_("Speed and Pitch"));
+
 static double semitones;
 static int curchans, currate;
 static SRC_STATE * srcstate;
@@ -85,6 +108,140 @@ static Index<float> cosine;
 static Index<float> in, out;
 static int src, dst;
 
+static bool cfg_decouple, cfg_wsola;
+static float cfg_speed, cfg_pitch;
+
+/* WSOLA state.  All working buffers are allocated in start().  Positions are in
+ * frames, relative to the start of wsola_in. */
+static bool wsola_active;
+static int wsola_hop, wsola_search;
+static Index<float> wsola_window;
+static Index<float> wsola_pitched;
+static Index<float> wsola_tail;
+static Index<float> wsola_out;
+static Index<float> wsola_ref, wsola_region;
+static Index<double> wsola_energy;
+static RingBuf<float> wsola_in;
+static double wsola_pos;  /* nominal start of the next piece */
+static double wsola_read;  /* total distance wsola_pos has advanced */
+static bool wsola_have_prev;  /* false until the first piece is copied */
+static int wsola_prev;  /* start of the previous piece, from -wsola_hop up */
+
+struct Kernels {
+    float (* dot) (const float * a, const float * b, int length);
+};
+
+static float dot_generic (const float * a, const float * b, int length)
+{
+    float sum = 0;
+
+    for (int i = 0; i < length; i ++)
+        sum += a[i] * b[i];
+
+    return sum;
+}
+
+#ifdef USE_X86_KERNELS
+
+__attribute__ ((target ("sse2")))
+static float dot_sse2 (const float * a, const float * b, int length)
+{
+    __m128 sum0 = _mm_setzero_ps ();
+    __m128 sum1 = _mm_setzero_ps ();
+
+    int i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        sum0 = _mm_add_ps (sum0, _mm_mul_ps (_mm_loadu_ps (a + i), _mm_loadu_ps (b + i)));
+        sum1 = _mm_add_ps (sum1, _mm_mul_ps (_mm_loadu_ps (a + i + 4), _mm_loadu_ps (b + i + 4)));
+    }
+
+    float part[4];
+    _mm_storeu_ps (part, _mm_add_ps (sum0, sum1));
+
+    return part[0] + part[1] + part[2] + part[3] +
+     dot_generic (a + i, b + i, length - i);
+}
+
+__attribute__ ((target ("avx2,fma")))
+static float dot_avx2 (const float * a, const float * b, int length)
+{
+    __m256 sum0 = _mm256_setzero_ps ();
+    __m256 sum1 = _mm256_setzero_ps ();
+
+    int i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        sum0 = _mm256_fmadd_ps (_mm256_loadu_ps (a + i), _mm256_loadu_ps (b + i), sum0);
+        sum1 = _mm256_fmadd_ps (_mm256_loadu_ps (a + i + 8), _mm256_loadu_ps (b + i + 8), sum1);
+    }
+
+    float part[8];
+    _mm256_storeu_ps (part, _mm256_add_ps (sum0, sum1));
+
+    float sum = 0;
+    for (float p : part)
+        sum += p;
+
+    return sum + dot_generic (a + i, b + i, length - i);
+}
+
+#endif // USE_X86_KERNELS
+
+#ifdef USE_NEON_KERNELS
+
+static float dot_neon (const float * a, const float * b, int length)
+{
+    float32x4_t sum0 = vdupq_n_f32 (0);
+    float32x4_t sum1 = vdupq_n_f32 (0);
+
+    int i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        sum0 = vmlaq_f32 (sum0, vld1q_f32 (a + i), vld1q_f32 (b + i));
+        sum1 = vmlaq_f32 (sum1, vld1q_f32 (a + i + 4), vld1q_f32 (b + i + 4));
+    }
+
+    float part[4];
+    vst1q_f32 (part, vaddq_f32 (sum0, sum1));
+
+    return part[0] + part[1] + part[2] + part[3] +
+     dot_generic (a + i, b + i, length - i);
+}
+
+#endif // USE_NEON_KERNELS
+
+static Kernels kernels = {dot_generic};
+
+static void select_kernels ()
+{
+#ifdef USE_X86_KERNELS
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma"))
+    {
+        AUDDBG ("Using AVX2 kernels.\n");
+        kernels = {dot_avx2};
+    }
+    else if (__builtin_cpu_supports ("sse2"))
+    {
+        AUDDBG ("Using SSE2 kernels.\n");
+        kernels = {dot_sse2};
+    }
+#elif defined(USE_NEON_KERNELS)
+    AUDDBG ("Using NEON kernels.\n");
+    kernels = {dot_neon};
+#endif
+}
+
+static void update_config ()
+{
+    cfg_decouple = aud_get_bool (CFGSECT, "decouple");
+    cfg_wsola = aud_get_bool (CFGSECT, "wsola");
+    cfg_speed = aud_get_double (CFGSECT, "speed");
+    cfg_pitch = aud_get_double (CFGSECT, "pitch");
+}
+
 static void add_data (Index<float> & b, Index<float> & data, float ratio)
 {
     int oldlen = b.len ();
@@ -119,11 +276,20 @@ bool SpeedPitch::flush (bool force)
      * the width of a cosine window. */
     out.insert (0, width / 2);
 
+    wsola_active = cfg_wsola;
+    wsola_in.discard ();
+    wsola_tail.erase (0, -1);
+    wsola_pos = 0;
+    wsola_read = 0;
+    wsola_have_prev = false;
+
     return true;
 }
 
 void SpeedPitch::start (int & chans, int & rate)
 {
+    profile.start (chans, rate);
+
     curchans = chans;
     currate = rate;
 
@@ -144,19 +310,223 @@ void SpeedPitch::start (int & chans, int & rate)
     for (int i = 0; i < width; i ++)
         cosine[i] = (1.0 - cos (2.0 * M_PI * i / width)) / OVERLAP;
 
+    /* The WSOLA window is a Hann window of two hops, so that two overlapping
+     * pieces always sum to unity gain. */
+    wsola_hop = currate * WSOLA_WINDOW_MS / 2000;
+    wsola_search = currate * WSOLA_SEARCH_MS / 1000;
+
+    wsola_window.resize (2 * wsola_hop);
+    for (int i = 0; i < 2 * wsola_hop; i ++)
+        wsola_window[i] = 0.5 * (1.0 - cos (M_PI * i / wsola_hop));
+
+    /* Resampling for pitch at most doubles a chunk.  The ring buffer must hold
+     * a piece, the search range around it, and the distance the input advances
+     * per hop at the maximum stretch ratio (MAXSPEED / MINPITCH). */
+    int max_advance = (int) ceil (wsola_hop * MAXSPEED / MINPITCH);
+
+    wsola_pitched.resize ((2 * WSOLA_CHUNK + 256) * curchans);
+    wsola_tail.resize (wsola_hop * curchans);
+    wsola_ref.resize (wsola_hop);
+    wsola_region.resize (2 * wsola_search + wsola_hop + 1);
+    wsola_energy.resize (2 * wsola_search + wsola_hop + 2);
+
+    wsola_in.discard ();
+    wsola_in.alloc ((4 * wsola_hop + 4 * wsola_search + 2 * max_advance) * curchans);
+
     flush (true);
 }
 
+/* Sums the channels of a range of frames in the WSOLA input buffer. */
+static void wsola_downmix (float * to, int frame, int frames)
+{
+    int i = frame * curchans;
+
+    for (int f = 0; f < frames; f ++)
+    {
+        float sum = 0;
+
+        for (int c = 0; c < curchans; c ++)
+            sum += wsola_in[i ++];
+
+        to[f] = sum;
+    }
+}
+
+/* Finds the piece start in [lo, hi] whose first half best matches the input
+ * starting at <ref>, by normalized cross-correlation of the mono downmix. */
+static int wsola_find (int ref, int lo, int hi)
+{
+    int hop = wsola_hop;
+    int span = hi - lo + hop;
+
+    const float * r = wsola_ref.begin ();
+    const float * region = wsola_region.begin ();
+    double * energy = wsola_energy.begin ();
+
+    wsola_downmix (wsola_ref.begin (), ref, hop);
+    wsola_downmix (wsola_region.begin (), lo, span);
+
+    energy[0] = 0;
+    for (int i = 0; i < span; i ++)
+        energy[i + 1] = energy[i] + (double) region[i] * region[i];
+
+    int best = lo;
+    float best_score = -INFINITY;
+
+    for (int c = lo; c <= hi; c ++)
+    {
+        float corr = kernels.dot (r, region + (c - lo), hop);
+        float e = energy[c - lo + hop] - energy[c - lo];
+        float score = corr / sqrtf (e + 1e-9f);
+
+        if (score > best_score)
+        {
+            best = c;
+            best_score = score;
+        }
+    }
+
+    return best;
+}
+
+/* Copies one hop of output, if there is enough input buffered to do so. */
+static bool wsola_step (float ratio)
+{
+    int frames = wsola_in.len () / curchans;
+    int hop = wsola_hop;
+    int nominal = (int) wsola_pos;
+    int lo = aud::max (0, nominal - wsola_search);
+    int hi = nominal + wsola_search;
+
+    if (hi + 2 * hop > frames)
+        return false;
+
+    int best = wsola_have_prev ? wsola_find (wsola_prev + hop, lo, hi) : nominal;
+
+    /* Overlap the first half of the new piece with the second half of the
+     * previous one, and keep the second half of the new piece for next time. */
+    int len = wsola_out.len ();
+    wsola_out.insert (-1, hop * curchans);
+
+    float * o = & wsola_out[len];
+    float * tail = wsola_tail.begin ();
+    const float * window = wsola_window.begin ();
+    int head = best * curchans;
+    int mid = (best + hop) * curchans;
+
+    for (int f = 0, i = 0; f < hop; f ++)
+    {
+        float w1 = window[f];
+        float w2 = window[hop + f];
+
+        for (int c = 0; c < curchans; c ++, i ++)
+        {
+            o[i] = tail[i] + wsola_in[head + i] * w1;
+            tail[i] = wsola_in[mid + i] * w2;
+        }
+    }
+
+    wsola_have_prev = true;
+    wsola_prev = best;
+    wsola_pos += hop * ratio;
+    wsola_read += hop * ratio;
+
+    /* Keep the continuation of this piece and the next search range.  The
+     * start of the piece itself may be dropped, leaving wsola_prev negative. */
+    int drop = aud::min (wsola_prev + hop, (int) wsola_pos - wsola_search);
+    if (drop > 0)
+    {
+        wsola_in.discard (drop * curchans);
+        wsola_prev -= drop;
+        wsola_pos -= drop;
+    }
+
+    return true;
+}
+
+static void wsola_feed (const float * data, int samples, float ratio)
+{
+    while (samples > 0)
+    {
+        int copy = aud::min (samples, wsola_in.space ());
+        wsola_in.copy_in (data, copy);
+
+        data += copy;
+        samples -= copy;
+
+        while (wsola_step (ratio))
+            ;
+    }
+}
+
+static Index<float> & process_wsola (Index<float> & data, bool ending)
+{
+    float ratio = cfg_speed / cfg_pitch;
+    int frames = data.len () / curchans;
+
+    wsola_out.resize (0);
+
+    /* Resample for pitch a chunk at a time, into a fixed buffer. */
+    for (int f = 0; f < frames; f += WSOLA_CHUNK)
+    {
+        SRC_DATA d = SRC_DATA ();
+
+        d.data_in = & data[f * curchans];
+        d.input_frames = aud::min (frames - f, WSOLA_CHUNK);
+        d.data_out = wsola_pitched.begin ();
+        d.output_frames = wsola_pitched.len () / curchans;
+        d.src_ratio = 1.0 / cfg_pitch;
+
+        src_process (srcstate, & d);
+        wsola_feed (wsola_pitched.begin (), d.output_frames_gen * curchans, ratio);
+    }
+
+    if (ending)
+    {
+        /* Pad with silence until the last of the input has been copied, then
+         * add what is left of the last piece. */
+        double target = wsola_read + (wsola_in.len () / curchans - wsola_pos);
+
+        wsola_pitched.erase (0, -1);
+
+        while (wsola_read < target)
+            wsola_feed (wsola_pitched.begin (), wsola_hop * curchans, ratio);
+
+        wsola_out.insert (wsola_tail.begin (), -1, wsola_tail.len ());
+
+        src_reset (srcstate);
+        wsola_in.discard ();
+        wsola_tail.erase (0, -1);
+        wsola_pos = 0;
+        wsola_read = 0;
+        wsola_have_prev = false;
+    }
+
+    /* Hand the output buffer to the caller and keep its old one for next time,
+     * so that neither needs to be reallocated. */
+    std::swap (data, wsola_out);
+
+    return data;
+}
+
 Index<float> & SpeedPitch::process (Index<float> & data, bool ending)
 {
+    EffectProfile::Timer timer (profile, data);
+
     const float * cosine_center = & cosine[width / 2];
-    float pitch = aud_get_double (CFGSECT, "pitch");
-    float speed = aud_get_double (CFGSECT, "speed");
+    float pitch = cfg_pitch;
+    float speed = cfg_speed;
+
+    if (cfg_decouple && cfg_wsola != wsola_active)
+        flush (true);
+
+    if (cfg_decouple && wsola_active)
+        return process_wsola (data, ending);
 
     /* Copy the passed audio to the input buffer, scaled to adjust pitch. */
     add_data (in, data, 1.0 / pitch);
 
-    if (! aud_get_bool (CFGSECT, "decouple"))
+    if (! cfg_decouple)
     {
         data = std::move (in);
         return data;
@@ -203,14 +573,20 @@ Index<float> & SpeedPitch::process (Index<float> & data, bool ending)
 
 int SpeedPitch::adjust_delay (int delay)
 {
-    if (! aud_get_bool (CFGSECT, "decouple"))
+    if (! cfg_decouple)
         return delay;
 
     float samples_to_ms = 1000.0 / (curchans * currate);
-    float speed = aud_get_double (CFGSECT, "speed");
+    float speed = cfg_speed;
     int in_samples = in.len () - src;
     int out_samples = dst;
 
+    if (wsola_active)
+    {
+        in_samples = wsola_in.len () - (int) wsola_pos * curchans;
+        out_samples = wsola_tail.len ();
+    }
+
     return (delay + in_samples * samples_to_ms) * speed + out_samples * samples_to_ms;
 }
 
@@ -221,6 +597,8 @@ static void sync_speed ()
         aud_set_double (CFGSECT, "speed", aud_get_double (CFGSECT, "pitch"));
         hook_call ("speed-pitch set speed", nullptr);
     }
+
+    update_config ();
 }
 
 static void pitch_changed ()
@@ -239,6 +617,7 @@ static void semitones_changed ()
 
 const char * const SpeedPitch::defaults[] = {
  "decouple", "TRUE",
+ "wsola", "FALSE",
  "speed", "1",
  "pitch", "1",
  nullptr};
@@ -248,9 +627,12 @@ const PreferencesWidget SpeedPitch::widgets[] = {
     WidgetCheck (N_("Decouple from pitch"),
         WidgetBool (CFGSECT, "decouple", sync_speed)),
     WidgetSpin (N_("Multiplier:"),
-        WidgetFloat (CFGSECT, "speed", nullptr, "speed-pitch set speed"),
+        WidgetFloat (CFGSECT, "speed", update_config, "speed-pitch set speed"),
         {MINSPEED, MAXSPEED, 0.05},
         WIDGET_CHILD),
+    WidgetCheck (N_("Align pieces by waveform similarity (WSOLA)"),
+        WidgetBool (CFGSECT, "wsola", update_config),
+        WIDGET_CHILD),
     WidgetLabel (N_("<b>Pitch</b>")),
     WidgetSpin (nullptr,
         WidgetFloat (semitones, semitones_changed, "speed-pitch set semitones"),
@@ -266,6 +648,7 @@ const PluginPreferences SpeedPitch::prefs = {{widgets}};
 bool SpeedPitch::init ()
 {
     aud_config_set_defaults (CFGSECT, defaults);
+    select_kernels ();
     pitch_changed ();
     return true;
 }
@@ -280,4 +663,13 @@ void SpeedPitch::cleanup ()
     cosine.clear ();
     in.clear ();
     out.clear ();
+
+    wsola_window.clear ();
+    wsola_pitched.clear ();
+    wsola_tail.clear ();
+    wsola_out.clear ();
+    wsola_ref.clear ();
+    wsola_region.clear ();
+    wsola_energy.clear ();
+    wsola_in.destroy ();
 }
@@ -7,6 +7,8 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/profile.h"
+
 class ExtraStereo : public EffectPlugin
 {
 public:
@@ -32,6 +34,8 @@ public:
 
 EXPORT ExtraStereo aud_plugin_instance;
 
+static EffectProfile profile (N_("Extra Stereo"));
+
 const char ExtraStereo::about[] =
  N_("Extra Stereo Plugin\n\n"
     "By Johan Levin, 1999");
@@ -59,11 +63,15 @@ static int stereo_channels;
 
 void ExtraStereo::start (int & channels, int & rate)
 {
+    profile.start (channels, rate);
+
     stereo_channels = channels;
 }
 
 Index<float> & ExtraStereo::process(Index<float> & data)
 {
+    EffectProfile::Timer timer (profile, data);
+
     float value = aud_get_double ("extra_stereo", "intensity");
     float * f, * end;
     float center;
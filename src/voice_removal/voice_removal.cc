@@ -21,6 +21,8 @@
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
 
+#include "../effect-common/profile.h"
+
 class VoiceRemoval : public EffectPlugin
 {
 public:
@@ -37,15 +39,21 @@ public:
 
 EXPORT VoiceRemoval aud_plugin_instance;
 
+static EffectProfile profile (N_("Voice Removal"));
+
 static int voice_channels;
 
 void VoiceRemoval::start (int & channels, int & rate)
 {
+    profile.start (channels, rate);
+
     voice_channels = channels;
 }
 
 Index<float> & VoiceRemoval::process (Index<float> & data)
 {
+    EffectProfile::Timer timer (profile, data);
+
     if (voice_channels != 2)
         return data;
 
@@ -1,6 +1,7 @@
 /* AY/YM emulator implementation. */
 
 #include <inttypes.h>
+#include <pthread.h>
 #include "ayemu.h"
 
 #include <libaudcore/runtime.h>
@@ -19,7 +20,7 @@ enum {
 };
 
 /* sound chip volume envelops (will calculated by gen_env()) */
-static int bEnvGenInit = 0;
+static pthread_once_t EnvGenOnce = PTHREAD_ONCE_INIT;
 static int Envelope [16][128];
 
 
@@ -82,7 +83,7 @@ static int check_magic(ayemu_ay_t *ay)
 
 
 /* make chip hardware envelop tables.
-    Will execute once before first use. */
+    Will execute once before first use, by whichever chip gets there first. */
 static void gen_env()
 {
   int env;
@@ -115,7 +116,6 @@ static void gen_env()
       Envelope[env][pos] = vol;
     }
   }
-  bEnvGenInit = 1;
 }
 
 
@@ -359,7 +359,7 @@ static void prepare_generation(ayemu_ay_t *ay)
 
   if (!ay->dirty) return;
 
-  if (!bEnvGenInit) gen_env ();
+  pthread_once (&EnvGenOnce, gen_env);
 
   if (ay->default_chip_flag) ayemu_set_chip_type(ay, AYEMU_AY, nullptr);
 
@@ -6,6 +6,7 @@
 #include <limits.h>
 
 #include <libaudcore/runtime.h>
+#include <libaudcore/threads.h>
 
 #include "vtx.h"
 
@@ -46,6 +47,9 @@ static unsigned short c_table[4096], pt_table[256];
 
 static int j;  /* remaining bytes to copy */
 
+/* the decoder state above is shared, so files are unpacked one at a time */
+static aud::mutex decode_mutex;
+
 class DecodeError {}; // exception
 
 static void error(const char *msg)
@@ -276,6 +280,7 @@ bool lh5_decode(const Index<char> &in, Index<unsigned char> &out)
 {
   unsigned short n;
   Index<unsigned char> buffer;
+  auto mh = decode_mutex.take();
 
   compsize = in.len();
   origsize = out.len();
@@ -23,26 +23,35 @@
 #include <libaudcore/audstrings.h>
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
 #include <libaudcore/runtime.h>
 
 #include "vtx.h"
 #include "ayemu.h"
 
+#include "../render-common/measure.h"
+
 class VTXPlugin : public InputPlugin
 {
 public:
     static const char about[];
     static const char *const exts[];
+    static const char *const defaults[];
+    static const PreferencesWidget widgets[];
+    static const PluginPreferences prefs;
 
     static constexpr PluginInfo info = {
         N_("VTX Decoder"),
         PACKAGE,
-        about
+        about,
+        & prefs
     };
 
     constexpr VTXPlugin() : InputPlugin(info, InputInfo()
         .with_exts(exts)) {}
 
+    bool init();
+
     bool is_our_file(const char *filename, VFSFile &file);
     bool read_tag(const char *filename, VFSFile &file, Tuple &tuple, Index<char> *image);
     bool play(const char *filename, VFSFile &file);
@@ -56,13 +65,117 @@ public:
 EXPORT VTXPlugin aud_plugin_instance;
 
 #define SNDBUFSIZE 1024
-static char sndbuf[SNDBUFSIZE];
-static int freq = 44100;
-static int chans = 2;
-static int bits = 16;
+static const int freq = 44100;
+static const int chans = 2;
+static const int bits = 16;
 
 const char *const VTXPlugin::exts[] = { "vtx", nullptr };
 
+const char *const VTXPlugin::defaults[] = {
+    "measure", "FALSE",
+    nullptr
+};
+
+bool VTXPlugin::init()
+{
+    aud_config_set_defaults("vtx", defaults);
+    return true;
+}
+
+/* Everything needed to generate sound from an open file; play() and
+ * render_track() each have their own. */
+struct VTXPlayer
+{
+    ayemu_ay_t ay;
+    ayemu_vtx_t vtx;
+    int left = 0;   /* how many sound frames can play with current AY register frame */
+
+    bool open(const char *filename, VFSFile &file);
+    bool generate(char *buf, int bytes);
+};
+
+bool VTXPlayer::open(const char *filename, VFSFile &file)
+{
+    memset(&ay, 0, sizeof(ay));
+
+    if (!vtx.read_header(file))
+    {
+        AUDERR("Error read vtx header from %s\n", filename);
+        return false;
+    }
+    else if (!vtx.load_data(file))
+    {
+        AUDERR("Error read vtx data from %s\n", filename);
+        return false;
+    }
+
+    ayemu_init(&ay);
+    ayemu_set_chip_type(&ay, vtx.hdr.chiptype, nullptr);
+    ayemu_set_chip_freq(&ay, vtx.hdr.chipFreq);
+    ayemu_set_stereo(&ay, (ayemu_stereo_t) vtx.hdr.stereo, nullptr);
+
+    return true;
+}
+
+/* Fills the buffer with sound; returns false (padding with silence) once the
+ * register data runs out. */
+bool VTXPlayer::generate(char *buf, int bytes)
+{
+    void *stream = buf;         /* pointer to current position in sound buffer */
+    unsigned char regs[14];
+    int donow;
+    int rate = chans * (bits / 8);
+    bool eof = false;
+
+    for (int need = bytes / rate; need > 0; need -= donow)
+    {
+        if (left > 0)
+        {                   /* use current AY register frame */
+            donow = (need > left) ? left : need;
+            left -= donow;
+            stream = ayemu_gen_sound(&ay, (char *)stream, donow * rate);
+        }
+        else
+        {                   /* get next AY register frame */
+            if (!vtx.get_next_frame(regs))
+            {
+                donow = need;
+                memset(stream, 0, donow * rate);
+                eof = true;
+            }
+            else
+            {
+                left = freq / vtx.hdr.playerFreq;
+                ayemu_set_regs(&ay, regs);
+                donow = 0;
+            }
+        }
+    }
+
+    return !eof;
+}
+
+/* Renders a file into the meter without opening the output, as fast as the
+ * emulator runs.  VTX files always end, so there is no need for a limit. */
+static bool render_track(const char *filename, VFSFile &file, TrackMeter &meter)
+{
+    VTXPlayer player;
+    if (!player.open(filename, file))
+        return false;
+
+    int16_t buf[SNDBUFSIZE / 2];
+    bool more;
+
+    do
+    {
+        more = player.generate((char *)buf, sizeof buf);
+        meter.add(buf, SNDBUFSIZE / 2);
+    }
+    while (more);
+
+    return true;
+}
+
 bool VTXPlugin::is_our_file(const char *filename, VFSFile &file)
 {
     char buf[2];
@@ -93,81 +206,36 @@ bool VTXPlugin::read_tag(const char *filename, VFSFile &file, Tuple &tuple, Inde
 
     tuple.set_int(Tuple::Channels, chans);
 
+    if (aud_get_bool("vtx", "measure") && !file.fseek(0, VFS_SEEK_SET))
+    {
+        TrackMeter meter(freq, chans);
+        if (render_track(filename, file, meter))
+            meter.apply(tuple);
+    }
+
     return true;
 }
 
 bool VTXPlugin::play(const char *filename, VFSFile &file)
 {
-    ayemu_ay_t ay;
-    ayemu_vtx_t vtx;
-
-    bool eof = false;
-    void *stream;               /* pointer to current position in sound buffer */
-    unsigned char regs[14];
-    int need;
-    int left;                   /* how many sound frames can play with current AY register frame */
-    int donow;
-    int rate;
-
-    left = 0;
-    rate = chans * (bits / 8);
-
-    memset(&ay, 0, sizeof(ay));
-
-    if (!vtx.read_header(file))
-    {
-        AUDERR("Error read vtx header from %s\n", filename);
-        return false;
-    }
-    else if (!vtx.load_data(file))
-    {
-        AUDERR("Error read vtx data from %s\n", filename);
+    VTXPlayer player;
+    if (!player.open(filename, file))
         return false;
-    }
-
-    ayemu_init(&ay);
-    ayemu_set_chip_type(&ay, vtx.hdr.chiptype, nullptr);
-    ayemu_set_chip_freq(&ay, vtx.hdr.chipFreq);
-    ayemu_set_stereo(&ay, (ayemu_stereo_t) vtx.hdr.stereo, nullptr);
 
     set_stream_bitrate(14 * 50 * 8);
     open_audio(FMT_S16_NE, freq, chans);
 
-    while (!check_stop() && !eof)
+    char sndbuf[SNDBUFSIZE];
+    bool more = true;
+
+    while (!check_stop() && more)
     {
         /* (time in sec) * 50 = offset in AY register data frames */
         int seek_value = check_seek();
         if (seek_value >= 0)
-            vtx.pos = seek_value / 20;
-
-        /* fill sound buffer */
-        stream = sndbuf;
-
-        for (need = SNDBUFSIZE / rate; need > 0; need -= donow)
-        {
-            if (left > 0)
-            {                   /* use current AY register frame */
-                donow = (need > left) ? left : need;
-                left -= donow;
-                stream = ayemu_gen_sound(&ay, (char *)stream, donow * rate);
-            }
-            else
-            {                   /* get next AY register frame */
-                if (!vtx.get_next_frame(regs))
-                {
-                    donow = need;
-                    memset(stream, 0, donow * rate);
-                    eof = true;
-                }
-                else
-                {
-                    left = freq / vtx.hdr.playerFreq;
-                    ayemu_set_regs(&ay, regs);
-                    donow = 0;
-                }
-            }
-        }
+            player.vtx.pos = seek_value / 20;
 
+        more = player.generate(sndbuf, SNDBUFSIZE);
         write_audio(sndbuf, SNDBUFSIZE);
     }
 
@@ -178,3 +246,9 @@ const char VTXPlugin::about[] =
  N_("Vortex file format player by Sashnov Alexander <sashnov@ngs.ru>\n"
     "Based on in_vtx.dll by Roman Sherbakov <v_soft@microfor.ru>\n"
     "Audacious plugin by Pavel Vymetalek <pvymetalek@seznam.cz>");
+
+const PreferencesWidget VTXPlugin::widgets[] = {
+    WidgetCheck(N_("Measure song loudness"), WidgetBool("vtx", "measure"))
+};
+
+const PluginPreferences VTXPlugin::prefs = {{widgets}};
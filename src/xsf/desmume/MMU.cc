@@ -29,6 +29,7 @@
 #include "slot1.h"
 #include "readwrite.h"
 #include "MMU_timing.h"
+#include "state.h"
 
 // http://home.utah.edu/~nahaj/factoring/isqrt.c.html
 static uint64_t isqrt(uint64_t x)
@@ -738,6 +739,34 @@ void MMU_DeInit()
 	mc_free(&MMU.fw);
 }
 
+void MMU_GetStateRegions(std::vector<NDS_StateRegion> &regions)
+{
+	// all of MMU except the vector header of the firmware data, which is
+	// allocated once in MMU_Init and never resized
+	uint8_t *start = (uint8_t *)&MMU;
+	uint8_t *fw_data = (uint8_t *)&MMU.fw.data;
+	uint8_t *end = (uint8_t *)(&MMU + 1);
+	regions.push_back({ start, size_t(fw_data - start) });
+	regions.push_back({ fw_data + sizeof(MMU.fw.data), size_t(end - fw_data - sizeof(MMU.fw.data)) });
+	regions.push_back({ MMU.fw.data.data(), MMU.fw.data.size() });
+
+	// the DMA controllers and the registers after them refer only to
+	// themselves; the backup device before them owns heap memory
+	start = (uint8_t *)&MMU_new.dma;
+	end = (uint8_t *)(&MMU_new + 1);
+	regions.push_back({ start, size_t(end - start) });
+
+	regions.push_back({ &MMU_timing, sizeof(MMU_timing) });
+	regions.push_back({ &vramConfiguration, sizeof(vramConfiguration) });
+	regions.push_back({ vram_lcdc_map, sizeof(vram_lcdc_map) });
+	regions.push_back({ vram_arm9_map, sizeof(vram_arm9_map) });
+	regions.push_back({ vram_arm7_map, sizeof(vram_arm7_map) });
+	regions.push_back({ &partie, sizeof(partie) });
+	regions.push_back({ &_MMU_MAIN_MEM_MASK, sizeof(_MMU_MAIN_MEM_MASK) });
+	regions.push_back({ &_MMU_MAIN_MEM_MASK16, sizeof(_MMU_MAIN_MEM_MASK16) });
+	regions.push_back({ &_MMU_MAIN_MEM_MASK32, sizeof(_MMU_MAIN_MEM_MASK32) });
+}
+
 void MMU_Reset()
 {
 	memset(MMU.ARM9_DTCM, 0, sizeof(MMU.ARM9_DTCM));
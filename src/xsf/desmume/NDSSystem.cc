@@ -28,6 +28,7 @@
 #include "readwrite.h"
 #include "firmware.h"
 #include "slot1.h"
+#include "state.h"
 
 // ===============================================================
 
@@ -369,6 +370,25 @@ static void initSchedule()
 	sequencer.nds_vblankEnded = false;
 }
 
+void NDS_GetStateRegions(std::vector<NDS_StateRegion> &regions)
+{
+	regions.push_back({ &nds, sizeof(nds) });
+	regions.push_back({ &nds_timer, sizeof(nds_timer) });
+	regions.push_back({ &nds_arm9_timer, sizeof(nds_arm9_timer) });
+	regions.push_back({ &nds_arm7_timer, sizeof(nds_arm7_timer) });
+
+	// the sequence items point only at MMU_new, which does not move
+	regions.push_back({ &sequencer, sizeof(sequencer) });
+
+	regions.push_back({ &NDS_ARM9, sizeof(NDS_ARM9) });
+	regions.push_back({ &NDS_ARM7, sizeof(NDS_ARM7) });
+	regions.push_back({ &cp15, sizeof(cp15) });
+	regions.push_back({ ipc_fifo, sizeof(ipc_fifo) });
+
+	MMU_GetStateRegions(regions);
+	SPU_GetStateRegions(regions);
+}
+
 // 2196372 ~= (ARM7_CLOCK << 16) / 1000000
 // This value makes more sense to me, because:
 // ARM7_CLOCK   = 33.51 mhz
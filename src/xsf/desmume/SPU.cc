@@ -22,6 +22,7 @@
 //#include "XSFCommon.h"
 #include "../spu/samplecache.h"
 #include "../spu/interpolator.h"
+#include "state.h"
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -1407,6 +1408,30 @@ void SPU_Emulate_user(bool mix)
   soundProcessor->UpdateAudio(postProcessBuffer, processedSampleCount);
 }
 
+void SPU_GetStateRegions(std::vector<NDS_StateRegion> &regions)
+{
+	// sndbuf and outbuf stay allocated for the whole session
+	regions.push_back({ SPU_core, sizeof(SPU_struct) });
+	regions.push_back({ SPU_core->sndbuf, SPU_core->bufsize * 2 * sizeof(s32) });
+	regions.push_back({ SPU_core->outbuf, SPU_core->bufsize * 2 * sizeof(s16) });
+	regions.push_back({ &samples, sizeof(samples) });
+	regions.push_back({ &spu_core_samples, sizeof(spu_core_samples) });
+}
+
+ISynchronizingAudioBuffer *SPU_SaveSynchronizer()
+{
+	return synchronizer->clone();
+}
+
+void SPU_RestoreSynchronizer(const ISynchronizingAudioBuffer *saved)
+{
+	delete synchronizer;
+	synchronizer = saved->clone();
+
+	// the cache was filled from memory as it was at some other time
+	spuSampleCache.clear();
+}
+
 void SPU_DefaultFetchSamples(s16 *sampleBuffer, size_t sampleCount, ESynchMode synchMode, ISynchronizingAudioBuffer *theSynchronizer)
 {
   theSynchronizer->enqueue_samples(sampleBuffer, sampleCount);
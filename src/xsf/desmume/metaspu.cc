@@ -49,6 +49,10 @@ public:
     }
     return samples;
   }
+
+  virtual ISynchronizingAudioBuffer* clone() const {
+    return new NullSynchronizer(*this);
+  }
 };
 
 ISynchronizingAudioBuffer* metaspu_construct(ESynchMethod method)
@@ -37,6 +37,9 @@ public:
 
 	//returns the number of samples actually supplied, which may not match the number requested
 	virtual int output_samples(s16* buf, int samples_requested) = 0;
+
+	//returns a copy including the queued samples
+	virtual ISynchronizingAudioBuffer* clone() const = 0;
 };
 
 enum ESynchMode
@@ -0,0 +1,44 @@
+/*
+	Emulator state regions for in-memory snapshots
+
+	This file is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with the this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class ISynchronizingAudioBuffer;
+
+// A block of emulator state that can be saved and later restored by copying
+// its bytes.  Restoring is only valid within the same session (between
+// NDS_SetROM and NDS_DeInit), since some blocks hold pointers into others.
+struct NDS_StateRegion
+{
+	void *ptr;
+	size_t size;
+};
+
+// Lists every block of the running system's state, except for the few
+// objects that own heap memory (the backup device and the SPU synchronizer),
+// which are saved separately.
+void NDS_GetStateRegions(std::vector<NDS_StateRegion> &regions);
+void MMU_GetStateRegions(std::vector<NDS_StateRegion> &regions);
+void SPU_GetStateRegions(std::vector<NDS_StateRegion> &regions);
+
+// Copies of the samples queued between the SPU core and the sound interface.
+// Restoring also empties the sample cache, as after a reset.
+ISynchronizingAudioBuffer *SPU_SaveSynchronizer();
+void SPU_RestoreSynchronizer(const ISynchronizingAudioBuffer *saved);
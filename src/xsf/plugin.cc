@@ -53,6 +53,7 @@
 #include "desmume/NDSSystem.h"
 #include "spu/samplecache.h"
 #include "sndif2sf.h"
+#include "snapshot.h"
 #include "XSFFile.h"
 
 #if _WIN32
@@ -354,6 +355,9 @@ bool XSFPlugin::play(const char *filename, VFSFile &file)
 
     xsf_reset(frameSkip);
 
+    SnapshotList snapshots;
+    snapshots.update(0);
+
     set_stream_bitrate(DESMUME_SAMPLE_RATE*2*2*8);
     open_audio(FMT_S16_NE, DESMUME_SAMPLE_RATE, 2);
 
@@ -364,9 +368,13 @@ bool XSFPlugin::play(const char *filename, VFSFile &file)
 
       if (seek_value >= 0)
       {
-        if (seek_value < pos) {
-          xsf_reset(frameSkip);
-          pos = 0;
+        // restore the nearest snapshot unless it is behind the current position
+        float snapshot_pos;
+        const EmuSnapshot &snapshot = snapshots.find(seek_value, snapshot_pos);
+        if (seek_value < pos || snapshot_pos > pos) {
+          snapshot.restore();
+          buffer_rope.clear();
+          pos = snapshot_pos;
         }
         while (pos < seek_value)
         {
@@ -374,6 +382,7 @@ bool XSFPlugin::play(const char *filename, VFSFile &file)
             pos += buffer_rope.front().size() * 1000 / DESMUME_SAMPLE_RATE / 4;
             buffer_rope.pop_front();
           }
+          snapshots.update(pos);
           NDS_exec<false>();
           SPU_Emulate_user();
         }
@@ -398,6 +407,8 @@ bool XSFPlugin::play(const char *filename, VFSFile &file)
         pos += front.size() * 1000 / DESMUME_SAMPLE_RATE / 4;
         buffer_rope.pop_front();
       }
+      if (!buffer_rope.size())
+        snapshots.update(pos);
     }
   } catch (std::exception& e) {
     std::cerr << "Exception: " << e.what() << std::endl;
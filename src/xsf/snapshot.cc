@@ -0,0 +1,122 @@
+/*
+ * xSF - Emulator state snapshots for seeking
+ * Copyright (c) 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "snapshot.h"
+#include "desmume/SPU.h"
+#include "desmume/state.h"
+
+static constexpr size_t STATE_PAGE_SIZE = 4096;
+
+void EmuSnapshot::save(const EmuSnapshot *base)
+{
+  std::vector<NDS_StateRegion> regions;
+  NDS_GetStateRegions(regions);
+
+  pages.clear();
+  own_bytes = 0;
+
+  for (const NDS_StateRegion &region : regions) {
+    const uint8_t *data = static_cast<const uint8_t *>(region.ptr);
+    for (size_t offset = 0; offset < region.size; offset += STATE_PAGE_SIZE) {
+      size_t length = std::min(STATE_PAGE_SIZE, region.size - offset);
+      const Page *base_page = base ? &base->pages[pages.size()] : nullptr;
+
+      if (base_page && !memcmp((*base_page)->data(), data + offset, length)) {
+        pages.push_back(*base_page);
+      } else {
+        pages.push_back(std::make_shared<const std::vector<uint8_t>>(data + offset, data + offset + length));
+        own_bytes += length;
+      }
+    }
+  }
+
+  backup = MMU_new.backupDevice;
+  synchronizer.reset(SPU_SaveSynchronizer());
+}
+
+void EmuSnapshot::restore() const
+{
+  std::vector<NDS_StateRegion> regions;
+  NDS_GetStateRegions(regions);
+
+  auto page = pages.begin();
+  for (const NDS_StateRegion &region : regions) {
+    uint8_t *data = static_cast<uint8_t *>(region.ptr);
+    for (size_t offset = 0; offset < region.size; offset += STATE_PAGE_SIZE) {
+      memcpy(data + offset, (*page)->data(), (*page)->size());
+      ++page;
+    }
+  }
+
+  MMU_new.backupDevice = backup;
+  SPU_RestoreSynchronizer(synchronizer.get());
+}
+
+void SnapshotList::update(float position)
+{
+  if (entries.size() && position < entries.back().position + interval)
+    return;
+
+  std::unique_ptr<EmuSnapshot> snapshot(new EmuSnapshot);
+  snapshot->save(entries.size() ? entries[0].snapshot.get() : nullptr);
+
+  if (entries.size())
+    memory += snapshot->ownBytes();
+
+  entries.push_back({position, std::move(snapshot)});
+
+  while (memory > MAX_MEMORY && entries.size() > 2) {
+    std::vector<Entry> kept;
+    memory = 0;
+
+    for (size_t i = 0; i < entries.size(); i++) {
+      if (i % 2 == 0) {
+        if (i)
+          memory += entries[i].snapshot->ownBytes();
+        kept.push_back(std::move(entries[i]));
+      }
+    }
+
+    entries = std::move(kept);
+    interval *= 2;
+  }
+}
+
+const EmuSnapshot &SnapshotList::find(float position, float &snapshot_position) const
+{
+  size_t i = entries.size() - 1;
+  while (i && entries[i].position > position)
+    i--;
+
+  snapshot_position = entries[i].position;
+  return *entries[i].snapshot;
+}
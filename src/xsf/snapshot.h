@@ -0,0 +1,89 @@
+/*
+ * xSF - Emulator state snapshots for seeking
+ * Copyright (c) 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "desmume/MMU.h"
+#include "desmume/metaspu.h"
+
+// A copy of the complete emulator state.  The state is stored in pages, and
+// pages that are unchanged from a base snapshot are shared with it, so that a
+// snapshot taken during playback holds little more than what the sound driver
+// has modified since the song started.
+class EmuSnapshot
+{
+public:
+  void save(const EmuSnapshot *base = nullptr);
+  void restore() const;
+
+  // bytes of state held by this snapshot and not shared with its base
+  size_t ownBytes() const { return own_bytes; }
+
+private:
+  typedef std::shared_ptr<const std::vector<uint8_t>> Page;
+
+  std::vector<Page> pages;
+  size_t own_bytes = 0;
+
+  BackupDevice backup;
+  std::unique_ptr<ISynchronizingAudioBuffer> synchronizer;
+};
+
+// Snapshots taken at regular intervals of playback time.  The first snapshot
+// (at time zero) is kept as the base.  Once the other snapshots hold more than
+// a fixed amount of memory, every other one is dropped and the interval is
+// doubled, so that a long song stays evenly covered.
+class SnapshotList
+{
+public:
+  // takes a snapshot if one is due; the emulator state must correspond
+  // exactly to position (no audio pending in the sound interface)
+  void update(float position);
+
+  // returns the last snapshot taken at or before position
+  const EmuSnapshot &find(float position, float &snapshot_position) const;
+
+private:
+  struct Entry
+  {
+    float position;
+    std::unique_ptr<EmuSnapshot> snapshot;
+  };
+
+  std::vector<Entry> entries;
+  float interval = INITIAL_INTERVAL;
+  size_t memory = 0;
+
+  static constexpr float INITIAL_INTERVAL = 10000; // ms
+  static constexpr size_t MAX_MEMORY = 64 << 20;   // excluding the base
+};